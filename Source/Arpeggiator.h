@@ -0,0 +1,293 @@
+#ifndef __Arpeggiator_h__
+#define __Arpeggiator_h__
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+
+// Arpeggiator patterns (kParam_ArpMode)
+enum ArpeggiatorMode {
+    kArpMode_Up = 0,
+    kArpMode_Down = 1,
+    kArpMode_UpDown = 2,     // Up then down, without repeating the top and bottom notes
+    kArpMode_Random = 3,
+    kNumArpModes
+};
+
+// What the arpeggiator does on one frame: release a note, then start one (-1 for neither)
+struct ArpeggiatorAction {
+    int releaseNote;
+    int startNote;
+};
+
+// Turns the held notes into a sequence of steps. Knows nothing about voices: the owner
+// passes note on/off in and plays the notes in the actions it gets back.
+//
+// Held notes are kept in pitch order as they come and go, so a step is a lookup. Steps
+// and gate ends are events in frames: GetFramesToNextAction says how far away the next
+// one is, so the owner can render straight up to it and call Process there, rather
+// than ticking the arpeggiator every frame. Without a host song position (or while the
+// host is stopped) it counts steps from the first note held; Sync locks the steps to
+// the host's beat instead.
+//
+// Render thread only. Plain C++ with no Apple dependencies.
+class Arpeggiator {
+public:
+    static const int kMaxNotes = 16;  // Held notes it keeps (any more are ignored)
+
+    Arpeggiator() {
+        mMode = kArpMode_Up;
+        mOctaves = 1;
+        mGate = 0.9f;
+        mStepsPerBeat = 2.0;
+        SetTempo(120.0, 44100.0);
+        Reset();
+    }
+
+    // Nothing held and the pattern back at its start. Settings and tempo are kept.
+    void Reset() {
+        mNumNotes = 0;
+        mStep = 0;
+        mPhase = 0.0;
+        mSoundingNote = -1;
+        mSynced = false;
+        mRandomState = kRandomSeed;
+    }
+
+    // Rate: 0=1/4, 1=1/8, 2=1/16, 3=1/32
+    void SetRate(int rate) {
+        rate = (rate < 0) ? 0 : (rate > 3 ? 3 : rate);
+        mStepsPerBeat = (double)(1 << rate);
+        UpdateFramesPerStep();
+    }
+
+    void SetMode(int mode) {
+        mMode = (mode >= 0 && mode < kNumArpModes) ? (ArpeggiatorMode)mode : kArpMode_Up;
+    }
+
+    void SetOctaves(int octaves) {
+        mOctaves = (octaves < 1) ? 1 : (octaves > 4 ? 4 : octaves);
+    }
+
+    // Fraction of each step the note sounds for
+    void SetGate(float gate) { mGate = gate; }
+
+    // Beats (quarter notes) per minute
+    void SetTempo(double tempo, double sampleRate) {
+        mTempo = (tempo > 0.0) ? tempo : 120.0;
+        mSampleRate = sampleRate;
+        UpdateFramesPerStep();
+    }
+
+    // Locks the steps to the host's song position: beatPosition is the beat at the next
+    // frame. Call it once per render buffer while the host is playing, after SetTempo.
+    // The steps only move when they are more than a frame out, so a host that stays in
+    // time never has a step repeated or skipped at a buffer boundary.
+    void Sync(double beatPosition) {
+        double stepPosition = beatPosition * mStepsPerBeat;
+        double phase = (stepPosition - floor(stepPosition)) * mFramesPerStep;
+        if (phase <= 0.0) {
+            phase = mFramesPerStep;  // On a step: it plays on this frame
+        }
+        double offset = fmod(phase - mPhase, mFramesPerStep);
+        if (offset > 0.5 * mFramesPerStep) offset -= mFramesPerStep;
+        if (offset < -0.5 * mFramesPerStep) offset += mFramesPerStep;
+        if (!mSynced || fabs(offset) > 1.0) {
+            mPhase = phase;
+        }
+        mSynced = true;
+    }
+
+    // Back to counting steps from the first note held (the host stopped)
+    void Unsync() { mSynced = false; }
+
+    // A key went down. False if it was already held or kMaxNotes are.
+    bool AddNote(int note) {
+        int index = 0;
+        while (index < mNumNotes && mNotes[index] < note) index++;
+        if ((index < mNumNotes && mNotes[index] == note) || mNumNotes == kMaxNotes) {
+            return false;
+        }
+        for (int i = mNumNotes; i > index; i--) {
+            mNotes[i] = mNotes[i - 1];
+        }
+        mNotes[index] = note;
+        mNumNotes++;
+
+        // The pattern starts again with the first note. The first step comes a step later,
+        // or on the host's next step when synced.
+        if (mNumNotes == 1) {
+            mStep = 0;
+            if (!mSynced) {
+                mPhase = 1.0;
+            }
+        }
+        return true;
+    }
+
+    // A key came up. The note to release now, or -1: the sounding note when it was this
+    // key's or the last key came up.
+    int RemoveNote(int note) {
+        int index = 0;
+        while (index < mNumNotes && mNotes[index] != note) index++;
+        if (index == mNumNotes) {
+            return -1;
+        }
+        mNumNotes--;
+        for (int i = index; i < mNumNotes; i++) {
+            mNotes[i] = mNotes[i + 1];
+        }
+
+        int release = -1;
+        if (mSoundingNote >= 0 && (mNumNotes == 0 || mSoundingNote == note)) {
+            release = mSoundingNote;
+            mSoundingNote = -1;
+        }
+        if (mNumNotes == 0) {
+            mStep = 0;
+        }
+        return release;
+    }
+
+    // Forgets every held note (the arpeggiator was switched off). The note to release, or -1.
+    int Clear() {
+        int release = mSoundingNote;
+        mNumNotes = 0;
+        mStep = 0;
+        mSoundingNote = -1;
+        return release;
+    }
+
+    int GetNumHeldNotes() const { return mNumNotes; }
+
+    // Frames to render before the next call to Process is due: 0 when it is due on this
+    // frame, INT_MAX when nothing is coming.
+    int GetFramesToNextAction() const {
+        if (mNumNotes == 0) {
+            return (mSoundingNote >= 0) ? 0 : INT_MAX;
+        }
+        int frames = FramesUntil(mFramesPerStep);
+        if (mSoundingNote >= 0) {
+            int gateFrames = FramesUntil(mFramesPerStep * mGate);
+            frames = (gateFrames < frames) ? gateFrames : frames;
+        }
+        return frames;
+    }
+
+    // Frames rendered with nothing due
+    void Advance(int frames) {
+        mPhase += (double)frames;
+        // With nothing held no step is taken, so the steps wrap here (keeping a synced
+        // arpeggiator on the beat for the next note)
+        if (mNumNotes == 0 && mPhase > mFramesPerStep) {
+            mPhase -= mFramesPerStep * ceil(mPhase / mFramesPerStep - 1.0);
+        }
+    }
+
+    // What to do on this frame: the step, or the end of the sounding note's gate. The
+    // started note is taken to be sounding until its gate ends.
+    ArpeggiatorAction Process() {
+        ArpeggiatorAction action;
+        action.releaseNote = -1;
+        action.startNote = -1;
+
+        if (mNumNotes == 0) {
+            action.releaseNote = mSoundingNote;
+            mSoundingNote = -1;
+            return action;
+        }
+
+        if (mPhase >= mFramesPerStep) {
+            mPhase -= mFramesPerStep;
+            action.releaseNote = mSoundingNote;
+            mSoundingNote = -1;
+            int note = GetStepNote();
+            if (note >= 0 && note < 128) {
+                action.startNote = note;
+                mSoundingNote = note;
+            }
+            mStep++;
+        } else if (mSoundingNote >= 0 && mPhase >= mFramesPerStep * mGate) {
+            action.releaseNote = mSoundingNote;
+            mSoundingNote = -1;
+        }
+        return action;
+    }
+
+private:
+    static const uint32_t kRandomSeed = 0x9E3779B9u;
+
+    void UpdateFramesPerStep() {
+        double stepsPerSecond = (mTempo / 60.0) * mStepsPerBeat;
+        mFramesPerStep = mSampleRate / stepsPerSecond;
+    }
+
+    // Frames until the phase reaches target
+    int FramesUntil(double target) const {
+        double frames = ceil(target - mPhase);
+        if (frames <= 0.0) return 0;
+        return (frames < (double)INT_MAX) ? (int)frames : INT_MAX;
+    }
+
+    // xorshift32: a few instructions a draw, and the same sequence from every Reset
+    uint32_t NextRandom() {
+        uint32_t x = mRandomState;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        mRandomState = x;
+        return x;
+    }
+
+    // The note for the current step: an index into the held notes repeated over the octaves
+    int GetStepNote() {
+        int totalNotes = mNumNotes * mOctaves;
+        int step = mStep % totalNotes;
+
+        int index = step;
+        switch (mMode) {
+            case kArpMode_Up:
+                break;
+
+            case kArpMode_Down:
+                index = totalNotes - 1 - step;
+                break;
+
+            case kArpMode_UpDown: {
+                int upDownLength = (totalNotes * 2) - 2;
+                if (upDownLength < 1) upDownLength = 1;
+                int pos = mStep % upDownLength;
+                index = (pos < totalNotes) ? pos : upDownLength - pos;
+                break;
+            }
+
+            case kArpMode_Random:
+                // Scaled rather than taken modulo, which would need a divide
+                index = (int)(((uint64_t)NextRandom() * (uint32_t)totalNotes) >> 32);
+                break;
+
+            default:
+                break;
+        }
+        return mNotes[index % mNumNotes] + (index / mNumNotes) * 12;
+    }
+
+    int mNotes[kMaxNotes];  // Held notes, lowest first
+    int mNumNotes;
+
+    ArpeggiatorMode mMode;
+    int mOctaves;
+    float mGate;
+    double mStepsPerBeat;
+    double mTempo;
+    double mSampleRate;
+    double mFramesPerStep;
+
+    int mStep;          // Steps played since the first note
+    double mPhase;      // Frames into the current step, counting this frame
+    int mSoundingNote;  // Note started by the last step until its gate ends (-1 if none)
+    bool mSynced;       // Steps follow the host's song position
+    uint32_t mRandomState;
+};
+
+#endif
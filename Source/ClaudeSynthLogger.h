@@ -1,28 +1,396 @@
 #ifndef __ClaudeSynthLogger_h__
 #define __ClaudeSynthLogger_h__
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
-#include <time.h>
 #include <string.h>
-#include <stdarg.h>
+#include <time.h>
+
+// Debug log (/tmp/claudesynth.log) that is safe to call from the audio thread.
+//
+// ClaudeLog and friends take a printf-style format (which must be a string literal)
+// and copy it with its arguments into a fixed-size record on a lock-free queue; they
+// never lock, allocate or touch the file. A background thread formats the records and
+// writes them out in batches. When the queue is full the record is dropped and
+// counted, and the writer notes the count in the log.
+//
+// Levels are chosen at compile time with CLAUDESYNTH_LOG_LEVEL. Calls above the level
+// compile to nothing and their arguments aren't evaluated. Release builds
+// (NDEBUG) default to no logging at all.
+
+#define CLAUDESYNTH_LOG_OFF 0
+#define CLAUDESYNTH_LOG_ERROR 1
+#define CLAUDESYNTH_LOG_INFO 2
+#define CLAUDESYNTH_LOG_DEBUG 3
+
+#ifndef CLAUDESYNTH_LOG_LEVEL
+#if defined(NDEBUG)
+#define CLAUDESYNTH_LOG_LEVEL CLAUDESYNTH_LOG_OFF
+#else
+#define CLAUDESYNTH_LOG_LEVEL CLAUDESYNTH_LOG_DEBUG
+#endif
+#endif
+
+// One log call: the format, the arguments as raw values, and copies of any strings
+struct LogRecord {
+    static const int kMaxArguments = 6;
+    static const int kStringBytes = 48;
 
-// Simple file logger for debugging
-static void ClaudeLog(const char* format, ...) {
-    FILE* f = fopen("/tmp/claudesynth.log", "a");
-    if (f) {
-        time_t now = time(NULL);
-        char timestr[64];
-        strftime(timestr, sizeof(timestr), "%H:%M:%S", localtime(&now));
-        fprintf(f, "[%s] ", timestr);
+    enum ArgumentKind {
+        kArgument_Signed,
+        kArgument_Unsigned,
+        kArgument_Double,
+        kArgument_String,   // Offset into strings
+        kArgument_Pointer
+    };
 
-        va_list args;
-        va_start(args, format);
-        vfprintf(f, format, args);
-        va_end(args);
+    int64_t timestamp;   // Microseconds since the epoch
+    const char *format;
+    uint8_t level;
+    uint8_t numArguments;
+    uint8_t kinds[kMaxArguments];
+    uint8_t sizes[kMaxArguments];  // Bytes in the original integer argument
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const void *p;
+    } values[kMaxArguments];
+    char strings[kStringBytes];    // NUL-terminated %s arguments, truncated to fit
+    uint8_t stringBytes;
+};
 
-        fprintf(f, "\n");
-        fclose(f);
+class ClaudeLogger {
+public:
+    static const int kCapacity = 2048;  // Records; power of two
+    static const int kFlushIntervalMs = 20;
+
+    static ClaudeLogger& Shared() {
+        static ClaudeLogger logger;
+        return logger;
+    }
+
+    // Opens the log and starts the writer thread. Allocates, so call it from setup code,
+    // never from the audio thread; records logged before then wait in the queue.
+    void Start(const char *path = "/tmp/claudesynth.log") {
+        std::lock_guard<std::mutex> lock(mStartMutex);
+        if (mFile) return;
+        mFile = fopen(path, "a");
+        if (!mFile) return;
+        mQuit.store(false);
+        mWriter = std::thread(&ClaudeLogger::WriterMain, this);
     }
+
+    // Any thread. Never blocks; false if the queue was full and the record was dropped.
+    template <typename... Arguments>
+    bool Log(int level, const char *format, Arguments... arguments) {
+        static_assert(sizeof...(Arguments) <= LogRecord::kMaxArguments, "too many log arguments");
+
+        uint32_t position = mPushPosition.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &mCells[position & (kCapacity - 1)];
+            uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+            int32_t difference = (int32_t)(sequence - position);
+            if (difference == 0) {
+                if (mPushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = mPushPosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Fill the claimed cell in place; the writer can't see it until the sequence store
+        LogRecord& record = cell->record;
+        record.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        record.format = format;
+        record.level = (uint8_t)level;
+        record.numArguments = 0;
+        record.stringBytes = 0;
+        AddArguments(record, arguments...);
+
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Records dropped because the queue was full
+    uint32_t GetDroppedCount() const {
+        return mDroppedCount.load(std::memory_order_relaxed);
+    }
+
+    ~ClaudeLogger() {
+        if (mWriter.joinable()) {
+            mQuit.store(true);
+            mWriter.join();
+        }
+        if (mFile) fclose(mFile);
+    }
+
+private:
+    struct Cell {
+        std::atomic<uint32_t> sequence;  // Same scheme as MIDIEventQueue
+        LogRecord record;
+    };
+
+    ClaudeLogger() : mFile(NULL), mQuit(false), mLoggedDropCount(0), mTextLength(0) {
+        for (int i = 0; i < kCapacity; i++) {
+            mCells[i].sequence.store((uint32_t)i, std::memory_order_relaxed);
+        }
+        mPushPosition.store(0, std::memory_order_relaxed);
+        mPopPosition = 0;
+        mDroppedCount.store(0, std::memory_order_relaxed);
+    }
+
+    ClaudeLogger(const ClaudeLogger&);
+    ClaudeLogger& operator=(const ClaudeLogger&);
+
+    // Argument capture (caller's thread)
+
+    static void AddArguments(LogRecord&) {}
+
+    template <typename First, typename... Rest>
+    static void AddArguments(LogRecord& record, First first, Rest... rest) {
+        AddArgument(record, first);
+        AddArguments(record, rest...);
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+    AddArgument(LogRecord& record, T value) {
+        int index = record.numArguments++;
+        record.sizes[index] = (uint8_t)sizeof(T);
+        if ((T)-1 < (T)0) {
+            record.kinds[index] = LogRecord::kArgument_Signed;
+            record.values[index].i = (int64_t)value;
+        } else {
+            record.kinds[index] = LogRecord::kArgument_Unsigned;
+            record.values[index].u = (uint64_t)value;
+        }
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    AddArgument(LogRecord& record, T value) {
+        int index = record.numArguments++;
+        record.kinds[index] = LogRecord::kArgument_Double;
+        record.values[index].d = (double)value;
+    }
+
+    static void AddArgument(LogRecord& record, const char *value) {
+        int index = record.numArguments++;
+        record.kinds[index] = LogRecord::kArgument_String;
+        record.values[index].u = record.stringBytes;
+        if (!value) value = "(null)";
+        int room = LogRecord::kStringBytes - 1 - record.stringBytes;
+        int length = 0;
+        while (length < room && value[length]) length++;
+        memcpy(record.strings + record.stringBytes, value, length);
+        record.strings[record.stringBytes + length] = '\0';
+        record.stringBytes = (uint8_t)(record.stringBytes + length + (length < room ? 1 : 0));
+    }
+
+    static void AddArgument(LogRecord& record, const void *value) {
+        int index = record.numArguments++;
+        record.kinds[index] = LogRecord::kArgument_Pointer;
+        record.values[index].p = value;
+    }
+
+    // Writer thread
+
+    void WriterMain() {
+        int flushIntervalMs = kFlushIntervalMs;  // A copy: the duration takes it by reference
+        while (!mQuit.load()) {
+            Drain();
+            std::this_thread::sleep_for(std::chrono::milliseconds(flushIntervalMs));
+        }
+        Drain();
+    }
+
+    void Drain() {
+        while (true) {
+            Cell& cell = mCells[mPopPosition & (kCapacity - 1)];
+            if (cell.sequence.load(std::memory_order_acquire) != mPopPosition + 1) break;
+            Format(cell.record);
+            cell.sequence.store(mPopPosition + kCapacity, std::memory_order_release);
+            mPopPosition++;
+        }
+
+        uint32_t dropped = GetDroppedCount();
+        if (dropped != mLoggedDropCount) {
+            Append("[logger] %u records dropped (queue full)\n", (unsigned int)(dropped - mLoggedDropCount));
+            mLoggedDropCount = dropped;
+        }
+
+        Flush();
+        fflush(mFile);
+    }
+
+    void Flush() {
+        if (mTextLength > 0) {
+            fwrite(mText, 1, mTextLength, mFile);
+            mTextLength = 0;
+        }
+    }
+
+    // printf to the text buffer; the compiler checks the arguments against the format
+    __attribute__((format(printf, 2, 3)))
+    void Append(const char *format, ...) {
+        va_list arguments;
+        va_start(arguments, format);
+        AppendV(format, arguments);
+        va_end(arguments);
+    }
+
+    // Same for one conversion Format rebuilt from a log call's format, which can't be
+    // checked here: Format passes the argument type the conversion asks for
+    void AppendConversion(const char *spec, ...) {
+        va_list arguments;
+        va_start(arguments, spec);
+        AppendV(spec, arguments);
+        va_end(arguments);
+    }
+
+    __attribute__((format(printf, 2, 0)))
+    void AppendV(const char *format, va_list arguments) {
+        if (mTextLength > kTextBytes - kMaxLineBytes) Flush();
+        int written = vsnprintf(mText + mTextLength, kTextBytes - mTextLength, format, arguments);
+        if (written > 0) {
+            mTextLength += (written < kTextBytes - mTextLength) ? written : kTextBytes - mTextLength - 1;
+        }
+    }
+
+    void Format(const LogRecord& record) {
+        static const char *kLevelNames[4] = { "", "ERROR ", "", "debug " };
+
+        time_t seconds = (time_t)(record.timestamp / 1000000);
+        struct tm local;
+        localtime_r(&seconds, &local);
+        char timeText[16];
+        strftime(timeText, sizeof(timeText), "%H:%M:%S", &local);
+        Append("[%s.%03d] %s", timeText, (int)((record.timestamp / 1000) % 1000),
+               kLevelNames[record.level & 3]);
+
+        // Walk the format, printing each conversion with the captured argument's type
+        int argument = 0;
+        const char *p = record.format;
+        while (*p) {
+            const char *start = p;
+            while (*p && *p != '%') p++;
+            if (p > start) Append("%.*s", (int)(p - start), start);
+            if (!*p) break;
+
+            if (p[1] == '%') {
+                Append("%%");
+                p += 2;
+                continue;
+            }
+
+            // %[flags][width][.precision][length]conversion, rebuilt with our own length
+            char spec[32];
+            int length = 0;
+            spec[length++] = *p++;
+            while (*p && strchr("-+ #0123456789.", *p) && length < 24) spec[length++] = *p++;
+            while (*p && strchr("hljztLq", *p)) p++;
+            char conversion = *p ? *p++ : 's';
+
+            if (argument >= record.numArguments) {
+                Append("<?>");
+                continue;
+            }
+            int kind = record.kinds[argument];
+            int64_t signedValue = record.values[argument].i;
+            uint64_t unsignedValue = record.values[argument].u;
+            if (kind == LogRecord::kArgument_Signed || kind == LogRecord::kArgument_Unsigned) {
+                // Unsigned conversions see the value at its original width, like printf
+                int bits = record.sizes[argument] * 8;
+                if (bits < 64) unsignedValue &= (1ull << bits) - 1;
+            }
+
+            if (strchr("di", conversion)) {
+                spec[length++] = 'l'; spec[length++] = 'l'; spec[length++] = conversion; spec[length] = '\0';
+                AppendConversion(spec, (long long)(kind == LogRecord::kArgument_Double ? (int64_t)record.values[argument].d : signedValue));
+            } else if (strchr("uoxX", conversion)) {
+                spec[length++] = 'l'; spec[length++] = 'l'; spec[length++] = conversion; spec[length] = '\0';
+                AppendConversion(spec, (unsigned long long)unsignedValue);
+            } else if (strchr("eEfFgGaA", conversion)) {
+                spec[length++] = conversion; spec[length] = '\0';
+                double value = record.values[argument].d;
+                if (kind == LogRecord::kArgument_Signed) value = (double)signedValue;
+                if (kind == LogRecord::kArgument_Unsigned) value = (double)unsignedValue;
+                AppendConversion(spec, value);
+            } else if (conversion == 'c') {
+                spec[length++] = 'c'; spec[length] = '\0';
+                AppendConversion(spec, (int)signedValue);
+            } else if (conversion == 'p') {
+                spec[length++] = 'p'; spec[length] = '\0';
+                AppendConversion(spec, record.values[argument].p);
+            } else {
+                spec[length++] = 's'; spec[length] = '\0';
+                AppendConversion(spec, kind == LogRecord::kArgument_String ? record.strings + unsignedValue : "<?>");
+            }
+            argument++;
+        }
+        Append("\n");
+    }
+
+    static const int kTextBytes = 16384;
+    static const int kMaxLineBytes = 512;
+
+    Cell mCells[kCapacity];
+    std::atomic<uint32_t> mPushPosition;
+    std::atomic<uint32_t> mDroppedCount;
+    uint32_t mPopPosition;  // Writer thread only
+
+    std::mutex mStartMutex;
+    FILE *mFile;
+    std::thread mWriter;
+    std::atomic<bool> mQuit;
+    uint32_t mLoggedDropCount;
+    char mText[kTextBytes];
+    int mTextLength;
+};
+
+// Opens the log and starts its writer (no-op when logging is compiled out). Not for
+// the audio thread.
+static inline void ClaudeLogStart() {
+#if CLAUDESYNTH_LOG_LEVEL > CLAUDESYNTH_LOG_OFF
+    ClaudeLogger::Shared().Start();
+#endif
 }
 
+// Compiled-out calls still name their arguments (so variables kept only for logging
+// don't warn) but inside sizeof, which generates no code
+template <typename... Arguments>
+int ClaudeLogDiscard(const char *format, Arguments... arguments);
+#define CLAUDESYNTH_LOG_DISCARD(...) ((void)sizeof(ClaudeLogDiscard(__VA_ARGS__)))
+
+#if CLAUDESYNTH_LOG_LEVEL >= CLAUDESYNTH_LOG_ERROR
+#define ClaudeLogError(...) ClaudeLogger::Shared().Log(CLAUDESYNTH_LOG_ERROR, __VA_ARGS__)
+#else
+#define ClaudeLogError(...) CLAUDESYNTH_LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if CLAUDESYNTH_LOG_LEVEL >= CLAUDESYNTH_LOG_INFO
+#define ClaudeLog(...) ClaudeLogger::Shared().Log(CLAUDESYNTH_LOG_INFO, __VA_ARGS__)
+#else
+#define ClaudeLog(...) CLAUDESYNTH_LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if CLAUDESYNTH_LOG_LEVEL >= CLAUDESYNTH_LOG_DEBUG
+#define ClaudeLogDebug(...) ClaudeLogger::Shared().Log(CLAUDESYNTH_LOG_DEBUG, __VA_ARGS__)
+#else
+#define ClaudeLogDebug(...) CLAUDESYNTH_LOG_DISCARD(__VA_ARGS__)
+#endif
+
 #endif
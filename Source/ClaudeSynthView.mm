@@ -786,9 +786,13 @@
         oscilloscope = [[MatrixOscilloscope alloc] initWithFrame:NSMakeRect(950, 10, 280, 150)];
         [self addSubview:oscilloscope];
 
-        // Set oscilloscope pointer in audio unit
-        void *oscopePtr = (__bridge void *)oscilloscope;
-        AudioUnitSetProperty(mAU, kClaudeSynthProperty_Oscilloscope, kAudioUnitScope_Global, 0, &oscopePtr, sizeof(void *));
+        // Read the audio unit's output through its scope ring buffer
+        ScopeRingBuffer *scopeBuffer = NULL;
+        UInt32 scopeBufferSize = sizeof(scopeBuffer);
+        if (AudioUnitGetProperty(mAU, kClaudeSynthProperty_ScopeBuffer, kAudioUnitScope_Global, 0,
+                                 &scopeBuffer, &scopeBufferSize) == noErr) {
+            [oscilloscope setRingBuffer:scopeBuffer];
+        }
 
         // Start timer to poll for host automation updates
         updateTimer = [NSTimer scheduledTimerWithTimeInterval:0.1
@@ -1159,21 +1163,9 @@
 
     // Note division dropdown
     MatrixDropdown *noteDivisionDropdown = [[MatrixDropdown alloc] initWithFrame:NSMakeRect(x + 5, 205, 80, 20)];
-    [noteDivisionDropdown addItemWithTitle:@"1/32"];
-    [noteDivisionDropdown addItemWithTitle:@"1/16"];
-    [noteDivisionDropdown addItemWithTitle:@"1/8"];
-    [noteDivisionDropdown addItemWithTitle:@"1/4"];
-    [noteDivisionDropdown addItemWithTitle:@"1/2"];
-    [noteDivisionDropdown addItemWithTitle:@"1/1"];
-    [noteDivisionDropdown addItemWithTitle:@"1/32T"];
-    [noteDivisionDropdown addItemWithTitle:@"1/16T"];
-    [noteDivisionDropdown addItemWithTitle:@"1/8T"];
-    [noteDivisionDropdown addItemWithTitle:@"1/4T"];
-    [noteDivisionDropdown addItemWithTitle:@"1/2T"];
-    [noteDivisionDropdown addItemWithTitle:@"1/16."];
-    [noteDivisionDropdown addItemWithTitle:@"1/8."];
-    [noteDivisionDropdown addItemWithTitle:@"1/4."];
-    [noteDivisionDropdown addItemWithTitle:@"1/2."];
+    for (int division = 0; division < kNumLFONoteDivisions; division++) {
+        [noteDivisionDropdown addItemWithTitle:@(kLFONoteDivisions[division].name)];
+    }
 
     AudioUnitParameterID noteDivisionParamID = (lfoNum == 1) ? kParam_LFO1_NoteDivision : kParam_LFO2_NoteDivision;
     AudioUnitParameterValue initialNoteDivision = 2.0f;  // 1/8 note
@@ -1277,6 +1269,11 @@
         [sourcePopup addItemWithTitle:@"LFO 1"];
         [sourcePopup addItemWithTitle:@"LFO 2"];
         [sourcePopup addItemWithTitle:@"Filter Env"];
+        [sourcePopup addItemWithTitle:@"Velocity"];
+        [sourcePopup addItemWithTitle:@"Note Number"];
+        [sourcePopup addItemWithTitle:@"Aftertouch"];
+        [sourcePopup addItemWithTitle:@"Mod Wheel"];
+        [sourcePopup addItemWithTitle:@"Amp Env"];
         [sourcePopup setTarget:self];
         [sourcePopup setTag:slot];
         [sourcePopup setAction:@selector(modSourceChanged:)];
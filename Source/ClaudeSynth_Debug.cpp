@@ -30,7 +30,7 @@ static OSStatus ClaudeSynth_Render_Debug(void *self,
 
     // OUTPUT TEST TONE: 440Hz sine wave at low volume
     static double phase = 0.0;
-    double phaseIncrement = (440.0 / data->sampleRate) * 2.0 * M_PI;
+    double phaseIncrement = (440.0 / data->engine.GetSampleRate()) * 2.0 * M_PI;
 
     for (UInt32 frame = 0; frame < inNumberFrames; frame++) {
         float testTone = sin(phase) * 0.3f;  // 440Hz at 30% volume
@@ -0,0 +1,395 @@
+#ifndef __EffectsChain_h__
+#define __EffectsChain_h__
+
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "FastMath.h"
+
+enum EffectType {
+    kEffect_None = 0,
+    kEffect_Chorus = 1,
+    kEffect_Phaser = 2,
+    kEffect_Flanger = 3,
+    kNumEffectTypes = 4
+};
+
+// Power-of-two ring of samples addressed with a mask, so reads and writes never wrap
+// with a branch or a modulo
+class DelayLine {
+public:
+    DelayLine() : mMask(0), mWritePos(0) {}
+
+    // Room for delays up to maxDelay samples (plus the interpolation tap). Allocates.
+    void Allocate(double maxDelay) {
+        uint32_t size = 1;
+        while (size < (uint32_t)maxDelay + 2) size <<= 1;
+        mBuffer.assign(size, 0.0f);
+        mMask = size - 1;
+        mWritePos = 0;
+    }
+
+    void Clear() {
+        if (!mBuffer.empty()) memset(&mBuffer[0], 0, mBuffer.size() * sizeof(float));
+        mWritePos = 0;
+    }
+
+    // Longest delay Read can interpolate without reaching the sample being written
+    float GetMaxDelay() const { return (float)mMask - 1.0f; }
+
+    void Write(float sample) {
+        mBuffer[mWritePos] = sample;
+    }
+
+    // The sample delay frames behind the last one written, linearly interpolated
+    float Read(float delay) const {
+        int whole = (int)delay;
+        float frac = delay - (float)whole;
+        uint32_t older = (mWritePos - (uint32_t)whole - 1) & mMask;
+        uint32_t newer = (older + 1) & mMask;
+        return mBuffer[older] * frac + mBuffer[newer] * (1.0f - frac);
+    }
+
+    void Advance() {
+        mWritePos = (mWritePos + 1) & mMask;
+    }
+
+private:
+    std::vector<float> mBuffer;
+    uint32_t mMask;
+    uint32_t mWritePos;
+};
+
+// The master effect (chorus, phaser or flanger), processed a stereo block at a time.
+//
+// The effect LFO and everything derived from it (delay times, the phaser's all-pass
+// coefficient) are evaluated at the block's first and last frames and ramped linearly
+// in between; the LFO is at most 10 Hz, so over kMaxRampFrames the ramp stays within
+// 1e-4 of evaluating it every sample. The effect is chosen through a function pointer
+// once per block rather than tested every frame.
+//
+// Each channel has its own delay lines and filter state. The chorus and flanger read
+// the right channel with the LFO a quarter cycle ahead, so even a mono input comes out
+// wide; the phaser sweeps both channels together.
+//
+// Once the input goes silent the effect keeps running for its tail (GetTailFrames), so
+// echoes and ringing die away rather than being cut off, and then clears its state and
+// goes idle: an idle effect costs nothing until something plays into it again.
+class EffectsChain {
+public:
+    static const int kMaxRampFrames = 64;  // Longer blocks are processed in pieces
+
+    EffectsChain() : mSampleRate(0.0), mType(kEffect_None), mIntensity(0.5f) {
+        SetSampleRate(44100.0);
+        Reset();
+    }
+
+    // Default settings with empty delay lines. Not thread-safe (SynthEngine::Reset calls it).
+    void Reset() {
+        mType = kEffect_None;
+        mRate = 1.0f;        // 1 Hz
+        mIntensity = 0.5f;   // 50%
+        mLFOPhase = 0.0;
+        UpdateTailFrames();
+        ClearState();
+    }
+
+    // Sizes the delay lines for the sample rate. Allocates, so never call it from the
+    // render thread.
+    void SetSampleRate(double sampleRate) {
+        if (sampleRate == mSampleRate) return;
+        mSampleRate = sampleRate;
+        for (int channel = 0; channel < 2; channel++) {
+            mChorusDelay[channel].Allocate((kChorusBaseDelay + kChorusDepth) * sampleRate);
+            mFlangerDelay[channel].Allocate(kFlangerMaxDelay * sampleRate);
+        }
+        UpdateTailFrames();
+        ClearState();
+    }
+
+    void SetType(int type) {
+        mType = (type >= 0 && type < kNumEffectTypes) ? type : kEffect_None;
+        UpdateTailFrames();
+    }
+    int GetType() const { return mType; }
+
+    void SetRate(float rate) { mRate = rate; }
+    float GetRate() const { return mRate; }
+
+    void SetIntensity(float intensity) {
+        if (intensity != mIntensity) {
+            mIntensity = intensity;
+            UpdateTailFrames();
+        }
+    }
+    float GetIntensity() const { return mIntensity; }
+
+    // Frames an effect keeps sounding after its input stops, until it is 80 dB down: the
+    // chorus's longest delay; for the flanger, enough trips round its feedback loop; for
+    // the phaser, the all-passes ringing at their lowest (slowest) setting followed by
+    // the feedback.
+    static int GetTailFrames(int type, float intensity, double sampleRate) {
+        const double kDecay = log(1e-4);  // -80 dB
+        double feedback = intensity * 0.7;
+        double frames = 0.0;
+        switch (type) {
+            case kEffect_Chorus:
+                frames = (kChorusBaseDelay + kChorusDepth) * sampleRate + 2.0;
+                break;
+            case kEffect_Phaser:
+                frames = kPhaserStages * kDecay / log(fabs(PhaserCoefficient(-1.0f, sampleRate)));
+                if (feedback > 0.0) frames += kDecay / log(feedback);
+                break;
+            case kEffect_Flanger: {
+                double trips = (feedback > 0.0) ? kDecay / log(feedback) + 1.0 : 1.0;
+                frames = trips * kFlangerMaxDelay * sampleRate + 2.0;
+                break;
+            }
+            default:
+                break;
+        }
+        return (frames < 1e9) ? (int)ceil(frames) : 1000000000;
+    }
+
+    // Nothing left sounding: Process would leave the next block as it is
+    bool IsIdle() const { return mType == kEffect_None || mIdle; }
+
+    // Processes left and right (separate buffers) in place. activeFrames is how many
+    // frames at the start of the block had a voice sounding. Blocks with none and
+    // nothing audible in them run the effect on until its tail is over; after that it
+    // clears its state (so nothing decays on through denormals) and is idle.
+    void Process(float *left, float *right, int frames, int activeFrames) {
+        if (mType == kEffect_None || frames <= 0) return;
+
+        if (activeFrames == 0 && IsSilent(left, frames) && IsSilent(right, frames)) {
+            if (mIdle) return;
+            if (mSilentFrames >= mTailFrames) {
+                ClearState();
+                return;
+            }
+            mSilentFrames += frames;
+        } else {
+            mSilentFrames = 0;
+            mIdle = false;
+        }
+
+        ProcessFunction process = GetProcessFunction();
+        for (int offset = 0; offset < frames; offset += kMaxRampFrames) {
+            int length = frames - offset;
+            if (length > kMaxRampFrames) length = kMaxRampFrames;
+
+            // LFO values at the block's first and last frames
+            double increment = (mRate / mSampleRate) * 2.0 * M_PI;
+            double firstPhase = mLFOPhase + increment;
+            mLFOPhase += increment * length;
+            if (mLFOPhase >= 2.0 * M_PI) {
+                mLFOPhase = fmod(mLFOPhase, 2.0 * M_PI);
+            }
+            LFORamp lfo;
+            lfo.first[0] = sinf(firstPhase);
+            lfo.last[0] = sinf(mLFOPhase);
+            lfo.first[1] = cosf(firstPhase);  // A quarter cycle ahead
+            lfo.last[1] = cosf(mLFOPhase);
+
+            process(*this, left + offset, right + offset, length, lfo);
+        }
+    }
+
+private:
+    // Effect LFO at the first and last frames of a block, for the left and right channels
+    struct LFORamp {
+        float first[2];
+        float last[2];
+    };
+
+    typedef void (*ProcessFunction)(EffectsChain& chain, float *left, float *right, int frames,
+                                    const LFORamp& lfo);
+
+    static const int kPhaserStages = 4;
+
+    // Delay times in seconds
+    static constexpr double kChorusBaseDelay = 0.015;  // 15ms base
+    static constexpr double kChorusDepth = 0.002;      // ±2ms modulation
+    static constexpr double kFlangerMinDelay = 0.001;  // Sweeps from 1ms...
+    static constexpr double kFlangerMaxDelay = 0.004;  // ...to 4ms
+
+    void UpdateTailFrames() {
+        mTailFrames = GetTailFrames(mType, mIntensity, mSampleRate);
+    }
+
+    // Empty delay lines and filters, and idle
+    void ClearState() {
+        for (int channel = 0; channel < 2; channel++) {
+            mChorusDelay[channel].Clear();
+
+            for (int stage = 0; stage < kPhaserStages; stage++) {
+                mPhaserState[channel][stage] = 0.0f;
+            }
+            mPhaserFeedbackSample[channel] = 0.0f;
+
+            mFlangerDelay[channel].Clear();
+            mFlangerFeedbackSample[channel] = 0.0f;
+        }
+        mSilentFrames = 0;
+        mIdle = true;
+    }
+
+    static bool IsSilent(const float *samples, int frames) {
+        float peak = 0.0f;
+        for (int i = 0; i < frames; i++) {
+            peak = fmaxf(peak, fabsf(samples[i]));
+        }
+        return peak <= 0.00001f;
+    }
+
+    // Per-frame step of a value ramping from first to last across frames
+    static float RampStep(float first, float last, int frames) {
+        return (frames > 1) ? (last - first) / (float)(frames - 1) : 0.0f;
+    }
+
+    // Chorus - creates a doubling/thickening effect
+    static void ProcessChorus(EffectsChain& chain, float *left, float *right, int frames,
+                              const LFORamp& lfo) {
+        ChorusChannel(chain, 0, left, frames, lfo.first[0], lfo.last[0]);
+        ChorusChannel(chain, 1, right, frames, lfo.first[1], lfo.last[1]);
+    }
+
+    static void ChorusChannel(EffectsChain& chain, int channel, float *samples, int frames,
+                              float lfoFirst, float lfoLast) {
+        DelayLine& line = chain.mChorusDelay[channel];
+        float baseDelay = (float)(kChorusBaseDelay * chain.mSampleRate);
+        float depth = (float)(kChorusDepth * chain.mSampleRate);
+        float maxDelay = line.GetMaxDelay();
+        float delay = fminf(baseDelay + lfoFirst * depth, maxDelay);
+        float delayStep = RampStep(delay, fminf(baseDelay + lfoLast * depth, maxDelay), frames);
+
+        // Classic chorus uses a 50/50 mix at full intensity
+        float wet = chain.mIntensity * 0.5f;
+        float dry = 1.0f - wet;
+
+        for (int i = 0; i < frames; i++) {
+            float input = samples[i];
+            line.Write(input);
+            float delayed = line.Read(delay);
+            line.Advance();
+            samples[i] = input * dry + delayed * wet;
+            delay += delayStep;
+        }
+    }
+
+    // Phaser - creates sweeping notches with four first-order all-passes
+    static float PhaserCoefficient(float lfoValue, double sampleRate) {
+        float centerFreq = 200.0f + (lfoValue * 0.5f + 0.5f) * 1800.0f;
+        float tanOmega = tanf((float)(M_PI * centerFreq / sampleRate));
+        return (tanOmega - 1.0f) / (tanOmega + 1.0f);
+    }
+
+    static void ProcessPhaser(EffectsChain& chain, float *left, float *right, int frames,
+                              const LFORamp& lfo) {
+        float a = PhaserCoefficient(lfo.first[0], chain.mSampleRate);
+        float aStep = RampStep(a, PhaserCoefficient(lfo.last[0], chain.mSampleRate), frames);
+        PhaserChannel(chain, 0, left, frames, a, aStep);
+        PhaserChannel(chain, 1, right, frames, a, aStep);
+    }
+
+    static void PhaserChannel(EffectsChain& chain, int channel, float *samples, int frames,
+                              float a, float aStep) {
+        float feedback = chain.mIntensity * 0.7f;
+
+        float *state = chain.mPhaserState[channel];
+        float s1 = state[0];
+        float s2 = state[1];
+        float s3 = state[2];
+        float s4 = state[3];
+        float feedbackSample = chain.mPhaserFeedbackSample[channel];
+
+        for (int i = 0; i < frames; i++) {
+            float input = samples[i];
+
+            float stage1 = a * input + s1;
+            s1 = input - a * stage1;
+            float stage2 = a * stage1 + s2;
+            s2 = stage1 - a * stage2;
+            float stage3 = a * stage2 + s3;
+            s3 = stage2 - a * stage3;
+            float stage4 = a * stage3 + s4;
+            s4 = stage3 - a * stage4;
+
+            feedbackSample = stage4 + feedbackSample * feedback;
+            samples[i] = input + feedbackSample * 0.5f;
+            a += aStep;
+        }
+
+        state[0] = FlushDenormal(s1);
+        state[1] = FlushDenormal(s2);
+        state[2] = FlushDenormal(s3);
+        state[3] = FlushDenormal(s4);
+        chain.mPhaserFeedbackSample[channel] = FlushDenormal(feedbackSample);
+    }
+
+    // Flanger - creates jet plane whoosh effect
+    static void ProcessFlanger(EffectsChain& chain, float *left, float *right, int frames,
+                               const LFORamp& lfo) {
+        FlangerChannel(chain, 0, left, frames, lfo.first[0], lfo.last[0]);
+        FlangerChannel(chain, 1, right, frames, lfo.first[1], lfo.last[1]);
+    }
+
+    static void FlangerChannel(EffectsChain& chain, int channel, float *samples, int frames,
+                               float lfoFirst, float lfoLast) {
+        DelayLine& line = chain.mFlangerDelay[channel];
+        float minDelay = (float)(kFlangerMinDelay * chain.mSampleRate);
+        float sweep = (float)((kFlangerMaxDelay - kFlangerMinDelay) * chain.mSampleRate);
+        float maxDelay = line.GetMaxDelay();
+        float delay = fminf(minDelay + (lfoFirst * 0.5f + 0.5f) * sweep, maxDelay);
+        float delayStep = RampStep(delay, fminf(minDelay + (lfoLast * 0.5f + 0.5f) * sweep, maxDelay),
+                                   frames);
+        float feedback = chain.mIntensity * 0.7f;  // Reduced from 0.9 to prevent harsh distortion
+
+        float feedbackSample = chain.mFlangerFeedbackSample[channel];
+        for (int i = 0; i < frames; i++) {
+            float input = samples[i];
+
+            // Hard limit the feedback path to prevent harsh distortion
+            float inputWithFeedback = fminf(fmaxf(input + feedbackSample * feedback, -1.0f), 1.0f);
+            line.Write(inputWithFeedback);
+            feedbackSample = line.Read(delay);
+            line.Advance();
+
+            samples[i] = input * 0.5f + feedbackSample * 0.5f;
+            delay += delayStep;
+        }
+        chain.mFlangerFeedbackSample[channel] = FlushDenormal(feedbackSample);
+    }
+
+    static void ProcessNone(EffectsChain&, float *, float *, int, const LFORamp&) {}
+
+    // Indexed by EffectType
+    ProcessFunction GetProcessFunction() const {
+        static const ProcessFunction kFunctions[kNumEffectTypes] = {
+            ProcessNone, ProcessChorus, ProcessPhaser, ProcessFlanger
+        };
+        return kFunctions[mType];
+    }
+
+    double mSampleRate;
+
+    int mType;
+    float mRate;        // LFO rate: 0.1 to 10 Hz
+    float mIntensity;   // Effect depth: 0.0 to 1.0
+    double mLFOPhase;
+    int mTailFrames;    // GetTailFrames for the current settings
+    int mSilentFrames;  // Frames of silent input since something last played
+    bool mIdle;         // Tail over and state cleared
+
+    // Per channel (left, right)
+    DelayLine mChorusDelay[2];
+
+    float mPhaserState[2][kPhaserStages];
+    float mPhaserFeedbackSample[2];
+
+    DelayLine mFlangerDelay[2];
+    float mFlangerFeedbackSample[2];
+};
+
+#endif
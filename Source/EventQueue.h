@@ -0,0 +1,85 @@
+#ifndef __EventQueue_h__
+#define __EventQueue_h__
+
+#include <atomic>
+#include <stdint.h>
+
+// Fixed-capacity lock-free queue of events between a host's entry points and Render.
+// Any number of threads may push (hosts call MIDIEvent, StartNote and SetParameter
+// from different threads); only the render thread pops. Never allocates: when full,
+// Push drops the event and counts it as an overflow.
+template <class Event, int Capacity>
+class EventQueue {
+public:
+    static const int kCapacity = Capacity;
+    static_assert((Capacity & (Capacity - 1)) == 0, "EventQueue capacity must be a power of two");
+
+    EventQueue() {
+        Reset();
+    }
+
+    // Empties the queue. Not thread-safe (SynthEngine::Reset calls it).
+    void Reset() {
+        for (int i = 0; i < kCapacity; i++) {
+            mCells[i].sequence.store((uint32_t)i, std::memory_order_relaxed);
+        }
+        mPushPosition.store(0, std::memory_order_relaxed);
+        mPopPosition.store(0, std::memory_order_relaxed);
+        mOverflowCount.store(0, std::memory_order_relaxed);
+    }
+
+    bool Push(const Event& event) {
+        uint32_t position = mPushPosition.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &mCells[position & (kCapacity - 1)];
+            uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+            int32_t difference = (int32_t)(sequence - position);
+            if (difference == 0) {
+                // Cell is free for this position; claim it
+                if (mPushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                // Consumer hasn't freed this cell yet: the queue is full
+                mOverflowCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = mPushPosition.load(std::memory_order_relaxed);
+            }
+        }
+        cell->event = event;
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Render thread only
+    bool Pop(Event& event) {
+        uint32_t position = mPopPosition.load(std::memory_order_relaxed);
+        Cell& cell = mCells[position & (kCapacity - 1)];
+        uint32_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (sequence != position + 1) return false;
+        event = cell.event;
+        cell.sequence.store(position + kCapacity, std::memory_order_release);
+        mPopPosition.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Events dropped because the queue was full, since the last Reset
+    uint32_t GetOverflowCount() const {
+        return mOverflowCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Cell {
+        std::atomic<uint32_t> sequence;  // position + 1 when filled, position + kCapacity when free again
+        Event event;
+    };
+
+    Cell mCells[kCapacity];
+    std::atomic<uint32_t> mPushPosition;
+    std::atomic<uint32_t> mPopPosition;
+    std::atomic<uint32_t> mOverflowCount;
+};
+
+#endif
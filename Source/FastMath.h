@@ -0,0 +1,118 @@
+#ifndef __FastMath_h__
+#define __FastMath_h__
+
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+
+#if defined(__SSE__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#endif
+
+// 2^x without calling pow(). Splits x into an integer and a fraction in [-0.5, 0.5],
+// evaluates the fraction with a degree-6 polynomial (relative error < 2e-7, about
+// 0.0003 cents when used for pitch) and puts the integer part straight into the exponent.
+static inline double FastExp2(double x) {
+    if (x < -1000.0) return 0.0;
+    if (x > 1000.0) return HUGE_VAL;
+
+    double k = floor(x + 0.5);
+    double f = x - k;
+    double p = 1.0 + f * (6.931471805599453e-1 +
+                     f * (2.402265069591007e-1 +
+                     f * (5.550410866482158e-2 +
+                     f * (9.618129107628477e-3 +
+                     f * (1.333355814642844e-3 +
+                     f * 1.540353039338161e-4)))));
+
+    int64_t exponentBits = ((int64_t)k + 1023) << 52;
+    double scale;
+    memcpy(&scale, &exponentBits, sizeof(scale));
+    return p * scale;
+}
+
+// tan(x) for x in [0, pi/2) without calling tanf, relative error under 3e-7 (measured
+// over every float in the range): a [5/4] Pade approximant up to pi/4, and
+// 1 / tan(pi/2 - x) above it (where the approximant alone would run off as tan heads to
+// infinity). pi/2 - x is taken in double, as in float it loses x's low bits to rounding
+// and the error grows towards pi/2.
+static inline float FastTan(float x) {
+    bool reflect = (x > (float)(M_PI / 4.0));
+    if (reflect) x = (float)(M_PI / 2.0 - (double)x);
+    float x2 = x * x;
+    float t = x * (945.0f + x2 * (-105.0f + x2)) / (945.0f + x2 * (-420.0f + x2 * 15.0f));
+    return reflect ? 1.0f / t : t;
+}
+
+// tanh without calling tanhf: an odd degree-13 polynomial over an even degree-6 one,
+// within 4e-7 of tanh everywhere (the input is clamped where tanh rounds to 1 in float).
+// No branches, so a loop of them vectorizes.
+static inline float FastTanh(float x) {
+    const float kLimit = 7.90531110763549805f;
+    x = (x < -kLimit) ? -kLimit : x;  // Compares rather than fminf/fmaxf, which don't vectorize
+    x = (x > kLimit) ? kLimit : x;
+    float x2 = x * x;
+    float p = -2.76076847742355e-16f;
+    p = p * x2 + 2.00018790482477e-13f;
+    p = p * x2 - 8.60467152213735e-11f;
+    p = p * x2 + 5.12229709037114e-08f;
+    p = p * x2 + 1.48572235717979e-05f;
+    p = p * x2 + 6.37261928875436e-04f;
+    p = p * x2 + 4.89352455891786e-03f;
+    float q = 1.19825839466702e-06f;
+    q = q * x2 + 1.18534705686654e-04f;
+    q = q * x2 + 2.26843463243900e-03f;
+    q = q * x2 + 4.89352518554385e-03f;
+    return x * p / q;
+}
+
+// Zero for values too small to matter. Recursive filter and feedback state goes through
+// this at the end of each block, so it decays to exactly 0 rather than lingering in
+// denormals (up to a hundred times slower per operation on some CPUs) even where
+// ScopedFlushDenormals can't set the CPU to do it.
+static inline float FlushDenormal(float x) {
+    return (fabsf(x) < 1e-15f) ? 0.0f : x;
+}
+
+// Sets the CPU to flush denormal results and inputs to zero (FTZ and DAZ on x86, FZ on
+// ARM64) for as long as it exists, restoring the previous mode after. The render
+// thread holds one for each Render; render workers hold one for their whole life.
+// Does nothing on other CPUs.
+class ScopedFlushDenormals {
+public:
+    ScopedFlushDenormals() {
+#if defined(__SSE__) || defined(__x86_64__)
+        mSaved = _mm_getcsr();
+        _mm_setcsr(mSaved | kFlushToZero | kDenormalsAreZero);
+#elif defined(__aarch64__)
+        uint64_t fpcr;
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+        mSaved = fpcr;
+        fpcr |= kFlushToZero;
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+#endif
+    }
+
+    ~ScopedFlushDenormals() {
+#if defined(__SSE__) || defined(__x86_64__)
+        _mm_setcsr(mSaved);
+#elif defined(__aarch64__)
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(mSaved));
+#endif
+    }
+
+private:
+    ScopedFlushDenormals(const ScopedFlushDenormals&);
+    ScopedFlushDenormals& operator=(const ScopedFlushDenormals&);
+
+#if defined(__SSE__) || defined(__x86_64__)
+    static const unsigned int kFlushToZero = 0x8000;      // MXCSR FTZ
+    static const unsigned int kDenormalsAreZero = 0x0040; // MXCSR DAZ
+    unsigned int mSaved;
+#elif defined(__aarch64__)
+    static const uint64_t kFlushToZero = (uint64_t)1 << 24;  // FPCR FZ
+    uint64_t mSaved;
+#endif
+};
+
+#endif
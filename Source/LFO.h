@@ -0,0 +1,150 @@
+#ifndef __LFO_h__
+#define __LFO_h__
+
+#include <math.h>
+
+// Note lengths a tempo-synced LFO cycles at (kParam_LFOn_NoteDivision), in the order the
+// view lists them
+struct LFONoteDivision {
+    const char *name;
+    double cyclesPerBeat;  // Per quarter note
+};
+
+static constexpr LFONoteDivision kLFONoteDivisions[] = {
+    { "1/32", 8.0 },
+    { "1/16", 4.0 },
+    { "1/8", 2.0 },
+    { "1/4", 1.0 },
+    { "1/2", 0.5 },
+    { "1/1", 0.25 },
+    { "1/32T", 12.0 },
+    { "1/16T", 6.0 },
+    { "1/8T", 3.0 },
+    { "1/4T", 1.5 },
+    { "1/2T", 0.75 },
+    { "1/16.", 8.0 / 3.0 },  // Dotted: half as long again
+    { "1/8.", 4.0 / 3.0 },
+    { "1/4.", 2.0 / 3.0 },
+    { "1/2.", 1.0 / 3.0 },
+};
+
+static const int kNumLFONoteDivisions = (int)(sizeof(kLFONoteDivisions) / sizeof(kLFONoteDivisions[0]));
+
+// One of the synth's two global LFOs: sine, square, saw or triangle at a rate in Hz, or
+// tempo-synced to a note division.
+//
+// The phase increment is worked out when the rate, division, tempo or sample rate
+// changes, not per block. While the host plays, Sync sets a synced LFO's phase from its
+// song position at the start of each buffer, so it stays locked to the beat (and
+// restarts in the same place on every pass over the same bars) instead of drifting.
+//
+// Render thread only. Plain C++ with no Apple dependencies.
+class LFO {
+public:
+    LFO() {
+        mWaveform = 0;
+        mRate = 1.0f;
+        mTempoSync = false;
+        mNoteDivision = 2;
+        mTempo = 120.0;
+        mSampleRate = 44100.0;
+        UpdateIncrement();
+        Reset();
+    }
+
+    // Back to the start of a cycle
+    void Reset() {
+        mPhase = 0.0;
+    }
+
+    // 0=Sine, 1=Square, 2=Sawtooth, 3=Triangle
+    void SetWaveform(int waveform) { mWaveform = waveform; }
+
+    // Hz, when not tempo-synced
+    void SetRate(float rate) {
+        if (rate != mRate) {
+            mRate = rate;
+            UpdateIncrement();
+        }
+    }
+
+    void SetTempoSync(bool tempoSync) {
+        if (tempoSync != mTempoSync) {
+            mTempoSync = tempoSync;
+            UpdateIncrement();
+        }
+    }
+
+    // Index into kLFONoteDivisions
+    void SetNoteDivision(int division) {
+        division = (division < 0) ? 0 : (division >= kNumLFONoteDivisions ? kNumLFONoteDivisions - 1 : division);
+        if (division != mNoteDivision) {
+            mNoteDivision = division;
+            UpdateIncrement();
+        }
+    }
+
+    // Beats (quarter notes) per minute
+    void SetTempo(double tempo, double sampleRate) {
+        if (tempo != mTempo || sampleRate != mSampleRate) {
+            mTempo = tempo;
+            mSampleRate = sampleRate;
+            UpdateIncrement();
+        }
+    }
+
+    // A synced LFO takes its phase from the host's song position (beatPosition is the beat
+    // at the next frame). Call once per buffer while the host plays; a free-running LFO
+    // ignores it.
+    void Sync(double beatPosition) {
+        if (mTempoSync) {
+            double cycles = beatPosition * kLFONoteDivisions[mNoteDivision].cyclesPerBeat;
+            mPhase = (cycles - floor(cycles)) * 2.0 * M_PI;
+        }
+    }
+
+    // Moves on by frames and returns the value there (-1 to 1)
+    float Advance(int frames) {
+        mPhase += mPhaseIncrement * frames;
+        if (mPhase >= 2.0 * M_PI) {
+            mPhase = fmod(mPhase, 2.0 * M_PI);
+        }
+
+        float normalizedPhase = mPhase / (2.0 * M_PI);
+        switch (mWaveform) {
+            case 0: // Sine
+                return sinf(mPhase);
+            case 1: // Square
+                return (normalizedPhase < 0.5f) ? 1.0f : -1.0f;
+            case 2: // Sawtooth
+                return 2.0f * normalizedPhase - 1.0f;
+            case 3: // Triangle
+                return (normalizedPhase < 0.5f) ?
+                       (4.0f * normalizedPhase - 1.0f) :
+                       (-4.0f * normalizedPhase + 3.0f);
+            default:
+                return 0.0f;
+        }
+    }
+
+private:
+    void UpdateIncrement() {
+        double frequency = mRate;
+        if (mTempoSync) {
+            double beatsPerSecond = mTempo / 60.0;
+            frequency = beatsPerSecond * kLFONoteDivisions[mNoteDivision].cyclesPerBeat;
+        }
+        mPhaseIncrement = (frequency / mSampleRate) * 2.0 * M_PI;
+    }
+
+    int mWaveform;
+    float mRate;
+    bool mTempoSync;
+    int mNoteDivision;
+    double mTempo;
+    double mSampleRate;
+    double mPhaseIncrement;  // Radians per frame
+    double mPhase;           // Radians, 0 to 2 pi
+};
+
+#endif
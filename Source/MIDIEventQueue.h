@@ -0,0 +1,18 @@
+#ifndef __MIDIEventQueue_h__
+#define __MIDIEventQueue_h__
+
+#include <stdint.h>
+#include "EventQueue.h"
+
+// A MIDI event waiting to be applied at a frame offset within the next render buffer
+struct QueuedMIDIEvent {
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+    uint32_t offset;
+};
+
+// Between the MIDI entry points and Render
+typedef EventQueue<QueuedMIDIEvent, 1024> MIDIEventQueue;
+
+#endif
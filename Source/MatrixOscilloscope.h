@@ -2,10 +2,13 @@
 
 #define OSCILLOSCOPE_BUFFER_SIZE 512
 
+class ScopeRingBuffer;
+
 @interface MatrixOscilloscope : NSView
 
 - (instancetype)initWithFrame:(NSRect)frame;
-- (void)pushSamples:(const float *)samples count:(int)count;
+// The audio unit owns the ring and fills it from Render; the view only reads it
+- (void)setRingBuffer:(const ScopeRingBuffer *)ringBuffer;
 - (void)clear;
 
 @end
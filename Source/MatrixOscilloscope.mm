@@ -1,5 +1,5 @@
 #import "MatrixOscilloscope.h"
-#import <pthread.h>
+#include "ScopeRingBuffer.h"
 
 // Forward declare color helpers
 @interface ClaudeSynthView : NSView
@@ -10,10 +10,10 @@
 @end
 
 @implementation MatrixOscilloscope {
-    float *buffer;
+    const ScopeRingBuffer *ringBuffer;
+    float *buffer;        // Latest snapshot, oldest sample first
     int bufferSize;
-    int writeIndex;
-    pthread_mutex_t bufferMutex;
+    uint32_t clearPosition;  // Ring write position at the last clear
     NSTimer *refreshTimer;
 }
 
@@ -22,8 +22,8 @@
     if (self) {
         bufferSize = OSCILLOSCOPE_BUFFER_SIZE;
         buffer = (float *)calloc(bufferSize, sizeof(float));
-        writeIndex = 0;
-        pthread_mutex_init(&bufferMutex, NULL);
+        ringBuffer = NULL;
+        clearPosition = 0;
 
         // Refresh display at 30 FPS
         refreshTimer = [NSTimer scheduledTimerWithTimeInterval:1.0/30.0
@@ -37,29 +37,46 @@
 
 - (void)dealloc {
     [refreshTimer invalidate];
-    pthread_mutex_destroy(&bufferMutex);
     free(buffer);
 }
 
-- (void)pushSamples:(const float *)samples count:(int)count {
-    pthread_mutex_lock(&bufferMutex);
-
-    for (int i = 0; i < count; i++) {
-        buffer[writeIndex] = samples[i];
-        writeIndex = (writeIndex + 1) % bufferSize;
-    }
-
-    pthread_mutex_unlock(&bufferMutex);
+- (void)setRingBuffer:(const ScopeRingBuffer *)ring {
+    ringBuffer = ring;
+    [self clear];
 }
 
 - (void)clear {
-    pthread_mutex_lock(&bufferMutex);
     memset(buffer, 0, bufferSize * sizeof(float));
-    writeIndex = 0;
-    pthread_mutex_unlock(&bufferMutex);
+    if (ringBuffer) {
+        // Samples pushed before now stay hidden
+        uint32_t position = 0;
+        float discard;
+        if (ringBuffer->Snapshot(&discard, 1, position)) {
+            clearPosition = position;
+        }
+    }
     [self setNeedsDisplay:YES];
 }
 
+// Copies the newest samples out of the ring. If the render thread keeps racing the
+// copy, the previous snapshot is drawn again.
+- (int)updateSnapshot {
+    if (!ringBuffer) return 0;
+
+    uint32_t position = 0;
+    if (!ringBuffer->Snapshot(buffer, bufferSize, position)) {
+        return bufferSize;
+    }
+
+    // Blank anything from before the last clear
+    uint32_t fresh = position - clearPosition;
+    if (fresh < (uint32_t)bufferSize) {
+        memset(buffer, 0, (bufferSize - fresh) * sizeof(float));
+        return (int)fresh;
+    }
+    return bufferSize;
+}
+
 - (void)refresh:(NSTimer *)timer {
     [self setNeedsDisplay:YES];
 }
@@ -99,9 +116,9 @@
     [grid stroke];
 
     // Draw waveform
-    pthread_mutex_lock(&bufferMutex);
+    int validSamples = [self updateSnapshot];
 
-    if (writeIndex > 0) {
+    if (validSamples > 0) {
         // Check if there's a meaningful signal in the buffer
         float maxLevel = 0.0f;
         for (int i = 0; i < bufferSize; i++) {
@@ -116,8 +133,7 @@
         // Only use trigger if signal is above threshold (0.01 = -40dB)
         if (maxLevel > 0.01f) {
             // Find trigger point (rising edge zero-crossing) for stable display
-            int searchStart = writeIndex - bufferSize / 4;  // Look in recent quarter of buffer
-            if (searchStart < 0) searchStart += bufferSize;
+            int searchStart = bufferSize - bufferSize / 4;  // Look in recent quarter of buffer
 
             bool foundTrigger = false;
             for (int i = 0; i < bufferSize / 4; i++) {
@@ -177,8 +193,6 @@
         [[ClaudeSynthView matrixBrightGreen] setStroke];
         [waveform stroke];
     }
-
-    pthread_mutex_unlock(&bufferMutex);
 }
 
 @end
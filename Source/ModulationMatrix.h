@@ -0,0 +1,198 @@
+#ifndef __ModulationMatrix_h__
+#define __ModulationMatrix_h__
+
+#include <atomic>
+#include <string.h>
+
+static const int kNumModSlots = 16;
+
+// Modulation Matrix Sources (these are parameter values, so never renumber them)
+enum ModSource {
+    kModSource_None = 0,
+    kModSource_LFO1 = 1,
+    kModSource_LFO2 = 2,
+    kModSource_FilterEnv = 3,
+    kModSource_Velocity = 4,     // Per voice: note-on velocity, 0 to 1
+    kModSource_NoteNumber = 5,   // Per voice: (note - 60) / 64, so middle C is 0
+    kModSource_Aftertouch = 6,   // Channel pressure, 0 to 1
+    kModSource_ModWheel = 7,     // CC 1, 0 to 1
+    kModSource_AmpEnv = 8,       // Per voice: amplitude envelope level
+    kNumModSources = 9
+};
+
+// Modulation Matrix Destinations
+enum ModDest {
+    kModDest_None = 0,
+    kModDest_FilterCutoff = 1,
+    kModDest_FilterResonance = 2,
+    kModDest_MasterVolume = 3,
+    kModDest_Osc1_Detune = 4,
+    kModDest_Osc1_Volume = 5,
+    kModDest_Osc2_Detune = 6,
+    kModDest_Osc2_Volume = 7,
+    kModDest_Osc3_Detune = 8,
+    kModDest_Osc3_Volume = 9,
+    kNumModDestinations = 10
+};
+
+// Modulation amount for every destination, in the destination's own units. The fields
+// are in ModDest order, so destination d lives at float offset d - 1.
+struct ModulationValues {
+    float filterCutoffMod;
+    float filterResonanceMod;
+    float masterVolumeMod;
+    float osc1DetuneMod;
+    float osc1VolumeMod;
+    float osc2DetuneMod;
+    float osc2VolumeMod;
+    float osc3DetuneMod;
+    float osc3VolumeMod;
+};
+
+static const int kNumModulationValues = kNumModDestinations - 1;
+static_assert(sizeof(ModulationValues) == kNumModulationValues * sizeof(float),
+              "ModulationValues must be a plain array of floats in ModDest order");
+
+// One compiled matrix slot: values[destination] += sources[source] * scale
+struct ModulationRoute {
+    int source;       // ModSource, indexing a source array
+    int destination;  // Float offset into ModulationValues
+    float scale;      // Slot intensity times the destination's range
+};
+
+// Routes after compilation. Global sources are summed once per control block; routes
+// from per-voice sources are handed to VoiceBank, which applies them to each voice.
+struct ModulationRouteTable {
+    int numGlobalRoutes;
+    int numVoiceRoutes;
+    ModulationRoute globalRoutes[kNumModSlots];
+    ModulationRoute voiceRoutes[kNumModSlots];
+};
+
+// Adds the routes to values from the given source array. Branch-free multiply-accumulate.
+static inline void ApplyModulationRoutes(const ModulationRoute *routes, int numRoutes,
+                                         const float *sources, ModulationValues& values) {
+    float *destinations = (float *)&values;
+    for (int r = 0; r < numRoutes; r++) {
+        destinations[routes[r].destination] += sources[routes[r].source] * routes[r].scale;
+    }
+}
+
+static inline bool IsPerVoiceModSource(int source) {
+    return source == kModSource_Velocity || source == kModSource_NoteNumber || source == kModSource_AmpEnv;
+}
+
+// The modulation matrix: kNumModSlots source/destination/intensity slots, compiled into a
+// flat route table whenever a slot changes so the render loop never walks the slots.
+class ModulationMatrix {
+public:
+    struct Slot {
+        int source;
+        int destination;
+        float intensity;
+    };
+
+    ModulationMatrix() {
+        Reset();
+    }
+
+    // Empty slots and zeroed sources. Not thread-safe (SynthEngine::Reset calls it).
+    void Reset() {
+        memset(mSlots, 0, sizeof(mSlots));
+        memset(mSources, 0, sizeof(mSources));
+        memset(mTables, 0, sizeof(mTables));
+        mCurrentTable.store(0, std::memory_order_relaxed);
+    }
+
+    const Slot& GetSlot(int slot) const { return mSlots[slot]; }
+
+    // Slot setters recompile the route table (SynthEngine calls them from the render
+    // thread, between blocks)
+    void SetSlotSource(int slot, int source) {
+        mSlots[slot].source = source;
+        Compile();
+    }
+
+    void SetSlotDestination(int slot, int destination) {
+        mSlots[slot].destination = destination;
+        Compile();
+    }
+
+    void SetSlotIntensity(int slot, float intensity) {
+        mSlots[slot].intensity = intensity;
+        Compile();
+    }
+
+    // Current value of a global source
+    void SetSource(int source, float value) {
+        mSources[source] = value;
+    }
+
+    float GetSource(int source) const {
+        return mSources[source];
+    }
+
+    const ModulationRouteTable& GetRoutes() const {
+        return mTables[mCurrentTable.load(std::memory_order_acquire)];
+    }
+
+    // Sum of every route from a global source
+    ModulationValues Evaluate() const {
+        ModulationValues values;
+        memset(&values, 0, sizeof(values));
+        const ModulationRouteTable& routes = GetRoutes();
+        ApplyModulationRoutes(routes.globalRoutes, routes.numGlobalRoutes, mSources, values);
+        return values;
+    }
+
+private:
+    // Builds the table the render thread isn't using, then publishes it
+    void Compile() {
+        // Scale from intensity 1.0 to destination units
+        static const float kDestinationRange[kNumModDestinations] = {
+            0.0f,       // None
+            10000.0f,   // Filter cutoff (Hz)
+            5.0f,       // Filter resonance (Q)
+            0.5f,       // Master volume
+            100.0f,     // Osc 1 detune (cents)
+            0.5f,       // Osc 1 volume
+            100.0f,     // Osc 2 detune
+            0.5f,       // Osc 2 volume
+            100.0f,     // Osc 3 detune
+            0.5f        // Osc 3 volume
+        };
+
+        int next = 1 - mCurrentTable.load(std::memory_order_relaxed);
+        ModulationRouteTable& table = mTables[next];
+        table.numGlobalRoutes = 0;
+        table.numVoiceRoutes = 0;
+
+        for (int slot = 0; slot < kNumModSlots; slot++) {
+            const Slot& s = mSlots[slot];
+            if (s.source <= kModSource_None || s.source >= kNumModSources) continue;
+            if (s.destination <= kModDest_None || s.destination >= kNumModDestinations) continue;
+            if (s.intensity == 0.0f) continue;
+
+            ModulationRoute route;
+            route.source = s.source;
+            route.destination = s.destination - 1;
+            route.scale = s.intensity * kDestinationRange[s.destination];
+            if (IsPerVoiceModSource(s.source)) {
+                table.voiceRoutes[table.numVoiceRoutes++] = route;
+            } else {
+                table.globalRoutes[table.numGlobalRoutes++] = route;
+            }
+        }
+
+        mCurrentTable.store(next, std::memory_order_release);
+    }
+
+    Slot mSlots[kNumModSlots];
+    float mSources[kNumModSources];
+
+    // Double-buffered so a recompile never rewrites the table being rendered from
+    ModulationRouteTable mTables[2];
+    std::atomic<int> mCurrentTable;
+};
+
+#endif
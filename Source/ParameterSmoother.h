@@ -0,0 +1,98 @@
+#ifndef __ParameterSmoother_h__
+#define __ParameterSmoother_h__
+
+#include <limits.h>
+#include <stdint.h>
+
+// Linear ramps for the parameters that would otherwise step audibly (zipper noise) when
+// they change while notes sound. Each channel holds the value being heard and the target
+// it is ramping to; SynthEngine gives the rest of the synth the target at once and adds
+// value - target on top, so a finished ramp costs nothing.
+//
+// Channels are stored as parallel arrays and advanced all at once with branch-free
+// arithmetic, so Advance is a handful of vector instructions for the whole set. When no
+// channel is ramping (the usual case) it returns straight away.
+//
+// Render thread only. Plain C++ with no Apple dependencies.
+template <int kNumChannels>
+class ParameterSmoother {
+public:
+    ParameterSmoother() {
+        for (int channel = 0; channel < kNumChannels; channel++) {
+            Jump(channel, 0.0f);
+        }
+    }
+
+    // Straight to value, ending any ramp
+    void Jump(int channel, float value) {
+        mValue[channel] = value;
+        mTarget[channel] = value;
+        mStep[channel] = 0.0f;
+        mRemaining[channel] = 0;
+        UpdateRampState();
+    }
+
+    // From from to to over frames (a jump when frames is 0 or there's nowhere to go)
+    void Ramp(int channel, float from, float to, int frames) {
+        if (frames <= 0 || from == to) {
+            Jump(channel, to);
+            return;
+        }
+        mTarget[channel] = to;
+        mStep[channel] = (to - from) / (float)frames;
+        mRemaining[channel] = frames;
+        mValue[channel] = from;
+        UpdateRampState();
+    }
+
+    // From the value being heard to target over frames
+    void RampTo(int channel, float target, int frames) {
+        Ramp(channel, mValue[channel], target, frames);
+    }
+
+    void Advance(int frames) {
+        if (!mRamping) {
+            return;
+        }
+        for (int channel = 0; channel < kNumChannels; channel++) {
+            int32_t remaining = mRemaining[channel] - frames;
+            remaining = (remaining > 0) ? remaining : 0;
+            mRemaining[channel] = remaining;
+            // Measured back from the target, so every ramp lands on it exactly
+            mValue[channel] = mTarget[channel] - mStep[channel] * (float)remaining;
+        }
+        UpdateRampState();
+    }
+
+    bool IsRamping() const { return mRamping; }
+
+    // Frames until the next ramp ends (INT_MAX when none is running). Ending a control
+    // block there keeps the corner of the ramp on the right frame.
+    int GetFramesToNextEnd() const { return mFramesToNextEnd; }
+
+    float GetValue(int channel) const { return mValue[channel]; }
+    float GetTarget(int channel) const { return mTarget[channel]; }
+
+    // How far the value being heard is from the target
+    float GetOffset(int channel) const { return mValue[channel] - mTarget[channel]; }
+
+private:
+    void UpdateRampState() {
+        int32_t next = INT_MAX;
+        for (int channel = 0; channel < kNumChannels; channel++) {
+            int32_t remaining = (mRemaining[channel] > 0) ? mRemaining[channel] : INT_MAX;
+            next = (remaining < next) ? remaining : next;
+        }
+        mFramesToNextEnd = next;
+        mRamping = (next != INT_MAX);
+    }
+
+    float mValue[kNumChannels];
+    float mTarget[kNumChannels];
+    float mStep[kNumChannels];        // Change per frame
+    int32_t mRemaining[kNumChannels];  // Frames left in the ramp
+    int32_t mFramesToNextEnd;
+    bool mRamping;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef __ParameterStore_h__
+#define __ParameterStore_h__
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include "SynthParameters.h"
+#include "EventQueue.h"
+
+// The published value of every parameter, between the threads that set parameters and
+// the render thread that uses them.
+//
+// A setter stores the value and flags the parameter as changed; the render thread takes
+// every flag at once (TakeChanged) at the start of a render and applies those values in
+// one batch, so the engine's own state is only ever touched by the render thread. Any
+// number of threads may set at once without locks: values are float bits in atomics and
+// the flags are bitmask words. A value stored before its flag is set is the one the
+// render thread reads, or a newer one.
+//
+// Plain C++ with no Apple dependencies.
+class ParameterStore {
+public:
+    static const int kNumWords = (kNumParameterIDs + 63) / 64;
+
+    ParameterStore() {
+        Reset();
+    }
+
+    // Every value 0, nothing changed. Not thread-safe (SynthEngine::Reset calls it).
+    void Reset() {
+        for (int id = 0; id < kNumParameterIDs; id++) {
+            mValues[id].store(0, std::memory_order_relaxed);
+        }
+        for (int word = 0; word < kNumWords; word++) {
+            mChanged[word].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Any thread: the value, for the render thread to apply
+    void Set(uint32_t paramID, float value) {
+        Publish(paramID, value);
+        mChanged[paramID / 64].fetch_or((uint64_t)1 << (paramID % 64), std::memory_order_release);
+    }
+
+    // Any thread: the value, without asking the render thread to apply it (for values it
+    // already has, or reports)
+    void Publish(uint32_t paramID, float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        mValues[paramID].store(bits, std::memory_order_relaxed);
+    }
+
+    float Get(uint32_t paramID) const {
+        uint32_t bits = mValues[paramID].load(std::memory_order_relaxed);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // Render thread: moves the flags of everything set since the last call into changed
+    // (one bit per parameter ID) and clears them. False if nothing was set.
+    bool TakeChanged(uint64_t changed[kNumWords]) {
+        bool any = false;
+        for (int word = 0; word < kNumWords; word++) {
+            // A plain load first, so the common nothing-changed case writes nothing
+            changed[word] = 0;
+            if (mChanged[word].load(std::memory_order_relaxed) != 0) {
+                changed[word] = mChanged[word].exchange(0, std::memory_order_acquire);
+                any = true;
+            }
+        }
+        return any;
+    }
+
+private:
+    std::atomic<uint32_t> mValues[kNumParameterIDs];
+    std::atomic<uint64_t> mChanged[kNumWords];
+};
+
+// A parameter change scheduled at a frame offset within the next render buffer: a new
+// value at offset, or (rampFrames > 0) a ramp from startValue reaching value rampFrames
+// later, which carries on into later buffers if it has to
+struct QueuedParameterEvent {
+    uint32_t paramID;
+    uint32_t offset;
+    uint32_t rampFrames;
+    float startValue;
+    float value;
+};
+
+// Between the host's scheduled parameter changes and Render
+typedef EventQueue<QueuedParameterEvent, 1024> ParameterEventQueue;
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef __SIMDLanes_h__
+#define __SIMDLanes_h__
+
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Lane types for the VoiceBank kernels. Each one processes kWidth voices per
+// instruction behind the same set of static functions, so a kernel written as a
+// template runs unchanged on any of them. ScalarLanes is the reference path.
+//
+//   F: kWidth floats        U: kWidth 32-bit unsigned integers
+//   Div(a, b): a / b per lane (to float precision)
+//   SumPair(a, b, &sumA, &sumB): the lanes of a and of b each added up (sharing shuffles)
+
+struct ScalarLanes {
+    static const int kWidth = 1;
+    typedef float F;
+    typedef uint32_t U;
+
+    static inline F Load(const float *p) { return *p; }
+    static inline void Store(float *p, F v) { *p = v; }
+    static inline F Set(float x) { return x; }
+    static inline F Add(F a, F b) { return a + b; }
+    static inline F Sub(F a, F b) { return a - b; }
+    static inline F Mul(F a, F b) { return a * b; }
+    static inline F Div(F a, F b) { return a / b; }
+    static inline void SumPair(F a, F b, float *sumA, float *sumB) { *sumA = a; *sumB = b; }
+
+    static inline U LoadU(const uint32_t *p) { return *p; }
+    static inline void StoreU(uint32_t *p, U v) { *p = v; }
+    static inline U SetU(uint32_t x) { return x; }
+    static inline U AddU(U a, U b) { return a + b; }
+    static inline U AndU(U a, U b) { return a & b; }
+    static inline U ShiftRightU(U v, int bits) { return v >> bits; }
+    static inline F ToFloat(U v) { return (float)v; }  // v < 2^31
+};
+
+#if defined(__AVX2__)
+struct AVX2Lanes {
+    static const int kWidth = 8;
+    typedef __m256 F;
+    typedef __m256i U;
+
+    static inline F Load(const float *p) { return _mm256_loadu_ps(p); }
+    static inline void Store(float *p, F v) { _mm256_storeu_ps(p, v); }
+    static inline F Set(float x) { return _mm256_set1_ps(x); }
+    static inline F Add(F a, F b) { return _mm256_add_ps(a, b); }
+    static inline F Sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static inline F Mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static inline F Div(F a, F b) { return _mm256_div_ps(a, b); }
+    static inline void SumPair(F a, F b, float *sumA, float *sumB) {
+        __m128 a4 = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+        __m128 b4 = _mm_add_ps(_mm256_castps256_ps128(b), _mm256_extractf128_ps(b, 1));
+        __m128 s = _mm_add_ps(_mm_unpacklo_ps(a4, b4), _mm_unpackhi_ps(a4, b4));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        *sumA = _mm_cvtss_f32(s);
+        *sumB = _mm_cvtss_f32(_mm_shuffle_ps(s, s, 1));
+    }
+
+    static inline U LoadU(const uint32_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+    static inline void StoreU(uint32_t *p, U v) { _mm256_storeu_si256((__m256i *)p, v); }
+    static inline U SetU(uint32_t x) { return _mm256_set1_epi32((int)x); }
+    static inline U AddU(U a, U b) { return _mm256_add_epi32(a, b); }
+    static inline U AndU(U a, U b) { return _mm256_and_si256(a, b); }
+    static inline U ShiftRightU(U v, int bits) { return _mm256_srl_epi32(v, _mm_cvtsi32_si128(bits)); }
+    static inline F ToFloat(U v) { return _mm256_cvtepi32_ps(v); }
+};
+typedef AVX2Lanes VectorLanes;
+#define CLAUDESYNTH_HAS_VECTOR_LANES 1
+
+#elif defined(__SSE2__)
+struct SSE2Lanes {
+    static const int kWidth = 4;
+    typedef __m128 F;
+    typedef __m128i U;
+
+    static inline F Load(const float *p) { return _mm_loadu_ps(p); }
+    static inline void Store(float *p, F v) { _mm_storeu_ps(p, v); }
+    static inline F Set(float x) { return _mm_set1_ps(x); }
+    static inline F Add(F a, F b) { return _mm_add_ps(a, b); }
+    static inline F Sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static inline F Mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static inline F Div(F a, F b) { return _mm_div_ps(a, b); }
+    static inline void SumPair(F a, F b, float *sumA, float *sumB) {
+        // (a0+a2, b0+b2, a1+a3, b1+b3), then fold the high half onto the low
+        F s = _mm_add_ps(_mm_unpacklo_ps(a, b), _mm_unpackhi_ps(a, b));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        *sumA = _mm_cvtss_f32(s);
+        *sumB = _mm_cvtss_f32(_mm_shuffle_ps(s, s, 1));
+    }
+
+    static inline U LoadU(const uint32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+    static inline void StoreU(uint32_t *p, U v) { _mm_storeu_si128((__m128i *)p, v); }
+    static inline U SetU(uint32_t x) { return _mm_set1_epi32((int)x); }
+    static inline U AddU(U a, U b) { return _mm_add_epi32(a, b); }
+    static inline U AndU(U a, U b) { return _mm_and_si128(a, b); }
+    static inline U ShiftRightU(U v, int bits) { return _mm_srl_epi32(v, _mm_cvtsi32_si128(bits)); }
+    static inline F ToFloat(U v) { return _mm_cvtepi32_ps(v); }
+};
+typedef SSE2Lanes VectorLanes;
+#define CLAUDESYNTH_HAS_VECTOR_LANES 1
+
+#elif defined(__ARM_NEON)
+struct NEONLanes {
+    static const int kWidth = 4;
+    typedef float32x4_t F;
+    typedef uint32x4_t U;
+
+    static inline F Load(const float *p) { return vld1q_f32(p); }
+    static inline void Store(float *p, F v) { vst1q_f32(p, v); }
+    static inline F Set(float x) { return vdupq_n_f32(x); }
+    static inline F Add(F a, F b) { return vaddq_f32(a, b); }
+    static inline F Sub(F a, F b) { return vsubq_f32(a, b); }
+    static inline F Mul(F a, F b) { return vmulq_f32(a, b); }
+    static inline F Div(F a, F b) {
+#if defined(__aarch64__)
+        return vdivq_f32(a, b);
+#else
+        // Reciprocal estimate and two Newton-Raphson steps (32-bit NEON has no divide)
+        F r = vrecpeq_f32(b);
+        r = vmulq_f32(vrecpsq_f32(b, r), r);
+        r = vmulq_f32(vrecpsq_f32(b, r), r);
+        return vmulq_f32(a, r);
+#endif
+    }
+    static inline void SumPair(F a, F b, float *sumA, float *sumB) {
+        float32x2_t s = vpadd_f32(vadd_f32(vget_low_f32(a), vget_high_f32(a)),
+                                  vadd_f32(vget_low_f32(b), vget_high_f32(b)));
+        *sumA = vget_lane_f32(s, 0);
+        *sumB = vget_lane_f32(s, 1);
+    }
+
+    static inline U LoadU(const uint32_t *p) { return vld1q_u32(p); }
+    static inline void StoreU(uint32_t *p, U v) { vst1q_u32(p, v); }
+    static inline U SetU(uint32_t x) { return vdupq_n_u32(x); }
+    static inline U AddU(U a, U b) { return vaddq_u32(a, b); }
+    static inline U AndU(U a, U b) { return vandq_u32(a, b); }
+    static inline U ShiftRightU(U v, int bits) { return vshlq_u32(v, vdupq_n_s32(-bits)); }
+    static inline F ToFloat(U v) { return vcvtq_f32_u32(v); }
+};
+typedef NEONLanes VectorLanes;
+#define CLAUDESYNTH_HAS_VECTOR_LANES 1
+
+#else
+typedef ScalarLanes VectorLanes;
+#define CLAUDESYNTH_HAS_VECTOR_LANES 0
+#endif
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef __Saturator_h__
+#define __Saturator_h__
+
+#include <string.h>
+#include "FastMath.h"
+
+// All-pass coefficients of the half-band filters, from the elliptic design in Laurent de
+// Soras's HIIR. Even entries make up one all-pass chain and odd entries the other.
+//
+// Between the sample rate and 2x: flat (ripple under 1e-9 dB) up to 0.22 of the 2x rate
+// (19.4 kHz at 44.1 kHz) and at least 91 dB down from 0.28 of it, where aliases would
+// land below 19.4 kHz.
+static const float kHalfBandCoefficients2x[8] = {
+    0.0472898531f, 0.172780611f, 0.338517958f, 0.506977679f,
+    0.655273069f, 0.776489919f, 0.874512613f, 0.958945718f
+};
+
+// Between 2x and 4x: flat up to 0.15 of the 4x rate (26.5 kHz at 44.1 kHz) and at least
+// 87 dB down from 0.35 of it, where the 2x signal's images start.
+static const float kHalfBandCoefficients4x[5] = {
+    0.0542307809f, 0.199699579f, 0.398796974f, 0.621096845f, 0.862917813f
+};
+
+// A polyphase IIR half-band low-pass for changing the sample rate by 2. It runs as two
+// chains of first-order all-passes at the lower rate: upsampling, their outputs are the
+// even and odd samples at the higher rate; downsampling, the even and odd input samples
+// go through one chain each and are averaged. Nothing is spent on the samples that
+// upsampling would fill with zeros, and a handful of all-passes rejects as much as a FIR
+// ten times as long. The phase isn't linear, which a saturator can live with.
+template <int kNumCoefficients>
+class HalfBandFilter {
+public:
+    explicit HalfBandFilter(const float *coefficients) : mCoefficients(coefficients) {
+        Reset();
+    }
+
+    void Reset() {
+        memset(mInput, 0, sizeof(mInput));
+        memset(mOutput, 0, sizeof(mOutput));
+        mOddOutput = 0.0f;
+    }
+
+    // frames samples to 2 * frames, interpolated
+    void Upsample(const float *in, float *out, int frames) {
+        State state(*this);
+        for (int i = 0; i < frames; i++) {
+            out[2 * i] = state.RunChain(0, in[i]);
+            out[2 * i + 1] = state.RunChain(1, in[i]);
+        }
+        state.Store(*this);
+    }
+
+    // 2 * frames samples to frames, low-passed first
+    void Downsample(const float *in, float *out, int frames) {
+        State state(*this);
+        for (int i = 0; i < frames; i++) {
+            // The odd chain's output lags by one low-rate sample (it was the z^-1 branch)
+            out[i] = 0.5f * (state.RunChain(0, in[2 * i]) + state.oddOutput);
+            state.oddOutput = state.RunChain(1, in[2 * i + 1]);
+        }
+        state.Store(*this);
+    }
+
+private:
+    // The filter state copied out for a block, so the compiler can keep it in registers
+    // rather than storing and reloading it every sample
+    struct State {
+        float coefficients[kNumCoefficients];
+        float input[kNumCoefficients];   // Each all-pass's last input...
+        float output[kNumCoefficients];  // ...and output
+        float oddOutput;                 // Downsampling: the odd chain's last output
+
+        explicit State(const HalfBandFilter& filter) {
+            for (int stage = 0; stage < kNumCoefficients; stage++) {
+                coefficients[stage] = filter.mCoefficients[stage];
+                input[stage] = filter.mInput[stage];
+                output[stage] = filter.mOutput[stage];
+            }
+            oddOutput = filter.mOddOutput;
+        }
+
+        void Store(HalfBandFilter& filter) const {
+            for (int stage = 0; stage < kNumCoefficients; stage++) {
+                filter.mInput[stage] = FlushDenormal(input[stage]);
+                filter.mOutput[stage] = FlushDenormal(output[stage]);
+            }
+            filter.mOddOutput = FlushDenormal(oddOutput);
+        }
+
+        // x through one chain: all-passes (c + z^-1) / (1 + c z^-1) with coefficients
+        // chain, chain + 2, ...
+        float RunChain(int chain, float x) {
+            for (int stage = chain; stage < kNumCoefficients; stage += 2) {
+                float y = coefficients[stage] * (x - output[stage]) + input[stage];
+                input[stage] = x;
+                output[stage] = y;
+                x = y;
+            }
+            return x;
+        }
+    };
+
+    const float *mCoefficients;
+    float mInput[kNumCoefficients];
+    float mOutput[kNumCoefficients];
+    float mOddOutput;
+};
+
+// The saturation stage for one channel: tanh soft clipping, tanh(x * drive) / tanh(drive)
+// so full scale stays full scale, at 1x, 2x or 4x the sample rate.
+//
+// Clipping adds harmonics far above the input, and at the sample rate everything past
+// Nyquist folds back down as inharmonic aliases. Oversampled, the harmonics are made at
+// the higher rate and the half-band filters take out everything above the audio band
+// before coming back down, so only what lands above Nyquist at 2x (or 4x) can alias.
+// The normalisation is worked out when the drive changes, not per sample.
+//
+// Render thread only. Plain C++ with no Apple dependencies.
+class Saturator {
+public:
+    static const int kMaxFrames = 64;  // Longer blocks are processed in pieces
+
+    Saturator() : mUp2x(kHalfBandCoefficients2x), mDown2x(kHalfBandCoefficients2x),
+                  mUp4x(kHalfBandCoefficients4x), mDown4x(kHalfBandCoefficients4x) {
+        mOversampling = 2;
+        mMakeupDrive = 1.0f;
+        mMakeup = 1.0f / FastTanh(1.0f);
+    }
+
+    // Empty filters, for a signal that starts from silence
+    void Reset() {
+        mUp2x.Reset();
+        mDown2x.Reset();
+        mUp4x.Reset();
+        mDown4x.Reset();
+    }
+
+    // 1, 2 or 4 (anything else is 1)
+    void SetOversampling(int factor) {
+        factor = (factor == 2 || factor == 4) ? factor : 1;
+        if (factor != mOversampling) {
+            mOversampling = factor;
+            Reset();
+        }
+    }
+    int GetOversampling() const { return mOversampling; }
+
+    // Shapes frames samples in place. The drive (1 to 10) ramps linearly from driveStart
+    // on the first frame to driveEnd on the frame after the last.
+    void Process(float *samples, int frames, float driveStart, float driveEnd) {
+        float driveStep = (driveEnd - driveStart) / (float)frames;
+        float first = driveStart;
+        for (int offset = 0; offset < frames; offset += kMaxFrames) {
+            int length = frames - offset;
+            if (length > kMaxFrames) length = kMaxFrames;
+            float last = driveStart + driveStep * (float)(offset + length);
+            ProcessBlock(samples + offset, length, first, last);
+            first = last;
+        }
+    }
+
+private:
+    void ProcessBlock(float *samples, int frames, float driveStart, float driveEnd) {
+        float makeupStart = GetMakeup(driveStart);
+        float makeupEnd = GetMakeup(driveEnd);
+        int count = frames * mOversampling;
+        float driveStep = (driveEnd - driveStart) / (float)count;
+        float makeupStep = (makeupEnd - makeupStart) / (float)count;
+
+        switch (mOversampling) {
+            case 1:
+                Shape(samples, count, driveStart, driveStep, makeupStart, makeupStep);
+                break;
+            case 2:
+                mUp2x.Upsample(samples, m2x, frames);
+                Shape(m2x, count, driveStart, driveStep, makeupStart, makeupStep);
+                mDown2x.Downsample(m2x, samples, frames);
+                break;
+            case 4:
+                mUp2x.Upsample(samples, m2x, frames);
+                mUp4x.Upsample(m2x, m4x, frames * 2);
+                Shape(m4x, count, driveStart, driveStep, makeupStart, makeupStep);
+                mDown4x.Downsample(m4x, m2x, frames * 2);
+                mDown2x.Downsample(m2x, samples, frames);
+                break;
+        }
+    }
+
+    static void Shape(float *samples, int count, float drive, float driveStep,
+                      float makeup, float makeupStep) {
+        for (int i = 0; i < count; i++) {
+            samples[i] = FastTanh(samples[i] * (drive + driveStep * (float)i)) *
+                         (makeup + makeupStep * (float)i);
+        }
+    }
+
+    // 1 / tanh(drive), remembered for the last drive asked for (while the drive glides,
+    // each block starts where the last one ended)
+    float GetMakeup(float drive) {
+        if (drive != mMakeupDrive) {
+            mMakeupDrive = drive;
+            mMakeup = 1.0f / FastTanh(drive);
+        }
+        return mMakeup;
+    }
+
+    int mOversampling;
+    float mMakeupDrive;
+    float mMakeup;
+
+    HalfBandFilter<8> mUp2x;
+    HalfBandFilter<8> mDown2x;
+    HalfBandFilter<5> mUp4x;
+    HalfBandFilter<5> mDown4x;
+
+    float m2x[kMaxFrames * 2];  // The block at 2x
+    float m4x[kMaxFrames * 4];  // And at 4x
+};
+
+#endif
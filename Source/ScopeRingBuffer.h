@@ -0,0 +1,92 @@
+#ifndef __ScopeRingBuffer_h__
+#define __ScopeRingBuffer_h__
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+// Single-producer/single-consumer sample ring between Render and the oscilloscope.
+//
+// The render thread pushes with two memcpys and never waits: when the UI falls behind,
+// the oldest samples are simply overwritten. The UI takes a seqlock-style snapshot of
+// the most recent samples; if a push lands while it is copying, the copy is retried,
+// and after kMaxSnapshotAttempts the snapshot is skipped (the view keeps its last frame).
+//
+// Plain C++ with no Apple dependencies.
+class ScopeRingBuffer {
+public:
+    static const int kCapacity = 4096;  // Power of two; longest snapshot
+    static const int kMaxSnapshotAttempts = 4;
+
+    ScopeRingBuffer() {
+        Reset();
+    }
+
+    // Not thread-safe (SynthEngine::Reset calls it)
+    void Reset() {
+        memset(mSamples, 0, sizeof(mSamples));
+        mSequence.store(0, std::memory_order_relaxed);
+        mWritePosition.store(0, std::memory_order_relaxed);
+    }
+
+    // Render thread only. Of a push longer than the ring, only the newest kCapacity
+    // samples are kept, but the write position still counts them all.
+    void Push(const float *samples, int count) {
+        if (count <= 0) return;
+        uint32_t skipped = 0;
+        if (count > kCapacity) {
+            skipped = (uint32_t)(count - kCapacity);
+            samples += skipped;
+            count = kCapacity;
+        }
+
+        // Odd sequence while the samples are being written
+        uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+        mSequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        uint32_t position = mWritePosition.load(std::memory_order_relaxed) + skipped;
+        int start = (int)(position & (kCapacity - 1));
+        int first = kCapacity - start;
+        if (first > count) first = count;
+        memcpy(mSamples + start, samples, first * sizeof(float));
+        memcpy(mSamples, samples + first, (count - first) * sizeof(float));
+        mWritePosition.store(position + (uint32_t)count, std::memory_order_relaxed);
+
+        mSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Reader thread only. Copies the newest count samples (oldest first) into out; slots
+    // never written since Reset read as zero. Returns false if every attempt raced a
+    // push, in which case out is unspecified. writePosition receives the number of
+    // samples pushed since Reset (wrapping), so the reader can tell how much is new.
+    bool Snapshot(float *out, int count, uint32_t& writePosition) const {
+        if (count > kCapacity) count = kCapacity;
+
+        for (int attempt = 0; attempt < kMaxSnapshotAttempts; attempt++) {
+            uint32_t sequence = mSequence.load(std::memory_order_acquire);
+            if (sequence & 1) continue;
+
+            uint32_t position = mWritePosition.load(std::memory_order_relaxed);
+            int start = (int)((position - (uint32_t)count) & (kCapacity - 1));
+            int first = kCapacity - start;
+            if (first > count) first = count;
+            memcpy(out, mSamples + start, first * sizeof(float));
+            memcpy(out + first, mSamples, (count - first) * sizeof(float));
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (mSequence.load(std::memory_order_relaxed) == sequence) {
+                writePosition = position;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    float mSamples[kCapacity];
+    std::atomic<uint32_t> mSequence;       // Odd while a push is in progress
+    std::atomic<uint32_t> mWritePosition;  // Samples pushed since Reset (wraps)
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef __StateVariableFilter_h__
+#define __StateVariableFilter_h__
+
+#include <math.h>
+#include "FastMath.h"
+#include "SIMDLanes.h"
+
+// Voice filter responses (kParam_FilterMode)
+enum FilterMode {
+    kFilterMode_LowPass = 0,
+    kFilterMode_BandPass = 1,
+    kFilterMode_HighPass = 2,
+    kNumFilterModes
+};
+
+// The voice filter's coefficients at one frame
+struct SVFCoefficients {
+    float g;  // Integrator gain, tan(pi * cutoff / sampleRate)
+    float k;  // Damping, 1 / Q
+};
+
+// Cutoff in Hz and resonance as Q. The cutoff stops just short of Nyquist, where g would
+// be infinite.
+static inline SVFCoefficients ComputeSVFCoefficients(float cutoff, float resonance, double sampleRate) {
+    float ratio = fmaxf(0.0f, fminf(cutoff / (float)sampleRate, 0.49f));
+    SVFCoefficients c;
+    c.g = FastTan((float)M_PI * ratio);
+    c.k = 1.0f / resonance;
+    return c;
+}
+
+// Zero-delay-feedback state-variable filter: the topology-preserving transform of the
+// analog SVF (after Zavalishin and Simper), over Lanes::kWidth voices at once. Both
+// integrators are trapezoidal and the feedback loop is solved exactly each frame instead
+// of going through a unit delay, so the response is the analog filter's with the cutoff
+// prewarped onto the right frequency. It stays in tune and stable all the way to Nyquist,
+// at any sample rate and under any modulation, so it never needs bypassing.
+//
+// Each voice's state is its two integrators: band-pass (ic1) and low-pass (ic2).
+// Coefficients are ramped across a block from one edge to the other. When no lane's
+// coefficients move, the gains the loop needs are worked out once for the block;
+// otherwise g and k ramp and the gains are re-derived every frame (one divide).
+//
+// Render thread only. Plain C++ with no Apple dependencies.
+template <class Lanes>
+struct SVFLanes {
+    typedef typename Lanes::F F;
+
+    // Filters n frames of samples in place with the given response. Per lane, g and k
+    // start at gStart and kStart and change by gStep and kStep a frame.
+    static void Process(int mode, F *samples, int n, F& ic1, F& ic2,
+                        const float *gStart, const float *gStep,
+                        const float *kStart, const float *kStep, bool moving) {
+        switch (mode) {
+            case kFilterMode_BandPass:
+                Run<kFilterMode_BandPass>(samples, n, ic1, ic2, gStart, gStep, kStart, kStep, moving);
+                break;
+            case kFilterMode_HighPass:
+                Run<kFilterMode_HighPass>(samples, n, ic1, ic2, gStart, gStep, kStart, kStep, moving);
+                break;
+            default:
+                Run<kFilterMode_LowPass>(samples, n, ic1, ic2, gStart, gStep, kStart, kStep, moving);
+                break;
+        }
+    }
+
+private:
+    template <int kMode>
+    static inline F Output(F input, F bandpass, F lowpass, F k) {
+        if (kMode == kFilterMode_LowPass) return lowpass;
+        if (kMode == kFilterMode_BandPass) return bandpass;
+        return Lanes::Sub(Lanes::Sub(input, Lanes::Mul(k, bandpass)), lowpass);
+    }
+
+    // One frame: solves for the band-pass (v1) and low-pass (v2) outputs given the gains
+    // a1 = 1 / (1 + g (g + k)), a2 = g a1 and a3 = g a2, then moves the integrators on
+    template <int kMode>
+    static inline F Tick(F input, F& ic1, F& ic2, F a1, F a2, F a3, F k) {
+        F v3 = Lanes::Sub(input, ic2);
+        F v1 = Lanes::Add(Lanes::Mul(a1, ic1), Lanes::Mul(a2, v3));
+        F v2 = Lanes::Add(ic2, Lanes::Add(Lanes::Mul(a2, ic1), Lanes::Mul(a3, v3)));
+        ic1 = Lanes::Sub(Lanes::Add(v1, v1), ic1);
+        ic2 = Lanes::Sub(Lanes::Add(v2, v2), ic2);
+        return Output<kMode>(input, v1, v2, k);
+    }
+
+    template <int kMode>
+    static void Run(F *samples, int n, F& ic1, F& ic2, const float *gStart, const float *gStep,
+                    const float *kStart, const float *kStep, bool moving) {
+        const F one = Lanes::Set(1.0f);
+        F g0 = Lanes::Load(gStart);
+        F k0 = Lanes::Load(kStart);
+        if (!moving) {
+            F a1 = Lanes::Div(one, Lanes::Add(one, Lanes::Mul(g0, Lanes::Add(g0, k0))));
+            F a2 = Lanes::Mul(g0, a1);
+            F a3 = Lanes::Mul(g0, a2);
+            for (int i = 0; i < n; i++) {
+                samples[i] = Tick<kMode>(samples[i], ic1, ic2, a1, a2, a3, k0);
+            }
+            return;
+        }
+
+        F gRamp = Lanes::Load(gStep);
+        F kRamp = Lanes::Load(kStep);
+        for (int i = 0; i < n; i++) {
+            F frame = Lanes::Set((float)i);
+            F g = Lanes::Add(g0, Lanes::Mul(gRamp, frame));
+            F k = Lanes::Add(k0, Lanes::Mul(kRamp, frame));
+            F a1 = Lanes::Div(one, Lanes::Add(one, Lanes::Mul(g, Lanes::Add(g, k))));
+            F a2 = Lanes::Mul(g, a1);
+            F a3 = Lanes::Mul(g, a2);
+            samples[i] = Tick<kMode>(samples[i], ic1, ic2, a1, a2, a3, k);
+        }
+    }
+};
+
+#endif
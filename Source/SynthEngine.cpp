@@ -0,0 +1,1186 @@
+#include "SynthEngine.h"
+#include "ClaudeSynthLogger.h"
+#include "VoiceRenderPool.h"
+#include <chrono>
+#include <cmath>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The parameter table has literal copies of these (SynthParameters.h can't see them)
+static_assert(kParameterDescriptors[kParam_Polyphony].maxValue == kMaxVoices &&
+              kParameterDescriptors[kParam_Polyphony].defaultValue == kDefaultPolyphony &&
+              kParameterDescriptors[kParam_RenderThreads].maxValue == VoiceRenderPool::kMaxWorkers &&
+              kParameterDescriptors[kParam_ControlBlockSize].maxValue == kMaxVoiceBlockSize &&
+              kParameterDescriptors[kParam_Osc1_Unison].maxValue == kMaxUnison &&
+              kParameterDescriptors[ModSlotParameterID(0, 0)].maxValue == kNumModSources - 1 &&
+              kParameterDescriptors[ModSlotParameterID(0, 1)].maxValue == kNumModDestinations - 1 &&
+              kParameterDescriptors[kParam_LFO1_NoteDivision].maxValue == kNumLFONoteDivisions - 1 &&
+              kParameterDescriptors[kParam_LFO2_NoteDivision].maxValue == kNumLFONoteDivisions - 1,
+              "Parameter ranges must match the engine's limits");
+
+// Seconds a parameter takes to glide to a new value while notes sound
+static const double kParameterSmoothingTime = 0.01;
+
+// Monotonic time in seconds, for the stage timings
+static inline double StageClock() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SynthEngine::SynthEngine() : mSampleRate(44100.0), mRenderPool(NULL), mInitialized(false),
+                             mMinFramesForWorkers(VoiceRenderPool::kMinFramesForWorkers),
+                             mMinVoicesPerThread(VoiceRenderPool::kMinVoicesPerThread),
+                             mApplyingParameters(false), mVoiceSettingsChanged(false), mStageTimings(NULL) {
+    Reset();
+}
+
+SynthEngine::~SynthEngine() {
+    delete mRenderPool.load();
+}
+
+void SynthEngine::Reset() {
+    // Envelope, LFO and arpeggiator state (their settings are parameters, set below)
+    mFilterEnvLevel = 0.0f;
+    mFilterEnvStage = kEnvStage_Idle;
+    mFilterEnvReleaseStartLevel = 0.0f;
+    mActiveNoteCount = 0;
+    mLFO1.Reset();
+    mLFO1Output = 0.0f;
+    mLFO2.Reset();
+    mLFO2Output = 0.0f;
+
+    // Empty modulation matrix slots
+    mModMatrix.Reset();
+
+    // No effect, empty delay lines
+    mEffects.Reset();
+    mSaturating = false;
+
+    // Nothing held by the arpeggiator, and no host transport until one is set
+    mArp.Reset();
+    mTransport.tempo = 120.0;
+    mTransport.beatPosition = 0.0;
+    mTransport.playing = false;
+
+    // Empty oscilloscope feed
+    mScopeBuffer.Reset();
+
+    // Modulation starts neutral
+    memset(&mModulation, 0, sizeof(mModulation));
+
+    // Empty MIDI event queue
+    mMIDIQueue.Reset();
+    mLoggedMIDIOverflows = 0;
+
+    // No scheduled parameter changes
+    mParameterQueue.Reset();
+    mLoggedParameterOverflows = 0;
+
+    // No preset waiting
+    mPresetMailbox.Reset();
+
+    mVoices.Reset();
+
+    // Every parameter at its default, applied in one batch and published with nothing
+    // waiting to be applied
+    mParameters.Reset();
+    mApplyingParameters = true;
+    for (uint32_t paramID = 0; paramID < (uint32_t)kNumParameterIDs; paramID++) {
+        const ParameterDescriptor& descriptor = kParameterDescriptors[paramID];
+        if (!descriptor.readOnly) {
+            ApplyParameter(paramID, descriptor.defaultValue);
+        }
+        mParameters.Publish(paramID, descriptor.defaultValue);
+    }
+    mApplyingParameters = false;
+    UpdateAllVoices();
+    JumpSmoothedParameters();
+}
+
+void SynthEngine::Initialize() {
+    ClaudeLogStart();
+    ClaudeLog("Initialize called, sample rate = %f", mSampleRate);
+
+    // Band-limited oscillator tables are shared by all instances and only built once
+    WavetableBank& wavetables = WavetableBank::Shared();
+    if (!wavetables.IsBuilt()) {
+        wavetables.Build();
+        ClaudeLog("Initialize: built %d wavetables, %lu bytes",
+                  wavetables.GetTableCount(), (unsigned long)wavetables.GetMemoryUsage());
+    }
+
+    // Render workers, if a preset or the host already asked for them
+    {
+        std::lock_guard<std::mutex> lock(mRenderPoolLock);
+        mInitialized = true;
+    }
+    float renderThreads = 0.0f;
+    if (GetParameter(kParam_RenderThreads, &renderThreads) && renderThreads >= 1.0f) {
+        StartRenderWorkers();
+    }
+
+    // Effect delay lines long enough at this sample rate
+    mEffects.SetSampleRate(mSampleRate);
+
+    mVoices.AllNotesOff();
+}
+
+void SynthEngine::Uninitialize() {
+    mVoices.AllNotesOff();
+
+    std::lock_guard<std::mutex> lock(mRenderPoolLock);
+    mInitialized = false;
+    delete mRenderPool.load();
+    mRenderPool.store(NULL);
+}
+
+// Worker threads for multi-threaded voice rendering, one per core but the one left to the
+// host. Started once, on the thread that first asks for workers; Render picks the pool up
+// at its next slice.
+void SynthEngine::StartRenderWorkers() {
+    std::lock_guard<std::mutex> lock(mRenderPoolLock);
+    if (!mInitialized || mRenderPool.load()) return;
+    unsigned int cores = std::thread::hardware_concurrency();
+    int workers = (cores > 1) ? (int)cores - 1 : 0;
+    VoiceRenderPool *pool = new VoiceRenderPool;
+    pool->Start(workers);
+    mRenderPool.store(pool);
+    ClaudeLog("Started %d render worker(s)", pool->GetWorkerCount());
+}
+
+int SynthEngine::GetRenderWorkerCount() const {
+    VoiceRenderPool *pool = mRenderPool.load();
+    return pool ? pool->GetWorkerCount() : 0;
+}
+
+void SynthEngine::AllNotesOff() {
+    mVoices.AllNotesOff();
+}
+
+// Number of frames a linear segment at rate per frame takes to cover distance,
+// counting the frame that reaches it
+static int FramesToReach(float distance, float rate) {
+    if (distance <= 0.0f) return 1;
+    float frames = ceilf(distance / rate);
+    return (frames < 1.0f) ? 1 : (frames > 1e9f ? 1000000000 : (int)frames);
+}
+
+// Advance the global filter envelope by the given number of frames. Same result as
+// stepping it frame by frame, but costs one update per stage crossed.
+void SynthEngine::AdvanceGlobalFilterEnvelope(int frames) {
+    while (frames > 0) {
+        switch (mFilterEnvStage) {
+            case kEnvStage_Idle:
+                mFilterEnvLevel = 0.0f;
+                return;
+
+            case kEnvStage_Attack:
+                if (mFilterEnvAttack > 0.0001f) {
+                    float attackRate = 1.0f / (mFilterEnvAttack * mSampleRate);
+                    int length = FramesToReach(1.0f - mFilterEnvLevel, attackRate);
+                    if (frames < length) {
+                        mFilterEnvLevel += attackRate * frames;
+                        return;
+                    }
+                    frames -= length;
+                } else {
+                    frames--;
+                }
+                mFilterEnvLevel = 1.0f;
+                mFilterEnvStage = kEnvStage_Decay;
+                break;
+
+            case kEnvStage_Decay:
+                if (mFilterEnvDecay > 0.0001f) {
+                    float decayRate = (1.0f - mFilterEnvSustain) / (mFilterEnvDecay * mSampleRate);
+                    int length = (decayRate > 0.0f) ?
+                                 FramesToReach(mFilterEnvLevel - mFilterEnvSustain, decayRate) : 1;
+                    if (frames < length) {
+                        mFilterEnvLevel -= decayRate * frames;
+                        return;
+                    }
+                    frames -= length;
+                } else {
+                    frames--;
+                }
+                mFilterEnvLevel = mFilterEnvSustain;
+                mFilterEnvStage = kEnvStage_Sustain;
+                break;
+
+            case kEnvStage_Sustain:
+                mFilterEnvLevel = mFilterEnvSustain;
+                return;
+
+            case kEnvStage_Release:
+                if (mFilterEnvRelease > 0.0001f) {
+                    float releaseRate = mFilterEnvReleaseStartLevel / (mFilterEnvRelease * mSampleRate);
+                    int length = (releaseRate > 0.0f) ? FramesToReach(mFilterEnvLevel, releaseRate) : 1;
+                    if (frames < length) {
+                        mFilterEnvLevel -= releaseRate * frames;
+                        return;
+                    }
+                    frames -= length;
+                } else {
+                    frames--;
+                }
+                mFilterEnvLevel = 0.0f;
+                mFilterEnvStage = kEnvStage_Idle;
+                break;
+        }
+    }
+}
+
+// Plays what the arpeggiator does on this frame
+void SynthEngine::RunArpeggiator() {
+    ArpeggiatorAction action = mArp.Process();
+    if (action.releaseNote >= 0) {
+        mVoices.ReleaseNote(action.releaseNote);
+    }
+    if (action.startNote >= 0) {
+        mVoices.StartNote(action.startNote, 100, mSampleRate);  // Use velocity 100
+    }
+}
+
+// Advance the LFOs and filter envelope by the given number of frames and re-evaluate the
+// mod matrix. mModulation then holds the modulation for the frame after them.
+void SynthEngine::AdvanceModulation(int frames) {
+    float lfo1Value = mLFO1.Advance(frames);
+    float lfo2Value = mLFO2.Advance(frames);
+
+    // Store LFO outputs for indicators (convert from -1..1 to 0..1)
+    mLFO1Output = (lfo1Value + 1.0f) * 0.5f;
+    mLFO2Output = (lfo2Value + 1.0f) * 0.5f;
+
+    AdvanceGlobalFilterEnvelope(frames);
+
+    // Aftertouch and the mod wheel are set as MIDI arrives; per-voice sources are VoiceBank's
+    mModMatrix.SetSource(kModSource_LFO1, lfo1Value);
+    mModMatrix.SetSource(kModSource_LFO2, lfo2Value);
+    mModMatrix.SetSource(kModSource_FilterEnv, mFilterEnvLevel);
+    mModulation = mModMatrix.Evaluate();
+}
+
+// Render frames [start, end): all voices as one stereo block into the (cleared) output
+// buffers, then effects, saturation and master volume over the block. A mono output
+// (right == left) gets the two channels mixed down.
+void SynthEngine::RenderSlice(float *left, float *right, uint32_t start, uint32_t end,
+                              const VoiceBank::ModulationBlock& modBlock, float masterVolumeStart,
+                              float saturationStart, int renderWorkers) {
+    int length = (int)(end - start);
+    bool mono = (right == left);
+    float *mixLeft = left + start;
+    float *mixRight = right + start;
+    if (mono) {
+        mixRight = mMonoRight;
+        memset(mixRight, 0, length * sizeof(float));
+    }
+
+    double voicesStart = 0.0;
+    if (mStageTimings) {
+        voicesStart = StageClock();
+        mStageTimings->voiceFrames += (double)mVoices.GetActiveVoiceCount() * length;
+        mStageTimings->subOscillatorFrames += (double)mVoices.GetActiveVoiceCount() *
+                                              mVoices.GetSubOscillatorsPerVoice() * length;
+    }
+
+    // Frames at the start of the slice during which at least one voice was sounding
+    int activeFrames;
+    VoiceRenderPool *pool = (renderWorkers > 0) ? mRenderPool.load(std::memory_order_acquire) : NULL;
+    if (pool) {
+        activeFrames = pool->Render(mVoices, mixLeft, mixRight, length, modBlock, renderWorkers,
+                                    mMinVoicesPerThread);
+    } else {
+        activeFrames = mVoices.Render(mixLeft, mixRight, length, modBlock);
+    }
+
+    double effectsStart = 0.0;
+    if (mStageTimings) {
+        effectsStart = StageClock();
+        mStageTimings->voices += effectsStart - voicesStart;
+    }
+
+    // Effects before master volume
+    mEffects.Process(mixLeft, mixRight, length, activeFrames);
+
+    // Saturation and master volume ramp across the slice while they glide (the steps
+    // are 0 otherwise), landing on the smoothed values for the frame after it
+    float rampScale = 1.0f / (float)length;
+    float saturationEnd = mSmoothing.GetValue(kSmoothed_Saturation);
+    float masterVolumeEnd = mSmoothing.GetValue(kSmoothed_MasterVolume);
+    float masterVolumeStep = (masterVolumeEnd - masterVolumeStart) * rampScale;
+
+    // Drive: 1.0 to 10.0 based on saturation amount (the saturators add makeup gain).
+    // They start from empty filters whenever saturation comes back on.
+    float driveStart = 1.0f + (saturationStart * 9.0f);
+    float driveEnd = 1.0f + (saturationEnd * 9.0f);
+    bool saturating = (saturationStart > 0.0f || saturationEnd > 0.0f);
+    if (saturating && !mSaturating) {
+        mSaturators[0].Reset();
+        mSaturators[1].Reset();
+    }
+    mSaturating = saturating;
+
+    float *channels[2] = { mixLeft, mixRight };
+    for (int channel = 0; channel < 2; channel++) {
+        float *mix = channels[channel];
+
+        // Apply saturation (soft clipping with tanh, oversampled)
+        if (saturating) {
+            mSaturators[channel].Process(mix, length, driveStart, driveEnd);
+        }
+
+        // Apply master volume
+        for (int i = 0; i < length; i++) {
+            mix[i] *= masterVolumeStart + masterVolumeStep * (float)i;
+        }
+    }
+
+    if (mono) {
+        for (int i = 0; i < length; i++) {
+            mixLeft[i] = (mixLeft[i] + mixRight[i]) * 0.5f;
+        }
+    }
+
+    if (mStageTimings) {
+        mStageTimings->effects += StageClock() - effectsStart;
+    }
+}
+
+// Render frames [start, end) as one control block: modulation is evaluated once at the
+// end of the block and ramped from the value the previous block ended on. Parameters
+// that are gliding ramp across the block the same way.
+void SynthEngine::RenderControlBlock(float *left, float *right, uint32_t start, uint32_t end,
+                                     int renderWorkers) {
+    double modulationStart = mStageTimings ? StageClock() : 0.0;
+
+    VoiceBank::ModulationBlock modBlock;
+    modBlock.start = mModulation;
+    AdvanceModulation((int)(end - start));
+    modBlock.end = mModulation;
+
+    float masterVolumeStart = mSmoothing.GetValue(kSmoothed_MasterVolume);
+    float saturationStart = mSmoothing.GetValue(kSmoothed_Saturation);
+    if (mSmoothing.IsRamping()) {
+        AddSmoothingOffsets(modBlock.start);
+        mSmoothing.Advance((int)(end - start));
+        AddSmoothingOffsets(modBlock.end);
+    }
+
+    const ModulationRouteTable& routes = mModMatrix.GetRoutes();
+    modBlock.voiceRoutes = routes.voiceRoutes;
+    modBlock.numVoiceRoutes = routes.numVoiceRoutes;
+
+    if (mStageTimings) {
+        mStageTimings->modulation += StageClock() - modulationStart;
+    }
+
+    RenderSlice(left, right, start, end, modBlock, masterVolumeStart, saturationStart, renderWorkers);
+}
+
+bool SynthEngine::Render(float *left, float *right, uint32_t frames) {
+    // Decaying filters and envelopes would otherwise end in denormals, which are slow
+    ScopedFlushDenormals flushDenormals;
+
+    double renderStart = 0.0, modulationBefore = 0.0, voicesBefore = 0.0, effectsBefore = 0.0;
+    if (mStageTimings) {
+        renderStart = StageClock();
+        modulationBefore = mStageTimings->modulation;
+        voicesBefore = mStageTimings->voices;
+        effectsBefore = mStageTimings->effects;
+    }
+
+    // Parameters set and presets loaded since the last buffer take effect from its first frame
+    ApplyPendingParameters();
+
+    // The arpeggiator and synced LFOs run at the host's tempo, on its beat while it plays
+    mArp.SetTempo(mTransport.tempo, mSampleRate);
+    mLFO1.SetTempo(mTransport.tempo, mSampleRate);
+    mLFO2.SetTempo(mTransport.tempo, mSampleRate);
+    if (mTransport.playing) {
+        mArp.Sync(mTransport.beatPosition);
+        mLFO1.Sync(mTransport.beatPosition);
+        mLFO2.Sync(mTransport.beatPosition);
+    } else {
+        mArp.Unsync();
+    }
+
+    // Clear output buffers
+    memset(left, 0, frames * sizeof(float));
+    if (right != left) {
+        memset(right, 0, frames * sizeof(float));
+    }
+
+    // Voices render in control blocks of up to controlBlockSize frames. Modulation (LFOs,
+    // the filter envelope and the mod matrix) is evaluated once per block and ramped
+    // across it; MIDI events, scheduled parameter changes and the arpeggiator end a block
+    // early so they stay sample-accurate.
+    uint32_t controlBlockSize = (uint32_t)mControlBlockSize;
+
+    // Worker threads only pay off when the host buffer is long enough to keep them busy
+    int renderWorkers = mRenderThreads;
+    if (frames < (uint32_t)mMinFramesForWorkers) {
+        renderWorkers = 0;
+    }
+
+    // Take this buffer's MIDI events off the queue and order them by frame. Late or
+    // out-of-range offsets play on the last frame; events at the same frame keep their
+    // arrival order.
+    int numEvents = 0;
+    QueuedMIDIEvent *events = mRenderEvents;
+    while (frames > 0 && numEvents < MIDIEventQueue::kCapacity && mMIDIQueue.Pop(events[numEvents])) {
+        if (events[numEvents].offset >= frames) {
+            events[numEvents].offset = frames - 1;
+        }
+        QueuedMIDIEvent event = events[numEvents];
+        int i = numEvents++;
+        while (i > 0 && events[i - 1].offset > event.offset) {
+            events[i] = events[i - 1];
+            i--;
+        }
+        events[i] = event;
+    }
+    int nextEvent = 0;
+
+    // Same for scheduled parameter changes
+    int numParameterEvents = 0;
+    QueuedParameterEvent *parameterEvents = mRenderParameterEvents;
+    while (frames > 0 && numParameterEvents < ParameterEventQueue::kCapacity &&
+           mParameterQueue.Pop(parameterEvents[numParameterEvents])) {
+        if (parameterEvents[numParameterEvents].offset >= frames) {
+            parameterEvents[numParameterEvents].offset = frames - 1;
+        }
+        QueuedParameterEvent event = parameterEvents[numParameterEvents];
+        int i = numParameterEvents++;
+        while (i > 0 && parameterEvents[i - 1].offset > event.offset) {
+            parameterEvents[i] = parameterEvents[i - 1];
+            i--;
+        }
+        parameterEvents[i] = event;
+    }
+    int nextParameterEvent = 0;
+
+    uint32_t midiOverflows = mMIDIQueue.GetOverflowCount();
+    if (midiOverflows != mLoggedMIDIOverflows) {
+        ClaudeLogError("MIDI event queue full: %u events dropped", (unsigned int)midiOverflows);
+        mLoggedMIDIOverflows = midiOverflows;
+    }
+    uint32_t parameterOverflows = mParameterQueue.GetOverflowCount();
+    if (parameterOverflows != mLoggedParameterOverflows) {
+        ClaudeLogError("Parameter event queue full: %u changes dropped", (unsigned int)parameterOverflows);
+        mLoggedParameterOverflows = parameterOverflows;
+    }
+
+    // A buffer where nothing can sound (no voice, nothing due and the effect's tail over)
+    // stays cleared: only modulation and the arpeggiator's steps move on
+    bool silent = (numEvents == 0 && numParameterEvents == 0 && mVoices.GetActiveVoiceCount() == 0 &&
+                   !mSmoothing.IsRamping() && mEffects.IsIdle() &&
+                   (!mArpEnable || (uint32_t)mArp.GetFramesToNextAction() >= frames));
+
+    uint32_t frame = 0;
+    if (silent && frames > 0) {
+        double modulationStart = mStageTimings ? StageClock() : 0.0;
+        AdvanceModulation((int)frames);
+        mArp.Advance((int)frames);
+        frame = frames;
+        if (mStageTimings) {
+            mStageTimings->modulation += StageClock() - modulationStart;
+        }
+    }
+
+    while (frame < frames) {
+        // Apply parameter changes and then MIDI events that land on this frame. A block
+        // always ends on their frame, so both are sample-accurate.
+        bool parameterEventsNow = (nextParameterEvent < numParameterEvents &&
+                                   parameterEvents[nextParameterEvent].offset <= frame);
+        bool midiEventsNow = (nextEvent < numEvents && events[nextEvent].offset <= frame);
+        if (parameterEventsNow || midiEventsNow) {
+            while (nextParameterEvent < numParameterEvents &&
+                   parameterEvents[nextParameterEvent].offset <= frame) {
+                HandleParameterEvent(parameterEvents[nextParameterEvent]);
+                nextParameterEvent++;
+            }
+            while (nextEvent < numEvents && events[nextEvent].offset <= frame) {
+                HandleMIDIEvent(events[nextEvent]);
+                nextEvent++;
+            }
+
+            // Re-evaluate in place so a retriggered filter envelope or changed mod slot takes
+            // effect on this frame instead of ramping in over the next block
+            AdvanceModulation(0);
+        }
+
+        // Arpeggiator steps and gate ends are events too
+        if (mArpEnable && mArp.GetFramesToNextAction() == 0) {
+            RunArpeggiator();
+        }
+
+        // The block runs until the next of those, or a glide ending (so its corner is on
+        // the right frame), or the control block size
+        uint32_t end = frames;
+        if (end - frame > controlBlockSize) {
+            end = frame + controlBlockSize;
+        }
+        if (end - frame > (uint32_t)mSmoothing.GetFramesToNextEnd()) {
+            end = frame + (uint32_t)mSmoothing.GetFramesToNextEnd();
+        }
+        if (nextParameterEvent < numParameterEvents && parameterEvents[nextParameterEvent].offset < end) {
+            end = parameterEvents[nextParameterEvent].offset;
+        }
+        if (nextEvent < numEvents && events[nextEvent].offset < end) {
+            end = events[nextEvent].offset;
+        }
+        if (mArpEnable) {
+            uint32_t arpFrames = (uint32_t)mArp.GetFramesToNextAction();
+            arpFrames = (arpFrames > 0) ? arpFrames : 1;
+            if (end - frame > arpFrames) {
+                end = frame + arpFrames;
+            }
+        }
+
+        RenderControlBlock(left, right, frame, end, renderWorkers);
+        mArp.Advance((int)(end - frame));
+        frame = end;
+    }
+
+    // Feed the oscilloscope (lock-free; overwrites whatever the UI hasn't drawn)
+    mScopeBuffer.Push(left, (int)frames);
+
+    // LFO indicators for the view
+    mParameters.Publish(kParam_LFO1_Output, mLFO1Output);
+    mParameters.Publish(kParam_LFO2_Output, mLFO2Output);
+
+    // Whatever the other stages didn't account for is event and arpeggiator handling
+    if (mStageTimings) {
+        StageTimings& timings = *mStageTimings;
+        timings.events += (StageClock() - renderStart) -
+                          (timings.modulation - modulationBefore) -
+                          (timings.voices - voicesBefore) -
+                          (timings.effects - effectsBefore);
+        timings.frames += frames;
+    }
+    return silent;
+}
+
+bool SynthEngine::QueueMIDIEvent(uint8_t status, uint8_t data1, uint8_t data2, uint32_t offset) {
+    QueuedMIDIEvent event;
+    event.status = status;
+    event.data1 = data1 & 0x7F;
+    event.data2 = data2 & 0x7F;
+    event.offset = offset;
+    return mMIDIQueue.Push(event);
+}
+
+// Apply one MIDI event (called from Render at the event's frame)
+void SynthEngine::HandleMIDIEvent(const QueuedMIDIEvent& event) {
+    uint8_t status = event.status & 0xF0;
+    uint8_t noteNumber = event.data1 & 0x7F;
+    uint8_t velocity = event.data2 & 0x7F;
+
+    ClaudeLogDebug("MIDI Event: status=0x%02X, note=%d, vel=%d, offset=%u", status, noteNumber, velocity,
+              (unsigned int)event.offset);
+
+    switch (status) {
+        case 0x90: // Note On
+            ClaudeLogDebug("  -> Case 0x90 matched, velocity=%d", velocity);
+            if (velocity > 0) {
+                // While the arpeggiator is on, held notes go to it rather than to voices
+                if (mArpEnable) {
+                    if (mArp.AddNote(noteNumber)) {
+                        ClaudeLogDebug("  -> Added note %d to arpeggiator (count=%d)", noteNumber,
+                                       mArp.GetNumHeldNotes());
+                    }
+                    break;
+                }
+
+                // Normal (non-arpeggiator) note handling. The voice bank retriggers the
+                // note's own voice, takes a free one or steals one by the steal policy.
+                int voice = mVoices.StartNote(noteNumber, velocity, mSampleRate);
+                ClaudeLogDebug("  -> StartNote returned voice %d", voice);
+
+                if (voice >= 0) {
+                    // Increment active note count and trigger global filter envelope if idle
+                    mActiveNoteCount++;
+                    if (mFilterEnvStage == kEnvStage_Idle || mFilterEnvStage == kEnvStage_Release) {
+                        mFilterEnvLevel = 0.0f;  // Reset to 0 for clean attack
+                        mFilterEnvStage = kEnvStage_Attack;
+                    }
+
+                    ClaudeLogDebug("  -> Voice configured for note %d", noteNumber);
+                } else {
+                    ClaudeLogError("  -> StartNote found no voice!");
+                }
+            } else {
+                // If arpeggiator is enabled, remove note from held notes list
+                if (mArpEnable) {
+                    int release = mArp.RemoveNote(noteNumber);
+                    if (release >= 0 && mVoices.ReleaseNote(release)) {
+                        ClaudeLogDebug("  -> Stopped arp note %d", release);
+                    }
+                    break;  // Don't handle voice directly
+                }
+
+                // Normal note off handling
+                if (mVoices.ReleaseNote(noteNumber)) {
+                    // Decrement active note count and trigger global filter envelope release if last note
+                    mActiveNoteCount--;
+                    if (mActiveNoteCount <= 0) {
+                        mActiveNoteCount = 0;
+                        mFilterEnvStage = kEnvStage_Release;
+                        mFilterEnvReleaseStartLevel = mFilterEnvLevel;
+                    }
+
+                    ClaudeLogDebug("  -> Note off (vel=0) for note %d", noteNumber);
+                } else {
+                    ClaudeLogDebug("  -> Note off (vel=0) for note %d - voice not found!", noteNumber);
+                }
+            }
+            break;
+
+        case 0x80: // Note Off
+            {
+                // If arpeggiator is enabled, remove note from held notes list
+                if (mArpEnable) {
+                    int release = mArp.RemoveNote(noteNumber);
+                    if (release >= 0 && mVoices.ReleaseNote(release)) {
+                        ClaudeLogDebug("  -> Stopped arp note %d", release);
+                    }
+                    break;  // Don't handle voice directly
+                }
+
+                // Normal note off handling
+                if (mVoices.ReleaseNote(noteNumber)) {
+                    // Decrement active note count and trigger global filter envelope release if last note
+                    mActiveNoteCount--;
+                    if (mActiveNoteCount <= 0) {
+                        mActiveNoteCount = 0;
+                        mFilterEnvStage = kEnvStage_Release;
+                        mFilterEnvReleaseStartLevel = mFilterEnvLevel;
+                    }
+
+                    ClaudeLogDebug("  -> Note off for note %d", noteNumber);
+                } else {
+                    ClaudeLogDebug("  -> Note off for note %d - voice not found!", noteNumber);
+                }
+            }
+            break;
+
+        case 0xB0: // Control Change
+            if (event.data1 == 1) {  // Mod wheel
+                mModMatrix.SetSource(kModSource_ModWheel, event.data2 / 127.0f);
+            }
+            break;
+
+        case 0xD0: // Channel Pressure (aftertouch)
+            mModMatrix.SetSource(kModSource_Aftertouch, event.data1 / 127.0f);
+            break;
+    }
+}
+
+void SynthEngine::UpdateAllVoices() {
+    if (mApplyingParameters) {
+        mVoiceSettingsChanged = true;  // Done once the whole batch is applied
+        return;
+    }
+
+    // Voice settings are shared by the whole bank, so this is one update, not one per voice
+    mVoices.SetOscillator(0, mOsc1.waveform, mOsc1.octave,
+                               mOsc1.detune, mOsc1.volume);
+    mVoices.SetOscillator(1, mOsc2.waveform, mOsc2.octave,
+                               mOsc2.detune, mOsc2.volume);
+    mVoices.SetOscillator(2, mOsc3.waveform, mOsc3.octave,
+                               mOsc3.detune, mOsc3.volume);
+    mVoices.SetUnison(0, mOsc1.unison, mOsc1.unisonDetune, mOsc1.unisonWidth);
+    mVoices.SetUnison(1, mOsc2.unison, mOsc2.unisonDetune, mOsc2.unisonWidth);
+    mVoices.SetUnison(2, mOsc3.unison, mOsc3.unisonDetune, mOsc3.unisonWidth);
+    mVoices.SetFilterCutoff(mFilterCutoff);
+    mVoices.SetFilterResonance(mFilterResonance);
+    mVoices.SetEnvelope(mEnvAttack, mEnvDecay,
+                             mEnvSustain, mEnvRelease);
+    // Filter envelope is now global, not per-voice
+}
+
+bool SynthEngine::SetParameter(uint32_t paramID, float value) {
+    if (paramID >= (uint32_t)kNumParameterIDs || IsReadOnlyParameter(paramID)) {
+        return false;
+    }
+    value = ClampParameter(paramID, value);
+    mParameters.Set(paramID, value);
+    if (paramID == kParam_RenderThreads && value >= 1.0f) {
+        StartRenderWorkers();
+    }
+    return true;
+}
+
+bool SynthEngine::QueueParameterEvent(uint32_t paramID, float value, uint32_t offset) {
+    return QueueParameterRamp(paramID, value, value, offset, 0);
+}
+
+bool SynthEngine::QueueParameterRamp(uint32_t paramID, float startValue, float endValue,
+                                     uint32_t offset, uint32_t rampFrames) {
+    if (paramID >= (uint32_t)kNumParameterIDs || IsReadOnlyParameter(paramID)) {
+        return false;
+    }
+    QueuedParameterEvent event;
+    event.paramID = paramID;
+    event.offset = offset;
+    event.rampFrames = (rampFrames < (uint32_t)INT_MAX) ? rampFrames : (uint32_t)INT_MAX;
+    event.startValue = ClampParameter(paramID, startValue);
+    event.value = ClampParameter(paramID, endValue);
+    return mParameterQueue.Push(event);
+}
+
+bool SynthEngine::GetParameter(uint32_t paramID, float *value) const {
+    if (paramID >= (uint32_t)kNumParameterIDs) {
+        return false;
+    }
+    if (paramID == kParam_MIDIQueueOverflows) {
+        *value = (float)mMIDIQueue.GetOverflowCount();
+    } else {
+        *value = mParameters.Get(paramID);
+    }
+    return true;
+}
+
+// Applies everything waiting in one batch: a loaded preset, then parameters set since
+// the last call (a parameter set after the load wins; one set before it has already
+// been overwritten in mParameters by LoadPreset). Render thread.
+void SynthEngine::ApplyPendingParameters() {
+    const SynthPreset *preset = mPresetMailbox.Take();
+    uint64_t changed[ParameterStore::kNumWords];
+    bool anyChanged = mParameters.TakeChanged(changed);
+    if (!preset && !anyChanged) {
+        return;
+    }
+
+    mApplyingParameters = true;
+    mVoiceSettingsChanged = false;
+    if (preset) {
+        for (uint32_t paramID = 0; paramID < (uint32_t)kNumParameterIDs; paramID++) {
+            if (preset->present[paramID]) {
+                GlideParameter(paramID, preset->values[paramID]);
+            }
+        }
+    }
+    for (int word = 0; word < ParameterStore::kNumWords; word++) {
+        for (uint64_t bits = changed[word]; bits != 0; bits &= bits - 1) {
+            uint32_t paramID = (uint32_t)(word * 64 + __builtin_ctzll(bits));
+            GlideParameter(paramID, mParameters.Get(paramID));
+        }
+    }
+    mApplyingParameters = false;
+    if (mVoiceSettingsChanged) {
+        UpdateAllVoices();
+    }
+}
+
+// The ParameterSmoother channel of a parameter that glides, or -1
+int SynthEngine::GetSmoothedParameter(uint32_t paramID) {
+    switch (paramID) {
+        case kParam_FilterCutoff: return kSmoothed_FilterCutoff;
+        case kParam_FilterResonance: return kSmoothed_FilterResonance;
+        case kParam_Osc1_Detune: return kSmoothed_Osc1Detune;
+        case kParam_Osc1_Volume: return kSmoothed_Osc1Volume;
+        case kParam_Osc2_Detune: return kSmoothed_Osc2Detune;
+        case kParam_Osc2_Volume: return kSmoothed_Osc2Volume;
+        case kParam_Osc3_Detune: return kSmoothed_Osc3Detune;
+        case kParam_Osc3_Volume: return kSmoothed_Osc3Volume;
+        case kParam_MasterVolume: return kSmoothed_MasterVolume;
+        case kParam_Saturation: return kSmoothed_Saturation;
+        default: return -1;
+    }
+}
+
+// Applies a parameter from Render. One that glides ramps from the value being heard to
+// the new one over kParameterSmoothingTime; with no voice sounding nothing would hear
+// the step, so it jumps.
+void SynthEngine::GlideParameter(uint32_t paramID, float value) {
+    ApplyParameter(paramID, value);
+    int channel = GetSmoothedParameter(paramID);
+    if (channel < 0) {
+        return;
+    }
+    if (mVoices.GetActiveVoiceCount() > 0) {
+        mSmoothing.RampTo(channel, value, (int)(kParameterSmoothingTime * mSampleRate + 0.5));
+    } else {
+        mSmoothing.Jump(channel, value);
+    }
+}
+
+// Ends every glide at the current parameter values (after setting them outside Render)
+void SynthEngine::JumpSmoothedParameters() {
+    mSmoothing.Jump(kSmoothed_FilterCutoff, mFilterCutoff);
+    mSmoothing.Jump(kSmoothed_FilterResonance, mFilterResonance);
+    mSmoothing.Jump(kSmoothed_Osc1Detune, mOsc1.detune);
+    mSmoothing.Jump(kSmoothed_Osc1Volume, mOsc1.volume);
+    mSmoothing.Jump(kSmoothed_Osc2Detune, mOsc2.detune);
+    mSmoothing.Jump(kSmoothed_Osc2Volume, mOsc2.volume);
+    mSmoothing.Jump(kSmoothed_Osc3Detune, mOsc3.detune);
+    mSmoothing.Jump(kSmoothed_Osc3Volume, mOsc3.volume);
+    mSmoothing.Jump(kSmoothed_MasterVolume, mMasterVolume);
+    mSmoothing.Jump(kSmoothed_Saturation, mSaturation);
+}
+
+// Apply one scheduled parameter change (called from Render at the event's frame). The
+// new value is reported from here on, since until now the old one was still in effect.
+void SynthEngine::HandleParameterEvent(const QueuedParameterEvent& event) {
+    mParameters.Publish(event.paramID, event.value);
+    if (event.rampFrames == 0) {
+        GlideParameter(event.paramID, event.value);
+        return;
+    }
+    ApplyParameter(event.paramID, event.value);
+    int channel = GetSmoothedParameter(event.paramID);
+    if (channel >= 0) {
+        mSmoothing.Ramp(channel, event.startValue, event.value, (int)event.rampFrames);
+    }
+}
+
+// The smoothed parameters' distance from their targets, onto the modulation of the
+// voices (the voices already have the targets)
+void SynthEngine::AddSmoothingOffsets(ModulationValues& values) const {
+    values.filterCutoffMod += mSmoothing.GetOffset(kSmoothed_FilterCutoff);
+    values.filterResonanceMod += mSmoothing.GetOffset(kSmoothed_FilterResonance);
+    values.osc1DetuneMod += mSmoothing.GetOffset(kSmoothed_Osc1Detune);
+    values.osc1VolumeMod += mSmoothing.GetOffset(kSmoothed_Osc1Volume);
+    values.osc2DetuneMod += mSmoothing.GetOffset(kSmoothed_Osc2Detune);
+    values.osc2VolumeMod += mSmoothing.GetOffset(kSmoothed_Osc2Volume);
+    values.osc3DetuneMod += mSmoothing.GetOffset(kSmoothed_Osc3Detune);
+    values.osc3VolumeMod += mSmoothing.GetOffset(kSmoothed_Osc3Volume);
+}
+
+// Sets the engine state for one parameter (render thread, or with no render running)
+bool SynthEngine::ApplyParameter(uint32_t paramID, float value) {
+    // Mod matrix slots recompile the route table
+    int modSlot, modField;
+    if (DecodeModSlotParameterID(paramID, &modSlot, &modField)) {
+        if (modField == 0) {
+            mModMatrix.SetSlotSource(modSlot, (int)value);
+        } else if (modField == 1) {
+            mModMatrix.SetSlotDestination(modSlot, (int)value);
+        } else {
+            mModMatrix.SetSlotIntensity(modSlot, value);
+        }
+        return true;
+    }
+
+    switch (paramID) {
+        case kParam_MasterVolume:
+            mMasterVolume = value;
+            return true;
+
+        case kParam_Saturation:
+            mSaturation = value;
+            return true;
+
+        case kParam_SaturationOversampling:
+            for (int channel = 0; channel < 2; channel++) {
+                mSaturators[channel].SetOversampling(1 << (int)value);
+            }
+            return true;
+
+        case kParam_StereoSpread:
+            mStereoSpread = value;
+            mVoices.SetStereoSpread(value);
+            return true;
+
+        case kParam_VoiceStealPolicy:
+            mVoices.SetStealPolicy((int)value);
+            return true;
+
+        case kParam_Polyphony:
+            mVoices.SetPolyphony((int)value);
+            return true;
+
+        case kParam_Osc1_Waveform:
+            mOsc1.waveform = (int)value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc1_Octave:
+            mOsc1.octave = (int)value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc1_Detune:
+            mOsc1.detune = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc1_Volume:
+            mOsc1.volume = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc1_Unison:
+            mOsc1.unison = (int)value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc1_UnisonDetune:
+            mOsc1.unisonDetune = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc1_UnisonWidth:
+            mOsc1.unisonWidth = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc2_Waveform:
+            mOsc2.waveform = (int)value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc2_Octave:
+            mOsc2.octave = (int)value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc2_Detune:
+            mOsc2.detune = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc2_Volume:
+            mOsc2.volume = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc2_Unison:
+            mOsc2.unison = (int)value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc2_UnisonDetune:
+            mOsc2.unisonDetune = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc2_UnisonWidth:
+            mOsc2.unisonWidth = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc3_Waveform:
+            mOsc3.waveform = (int)value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc3_Octave:
+            mOsc3.octave = (int)value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc3_Detune:
+            mOsc3.detune = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc3_Volume:
+            mOsc3.volume = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc3_Unison:
+            mOsc3.unison = (int)value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc3_UnisonDetune:
+            mOsc3.unisonDetune = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_Osc3_UnisonWidth:
+            mOsc3.unisonWidth = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_FilterCutoff:
+            mFilterCutoff = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_FilterResonance:
+            mFilterResonance = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_FilterMode:
+            mVoices.SetFilterMode((int)value);
+            return true;
+
+        case kParam_EnvAttack:
+            mEnvAttack = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_EnvDecay:
+            mEnvDecay = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_EnvSustain:
+            mEnvSustain = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_EnvRelease:
+            mEnvRelease = value;
+            UpdateAllVoices();
+            return true;
+
+        // Filter Envelope
+        case kParam_FilterEnvAttack:
+            mFilterEnvAttack = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_FilterEnvDecay:
+            mFilterEnvDecay = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_FilterEnvSustain:
+            mFilterEnvSustain = value;
+            UpdateAllVoices();
+            return true;
+
+        case kParam_FilterEnvRelease:
+            mFilterEnvRelease = value;
+            UpdateAllVoices();
+            return true;
+
+        // LFO 1
+        case kParam_LFO1_Waveform:
+            mLFO1.SetWaveform((int)value);
+            return true;
+
+        case kParam_LFO1_Rate:
+            mLFO1.SetRate(value);
+            return true;
+
+        case kParam_LFO1_TempoSync:
+            mLFO1.SetTempoSync(value > 0.5f);
+            return true;
+
+        case kParam_LFO1_NoteDivision:
+            mLFO1.SetNoteDivision((int)value);
+            return true;
+
+        // LFO 2
+        case kParam_LFO2_Waveform:
+            mLFO2.SetWaveform((int)value);
+            return true;
+
+        case kParam_LFO2_Rate:
+            mLFO2.SetRate(value);
+            return true;
+
+        case kParam_LFO2_TempoSync:
+            mLFO2.SetTempoSync(value > 0.5f);
+            return true;
+
+        case kParam_LFO2_NoteDivision:
+            mLFO2.SetNoteDivision((int)value);
+            return true;
+
+        case kParam_EffectType:
+            mEffects.SetType((int)value);
+            return true;
+
+        case kParam_EffectRate:
+            mEffects.SetRate(value);
+            return true;
+
+        case kParam_EffectIntensity:
+            mEffects.SetIntensity(value);
+            return true;
+
+        case kParam_ArpEnable:
+            mArpEnable = (value > 0.5f);
+            // Switching off forgets the held notes and stops the note it was playing
+            if (!mArpEnable) {
+                int release = mArp.Clear();
+                if (release >= 0) {
+                    mVoices.ReleaseNote(release);
+                }
+            }
+            return true;
+
+        case kParam_ArpRate:
+            mArp.SetRate((int)value);
+            return true;
+
+        case kParam_ArpMode:
+            mArp.SetMode((int)value);
+            return true;
+
+        case kParam_ArpOctaves:
+            mArp.SetOctaves((int)value);
+            return true;
+
+        case kParam_ArpGate:
+            mArp.SetGate(value);
+            return true;
+
+        case kParam_RenderThreads:
+            // Read once per render call, so switching is safe at any time
+            mRenderThreads = (int)fmaxf(0.0f, fminf((float)VoiceRenderPool::kMaxWorkers, value));
+            return true;
+
+        case kParam_ControlBlockSize:
+            // Read once per render call
+            mControlBlockSize = (int)fmaxf(1.0f, fminf((float)kMaxVoiceBlockSize, value));
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+void SynthEngine::GetPreset(SynthPreset *preset) const {
+    preset->Clear();
+    for (uint32_t paramID = 0; paramID < (uint32_t)kNumParameterIDs; paramID++) {
+        if (!IsReadOnlyParameter(paramID)) {
+            preset->Set(paramID, mParameters.Get(paramID));
+        }
+    }
+}
+
+void SynthEngine::SetPreset(const SynthPreset& preset) {
+    mApplyingParameters = true;
+    mVoiceSettingsChanged = false;
+    for (uint32_t paramID = 0; paramID < (uint32_t)kNumParameterIDs; paramID++) {
+        if (preset.present[paramID]) {
+            mParameters.Publish(paramID, preset.values[paramID]);
+            ApplyParameter(paramID, preset.values[paramID]);
+        }
+    }
+    mApplyingParameters = false;
+    if (mVoiceSettingsChanged) {
+        UpdateAllVoices();
+    }
+    JumpSmoothedParameters();
+    if (preset.present[kParam_RenderThreads] && preset.values[kParam_RenderThreads] >= 1.0f) {
+        StartRenderWorkers();
+    }
+}
+
+void SynthEngine::LoadPreset(const SynthPreset& preset) {
+    for (uint32_t paramID = 0; paramID < (uint32_t)kNumParameterIDs; paramID++) {
+        if (preset.present[paramID]) {
+            mParameters.Publish(paramID, preset.values[paramID]);
+        }
+    }
+    mPresetMailbox.Post(preset);
+    if (preset.present[kParam_RenderThreads] && preset.values[kParam_RenderThreads] >= 1.0f) {
+        StartRenderWorkers();
+    }
+}
+
+double SynthEngine::GetTailTime() const {
+    int effectTail = EffectsChain::GetTailFrames((int)mParameters.Get(kParam_EffectType),
+                                                 mParameters.Get(kParam_EffectIntensity), mSampleRate);
+    return mParameters.Get(kParam_EnvRelease) + effectTail / mSampleRate;
+}
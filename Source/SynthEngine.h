@@ -0,0 +1,278 @@
+#ifndef __SynthEngine_h__
+#define __SynthEngine_h__
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include "SynthParameters.h"
+#include "VoiceBank.h"
+#include "ModulationMatrix.h"
+#include "MIDIEventQueue.h"
+#include "ScopeRingBuffer.h"
+#include "EffectsChain.h"
+#include "SynthPreset.h"
+#include "ParameterStore.h"
+#include "ParameterSmoother.h"
+#include "Arpeggiator.h"
+#include "LFO.h"
+#include "Saturator.h"
+
+struct OscillatorSettings {
+    int waveform;
+    int octave;
+    float detune;  // in cents
+    float volume;
+    int unison;    // Sub-oscillators, 1 to kMaxUnison
+    float unisonDetune;  // in cents either side
+    float unisonWidth;
+};
+
+class VoiceRenderPool;
+
+// The whole synth without any host API: voices, LFOs, filter envelope, mod matrix,
+// effects and arpeggiator. The Audio Unit wraps one of these, and so does the offline
+// renderer (claudesynth_render), so the DSP can be run and profiled on any platform.
+//
+// Threading is the Audio Unit's: parameters may be set from any thread, MIDI events
+// are queued from any thread, and Render runs on one (real-time) thread. Parameters and
+// events are handed over without locks and applied by Render, so everything else in
+// the engine belongs to the render thread.
+class SynthEngine {
+public:
+    // Render time per stage, accumulated while profiling (see SetStageTimings)
+    struct StageTimings {
+        double events;       // MIDI events and the arpeggiator (seconds)
+        double modulation;   // LFOs, filter envelope and mod matrix
+        double voices;       // Voice rendering
+        double effects;      // Effects, saturation and master volume
+        double voiceFrames;  // Sum over rendered frames of the active voice count
+        double subOscillatorFrames;  // Same for sub-oscillators (unison copies of audible oscillators)
+        uint64_t frames;
+    };
+
+    // The host's tempo and song position, for the arpeggiator and tempo-synced LFOs
+    struct Transport {
+        double tempo;         // Beats (quarter notes) per minute
+        double beatPosition;  // Beat at the first frame of the next Render
+        bool playing;         // False when stopped, or the host has no song position
+    };
+
+    SynthEngine();
+    ~SynthEngine();
+
+    // Default parameters, every voice idle and no pending events. Not thread-safe.
+    void Reset();
+
+    // Builds the shared wavetables, and starts the render workers if kParam_RenderThreads
+    // is already above 0. Allocates, so never call it from the render thread.
+    void Initialize();
+    void Uninitialize();
+
+    void SetSampleRate(double sampleRate) { mSampleRate = sampleRate; }
+    double GetSampleRate() const { return mSampleRate; }
+
+    // Releases every voice
+    void AllNotesOff();
+
+    // Any thread. The next Render applies every parameter set since the last one, in one
+    // batch before its first frame, limited to its range in kParameterDescriptors. False
+    // if the ID isn't a parameter that can be set. Levels, the filter and oscillator
+    // detune glide to the new value over a few milliseconds while notes sound, rather
+    // than jumping. Setting kParam_RenderThreads above 0 for the first time starts the
+    // render workers, so do that off the render thread.
+    bool SetParameter(uint32_t paramID, float value);
+
+    // Any thread: value from the given frame offset within the next Render (gliding like
+    // SetParameter). False if the ID isn't a parameter that can be set, or the queue was
+    // full and the change was dropped.
+    bool QueueParameterEvent(uint32_t paramID, float value, uint32_t offset);
+
+    // Same, as a ramp from startValue at offset to endValue rampFrames later (which may
+    // be in a later Render). Parameters that can't glide take endValue at offset.
+    bool QueueParameterRamp(uint32_t paramID, float startValue, float endValue,
+                            uint32_t offset, uint32_t rampFrames);
+
+    // Any thread: the value last set or loaded, or from the last queued change Render has
+    // reached (for read-only parameters, reported by the last Render). False if the ID
+    // isn't a parameter.
+    bool GetParameter(uint32_t paramID, float *value) const;
+
+    // Current value of every saved parameter. Any thread, like GetParameter.
+    void GetPreset(SynthPreset *preset) const;
+
+    // Sets every parameter the preset holds, now. Not thread-safe against Render: while
+    // rendering, use LoadPreset.
+    void SetPreset(const SynthPreset& preset);
+
+    // Hands preset to the next Render, which applies all of it before its first frame
+    // (GetParameter reports the new values at once). Copies it into a preallocated slot
+    // and never waits, so it is safe while rendering; one loading thread at a time.
+    void LoadPreset(const SynthPreset& preset);
+
+    // Queues a MIDI event for the next Render, at the given frame offset within it.
+    // Any thread; false if the queue was full and the event was dropped.
+    bool QueueMIDIEvent(uint8_t status, uint8_t data1, uint8_t data2, uint32_t offset);
+
+    // Renders frames into left and right (right may equal left for a mono mixdown).
+    // Also feeds the oscilloscope ring buffer (left channel). True when the buffer was
+    // silent without rendering anything: no voice sounding, no event or glide due and
+    // the effect's tail over, so the host can skip processing it.
+    bool Render(float *left, float *right, uint32_t frames);
+
+    // Any thread: seconds the output can go on after the last note is released (the amp
+    // envelope's release, then the effect's tail), for the host to render past the end
+    double GetTailTime() const;
+
+    // Where the host is for the next Render. Render thread, before each Render; without
+    // it the engine plays at 120 BPM with its own step timing.
+    void SetTransport(const Transport& transport) { mTransport = transport; }
+
+    // Output samples for the oscilloscope view (written by Render, read by the UI)
+    ScopeRingBuffer& GetScopeBuffer() { return mScopeBuffer; }
+
+    int GetActiveVoiceCount() const { return mVoices.GetActiveVoiceCount(); }
+
+    // Render worker threads running: none until kParam_RenderThreads is first set above 0
+    // after Initialize, then one per core but the host's, up to kMaxWorkers
+    int GetRenderWorkerCount() const;
+
+    // When render workers join in: host buffers of at least minFrames, with at least
+    // minVoicesPerThread active voices per thread. The defaults are VoiceRenderPool's;
+    // claudesynth_render --scaling --sweep-threads lifts them to find the crossover.
+    // Not thread-safe against Render.
+    void SetWorkerThresholds(int minFrames, int minVoicesPerThread) {
+        mMinFramesForWorkers = minFrames;
+        mMinVoicesPerThread = (minVoicesPerThread > 1) ? minVoicesPerThread : 1;
+    }
+
+    // Accumulate per-stage render time into timings (NULL to stop). Costs a clock read
+    // per stage and control block, so it is off unless something asks for it.
+    void SetStageTimings(StageTimings *timings) { mStageTimings = timings; }
+
+private:
+    // Parameters that glide to new values (ParameterSmoother channels)
+    enum {
+        kSmoothed_FilterCutoff,
+        kSmoothed_FilterResonance,
+        kSmoothed_Osc1Detune,
+        kSmoothed_Osc1Volume,
+        kSmoothed_Osc2Detune,
+        kSmoothed_Osc2Volume,
+        kSmoothed_Osc3Detune,
+        kSmoothed_Osc3Volume,
+        kSmoothed_MasterVolume,
+        kSmoothed_Saturation,
+        kNumSmoothedParameters
+    };
+
+    void StartRenderWorkers();
+    void UpdateAllVoices();
+    bool ApplyParameter(uint32_t paramID, float value);
+    void ApplyPendingParameters();
+    static int GetSmoothedParameter(uint32_t paramID);
+    void GlideParameter(uint32_t paramID, float value);
+    void JumpSmoothedParameters();
+    void HandleParameterEvent(const QueuedParameterEvent& event);
+    void HandleMIDIEvent(const QueuedMIDIEvent& event);
+
+    void AdvanceGlobalFilterEnvelope(int frames);
+    void RunArpeggiator();
+    void AdvanceModulation(int frames);
+    void AddSmoothingOffsets(ModulationValues& values) const;
+    void RenderSlice(float *left, float *right, uint32_t start, uint32_t end,
+                     const VoiceBank::ModulationBlock& modBlock, float masterVolumeStart,
+                     float saturationStart, int renderWorkers);
+    void RenderControlBlock(float *left, float *right, uint32_t start, uint32_t end, int renderWorkers);
+
+    VoiceBank mVoices;
+    double mSampleRate;
+    float mMasterVolume;
+    float mSaturation;
+    float mStereoSpread;
+    OscillatorSettings mOsc1;
+    OscillatorSettings mOsc2;
+    OscillatorSettings mOsc3;
+    float mFilterCutoff;
+    float mFilterResonance;
+    float mEnvAttack;
+    float mEnvDecay;
+    float mEnvSustain;
+    float mEnvRelease;
+
+    // Filter Envelope (Global)
+    float mFilterEnvAttack;
+    float mFilterEnvDecay;
+    float mFilterEnvSustain;
+    float mFilterEnvRelease;
+    float mFilterEnvLevel;
+    EnvelopeStage mFilterEnvStage;
+    float mFilterEnvReleaseStartLevel;
+    int mActiveNoteCount;  // Track how many notes are currently held
+
+    // LFOs
+    LFO mLFO1;
+    LFO mLFO2;
+    float mLFO1Output;  // Current LFO values for the indicators (0 to 1)
+    float mLFO2Output;
+
+    // Modulation Matrix (slots and compiled routes)
+    ModulationMatrix mModMatrix;
+
+    // Control-rate modulation
+    int mControlBlockSize;         // Frames between mod matrix evaluations
+    ModulationValues mModulation;  // Mod matrix output at the start of the next block
+
+    // Effects Section (chorus, phaser or flanger)
+    EffectsChain mEffects;
+
+    // Saturation (left, right), and whether it ran on the last slice
+    Saturator mSaturators[2];
+    bool mSaturating;
+
+    // Arpeggiator (held notes go to it instead of voices while it is on)
+    bool mArpEnable;
+    Arpeggiator mArp;
+
+    Transport mTransport;
+
+    ScopeRingBuffer mScopeBuffer;
+
+    // Multi-threaded voice rendering. The pool starts the first time workers are asked for
+    // while initialized, so instances that never use them never start threads, and stops
+    // in Uninitialize; the lock (never taken by Render) serializes starting and stopping.
+    int mRenderThreads;
+    std::atomic<VoiceRenderPool *> mRenderPool;
+    std::mutex mRenderPoolLock;
+    bool mInitialized;
+    int mMinFramesForWorkers;
+    int mMinVoicesPerThread;
+
+    // MIDI events waiting for the next Render, and Render's scratch copy sorted by frame
+    MIDIEventQueue mMIDIQueue;
+    QueuedMIDIEvent mRenderEvents[MIDIEventQueue::kCapacity];
+    uint32_t mLoggedMIDIOverflows;
+
+    // Parameter values as set, and presets from LoadPreset, waiting for Render
+    ParameterStore mParameters;
+    PresetMailbox mPresetMailbox;
+
+    // Parameter changes at frame offsets waiting for the next Render, and Render's sorted copy
+    ParameterEventQueue mParameterQueue;
+    QueuedParameterEvent mRenderParameterEvents[ParameterEventQueue::kCapacity];
+    uint32_t mLoggedParameterOverflows;
+
+    // What is being heard of the parameters that glide
+    ParameterSmoother<kNumSmoothedParameters> mSmoothing;
+
+    // Set while Render applies a batch of parameters: the voice settings are then rebuilt
+    // once at the end rather than per parameter
+    bool mApplyingParameters;
+    bool mVoiceSettingsChanged;
+
+    StageTimings *mStageTimings;
+
+    // Right channel of a slice when the output is mono
+    float mMonoRight[kMaxVoiceBlockSize];
+};
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef __SynthParameters_h__
+#define __SynthParameters_h__
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Parameters of the synth engine, shared by the Audio Unit, its view and the offline
+// renderer. Hosts save these IDs with their sessions, so never renumber them.
+
+// Default frames per control block (modulation is evaluated once per block and ramped
+// across it; see kParam_ControlBlockSize)
+static const int kControlBlockSize = 16;
+
+// Parameter IDs
+enum {
+    kParam_MasterVolume = 0,
+
+    kParam_Osc1_Waveform = 1,
+    kParam_Osc1_Octave = 2,
+    kParam_Osc1_Detune = 3,
+    kParam_Osc1_Volume = 4,
+
+    kParam_Osc2_Waveform = 5,
+    kParam_Osc2_Octave = 6,
+    kParam_Osc2_Detune = 7,
+    kParam_Osc2_Volume = 8,
+
+    kParam_Osc3_Waveform = 9,
+    kParam_Osc3_Octave = 10,
+    kParam_Osc3_Detune = 11,
+    kParam_Osc3_Volume = 12,
+
+    kParam_FilterCutoff = 13,
+    kParam_FilterResonance = 14,
+
+    kParam_EnvAttack = 15,
+    kParam_EnvDecay = 16,
+    kParam_EnvSustain = 17,
+    kParam_EnvRelease = 18,
+
+    // Filter Envelope
+    kParam_FilterEnvAttack = 19,
+    kParam_FilterEnvDecay = 20,
+    kParam_FilterEnvSustain = 21,
+    kParam_FilterEnvRelease = 22,
+
+    // LFO 1
+    kParam_LFO1_Waveform = 23,
+    kParam_LFO1_Rate = 24,
+    kParam_LFO1_TempoSync = 47,      // 0=Off, 1=On
+    kParam_LFO1_NoteDivision = 48,   // 0-14, kLFONoteDivisions (when tempo synced)
+
+    // LFO 2
+    kParam_LFO2_Waveform = 25,
+    kParam_LFO2_Rate = 26,
+    kParam_LFO2_TempoSync = 49,      // 0=Off, 1=On
+    kParam_LFO2_NoteDivision = 50,   // 0-14, kLFONoteDivisions (when tempo synced)
+
+    // Modulation Matrix (4 slots x 3 params each)
+    kParam_ModSlot1_Source = 27,
+    kParam_ModSlot1_Dest = 28,
+    kParam_ModSlot1_Intensity = 29,
+
+    kParam_ModSlot2_Source = 30,
+    kParam_ModSlot2_Dest = 31,
+    kParam_ModSlot2_Intensity = 32,
+
+    kParam_ModSlot3_Source = 33,
+    kParam_ModSlot3_Dest = 34,
+    kParam_ModSlot3_Intensity = 35,
+
+    kParam_ModSlot4_Source = 36,
+    kParam_ModSlot4_Dest = 37,
+    kParam_ModSlot4_Intensity = 38,
+
+    // Effects parameters
+    kParam_EffectType = 39,      // 0=None, 1=Chorus, 2=Phaser, 3=Flanger
+    kParam_EffectRate = 40,      // 0.1 to 10 Hz
+    kParam_EffectIntensity = 41, // 0.0 to 1.0
+
+    // Arpeggiator parameters
+    kParam_ArpEnable = 42,       // 0=Off, 1=On
+    kParam_ArpRate = 43,         // 0=1/4, 1=1/8, 2=1/16, 3=1/32
+    kParam_ArpMode = 44,         // 0=Up, 1=Down, 2=UpDown, 3=Random
+    kParam_ArpOctaves = 45,      // 1-4 octaves
+    kParam_ArpGate = 46,         // 0.0 to 1.0 (gate length)
+
+    // LFO Output (read-only for UI indicators)
+    kParam_LFO1_Output = 51,     // 0.0 to 1.0 (current LFO value for LED)
+    kParam_LFO2_Output = 52,     // 0.0 to 1.0 (current LFO value for LED)
+
+    // Saturation
+    kParam_Saturation = 53,      // 0.0 to 1.0 (saturation amount)
+
+    // Voice rendering
+    kParam_RenderThreads = 54,   // 0-3 worker threads (0 = render on the audio thread only)
+
+    // MIDI diagnostics (read-only)
+    kParam_MIDIQueueOverflows = 55, // MIDI events dropped because the event queue was full
+
+    // Modulation rate
+    kParam_ControlBlockSize = 56,   // 1 to 64 frames between modulation updates
+
+    // Modulation matrix slots 5-16 (Source, Dest, Intensity for slot s at
+    // kParam_ModSlot5_Source + (s - 5) * 3; see ModSlotParameterID)
+    kParam_ModSlot5_Source = 57,
+    kParam_ModSlot16_Intensity = 92,
+
+    // Stereo
+    kParam_StereoSpread = 93,       // 0.0 (mono) to 1.0 (voices panned by note)
+
+    // Unison (per oscillator)
+    kParam_Osc1_Unison = 94,        // 1-8 sub-oscillators
+    kParam_Osc1_UnisonDetune = 95,  // 0 to 100 cents either side
+    kParam_Osc1_UnisonWidth = 96,   // 0.0 (centred) to 1.0 (spread hard left to right)
+    kParam_Osc2_Unison = 97,
+    kParam_Osc2_UnisonDetune = 98,
+    kParam_Osc2_UnisonWidth = 99,
+    kParam_Osc3_Unison = 100,
+    kParam_Osc3_UnisonDetune = 101,
+    kParam_Osc3_UnisonWidth = 102,
+
+    // Voice allocation
+    kParam_VoiceStealPolicy = 103,  // 0=Oldest, 1=Quietest, 2=Same Note, 3=Released First
+    kParam_Polyphony = 104,         // 1-128 voices
+
+    // Saturation quality
+    kParam_SaturationOversampling = 105,  // 0=Off, 1=2x, 2=4x
+
+    // Filter response
+    kParam_FilterMode = 106  // 0=Low-pass, 1=Band-pass, 2=High-pass
+};
+
+// One more than the highest parameter ID (IDs below it are all in use)
+static const int kNumParameterIDs = kParam_FilterMode + 1;
+
+// Parameter ID of a mod matrix slot field (slot 0-15; field 0=Source, 1=Dest, 2=Intensity).
+// Slots 1-4 keep their original IDs; slots 5-16 follow the other parameters.
+static constexpr uint32_t ModSlotParameterID(int slot, int field) {
+    return (slot < 4) ? kParam_ModSlot1_Source + slot * 3 + field :
+                        kParam_ModSlot5_Source + (slot - 4) * 3 + field;
+}
+
+// Inverse of ModSlotParameterID; false if the ID isn't a mod matrix slot parameter
+static inline bool DecodeModSlotParameterID(uint32_t paramID, int *slot, int *field) {
+    int index;
+    if (paramID >= kParam_ModSlot1_Source && paramID <= kParam_ModSlot4_Intensity) {
+        index = paramID - kParam_ModSlot1_Source;
+    } else if (paramID >= kParam_ModSlot5_Source && paramID <= kParam_ModSlot16_Intensity) {
+        index = 12 + (paramID - kParam_ModSlot5_Source);
+    } else {
+        return false;
+    }
+    *slot = index / 3;
+    *field = index % 3;
+    return true;
+}
+
+// How a parameter's value is shown (the Audio Unit maps these to its own units)
+enum ParameterUnit {
+    kParameterUnit_Generic,
+    kParameterUnit_Indexed,       // Whole numbers choosing from a list
+    kParameterUnit_Boolean,
+    kParameterUnit_Percent,
+    kParameterUnit_Seconds,
+    kParameterUnit_SampleFrames,
+    kParameterUnit_Hertz,
+    kParameterUnit_Cents,
+    kParameterUnit_LinearGain
+};
+
+// Everything about one parameter but its effect: what hosts are told about it, the range
+// values are clamped to, and the value a fresh engine starts with
+struct ParameterDescriptor {
+    uint32_t id;
+    const char *name;
+    ParameterUnit unit;
+    float minValue;
+    float maxValue;
+    float defaultValue;
+    bool readOnly;  // Reported by the engine, never taken (and not saved with the state)
+};
+
+#define MOD_SLOT_PARAMETERS(slot) \
+    { ModSlotParameterID(slot - 1, 0), "Mod " #slot " Source", kParameterUnit_Indexed, 0.0f, 8.0f, 0.0f, false }, \
+    { ModSlotParameterID(slot - 1, 1), "Mod " #slot " Destination", kParameterUnit_Indexed, 0.0f, 9.0f, 0.0f, false }, \
+    { ModSlotParameterID(slot - 1, 2), "Mod " #slot " Intensity", kParameterUnit_Generic, 0.0f, 1.0f, 0.0f, false }
+
+// Indexed by parameter ID
+static constexpr ParameterDescriptor kParameterDescriptors[] = {
+    { kParam_MasterVolume, "Master Volume", kParameterUnit_LinearGain, 0.0f, 1.0f, 1.0f, false },
+    { kParam_Osc1_Waveform, "Osc 1 Waveform", kParameterUnit_Indexed, 0.0f, 3.0f, 0.0f, false },
+    { kParam_Osc1_Octave, "Osc 1 Octave", kParameterUnit_Generic, -2.0f, 2.0f, 0.0f, false },
+    { kParam_Osc1_Detune, "Osc 1 Detune", kParameterUnit_Cents, -100.0f, 100.0f, 0.0f, false },
+    { kParam_Osc1_Volume, "Osc 1 Volume", kParameterUnit_LinearGain, 0.0f, 1.0f, 1.0f, false },
+    { kParam_Osc2_Waveform, "Osc 2 Waveform", kParameterUnit_Indexed, 0.0f, 3.0f, 0.0f, false },
+    { kParam_Osc2_Octave, "Osc 2 Octave", kParameterUnit_Generic, -2.0f, 2.0f, 0.0f, false },
+    { kParam_Osc2_Detune, "Osc 2 Detune", kParameterUnit_Cents, -100.0f, 100.0f, 0.0f, false },
+    { kParam_Osc2_Volume, "Osc 2 Volume", kParameterUnit_LinearGain, 0.0f, 1.0f, 0.0f, false },
+    { kParam_Osc3_Waveform, "Osc 3 Waveform", kParameterUnit_Indexed, 0.0f, 3.0f, 0.0f, false },
+    { kParam_Osc3_Octave, "Osc 3 Octave", kParameterUnit_Generic, -2.0f, 2.0f, 0.0f, false },
+    { kParam_Osc3_Detune, "Osc 3 Detune", kParameterUnit_Cents, -100.0f, 100.0f, 0.0f, false },
+    { kParam_Osc3_Volume, "Osc 3 Volume", kParameterUnit_LinearGain, 0.0f, 1.0f, 0.0f, false },
+    { kParam_FilterCutoff, "Filter Cutoff", kParameterUnit_Hertz, 20.0f, 20000.0f, 20000.0f, false },
+    { kParam_FilterResonance, "Filter Resonance", kParameterUnit_Generic, 0.5f, 10.0f, 0.7f, false },
+    { kParam_EnvAttack, "Env Attack", kParameterUnit_Seconds, 0.001f, 3.0f, 0.01f, false },
+    { kParam_EnvDecay, "Env Decay", kParameterUnit_Seconds, 0.001f, 3.0f, 0.3f, false },
+    { kParam_EnvSustain, "Env Sustain", kParameterUnit_LinearGain, 0.0f, 1.0f, 0.7f, false },
+    { kParam_EnvRelease, "Env Release", kParameterUnit_Seconds, 0.001f, 3.0f, 0.3f, false },
+    { kParam_FilterEnvAttack, "Filter Env Attack", kParameterUnit_Seconds, 0.001f, 3.0f, 0.01f, false },
+    { kParam_FilterEnvDecay, "Filter Env Decay", kParameterUnit_Seconds, 0.001f, 3.0f, 0.3f, false },
+    { kParam_FilterEnvSustain, "Filter Env Sustain", kParameterUnit_LinearGain, 0.0f, 1.0f, 1.0f, false },
+    { kParam_FilterEnvRelease, "Filter Env Release", kParameterUnit_Seconds, 0.001f, 3.0f, 0.3f, false },
+    { kParam_LFO1_Waveform, "LFO 1 Waveform", kParameterUnit_Indexed, 0.0f, 3.0f, 0.0f, false },
+    { kParam_LFO1_Rate, "LFO 1 Rate", kParameterUnit_Hertz, 0.1f, 10.0f, 5.0f, false },
+    { kParam_LFO2_Waveform, "LFO 2 Waveform", kParameterUnit_Indexed, 0.0f, 3.0f, 0.0f, false },
+    { kParam_LFO2_Rate, "LFO 2 Rate", kParameterUnit_Hertz, 0.1f, 10.0f, 3.0f, false },
+    MOD_SLOT_PARAMETERS(1),
+    MOD_SLOT_PARAMETERS(2),
+    MOD_SLOT_PARAMETERS(3),
+    MOD_SLOT_PARAMETERS(4),
+    { kParam_EffectType, "Effect Type", kParameterUnit_Indexed, 0.0f, 3.0f, 0.0f, false },
+    { kParam_EffectRate, "Effect Rate", kParameterUnit_Hertz, 0.1f, 10.0f, 1.0f, false },
+    { kParam_EffectIntensity, "Effect Intensity", kParameterUnit_Generic, 0.0f, 1.0f, 0.5f, false },
+    { kParam_ArpEnable, "Arpeggiator Enable", kParameterUnit_Boolean, 0.0f, 1.0f, 0.0f, false },
+    { kParam_ArpRate, "Arpeggiator Rate", kParameterUnit_Indexed, 0.0f, 3.0f, 1.0f, false },
+    { kParam_ArpMode, "Arpeggiator Mode", kParameterUnit_Indexed, 0.0f, 3.0f, 0.0f, false },
+    { kParam_ArpOctaves, "Arpeggiator Octaves", kParameterUnit_Generic, 1.0f, 4.0f, 1.0f, false },
+    { kParam_ArpGate, "Arpeggiator Gate", kParameterUnit_Percent, 0.1f, 1.0f, 0.9f, false },
+    { kParam_LFO1_TempoSync, "LFO 1 Tempo Sync", kParameterUnit_Boolean, 0.0f, 1.0f, 0.0f, false },
+    { kParam_LFO1_NoteDivision, "LFO 1 Note Division", kParameterUnit_Indexed, 0.0f, 14.0f, 2.0f, false },
+    { kParam_LFO2_TempoSync, "LFO 2 Tempo Sync", kParameterUnit_Boolean, 0.0f, 1.0f, 0.0f, false },
+    { kParam_LFO2_NoteDivision, "LFO 2 Note Division", kParameterUnit_Indexed, 0.0f, 14.0f, 2.0f, false },
+    { kParam_LFO1_Output, "LFO 1 Output", kParameterUnit_Generic, 0.0f, 1.0f, 0.0f, true },
+    { kParam_LFO2_Output, "LFO 2 Output", kParameterUnit_Generic, 0.0f, 1.0f, 0.0f, true },
+    { kParam_Saturation, "Saturation", kParameterUnit_Generic, 0.0f, 1.0f, 0.0f, false },
+    { kParam_RenderThreads, "Render Threads", kParameterUnit_Indexed, 0.0f, 3.0f, 0.0f, false },
+    { kParam_MIDIQueueOverflows, "MIDI Queue Overflows", kParameterUnit_Generic, 0.0f, 4294967295.0f, 0.0f, true },
+    { kParam_ControlBlockSize, "Control Block Size", kParameterUnit_SampleFrames, 1.0f, 64.0f, (float)kControlBlockSize, false },
+    MOD_SLOT_PARAMETERS(5),
+    MOD_SLOT_PARAMETERS(6),
+    MOD_SLOT_PARAMETERS(7),
+    MOD_SLOT_PARAMETERS(8),
+    MOD_SLOT_PARAMETERS(9),
+    MOD_SLOT_PARAMETERS(10),
+    MOD_SLOT_PARAMETERS(11),
+    MOD_SLOT_PARAMETERS(12),
+    MOD_SLOT_PARAMETERS(13),
+    MOD_SLOT_PARAMETERS(14),
+    MOD_SLOT_PARAMETERS(15),
+    MOD_SLOT_PARAMETERS(16),
+    { kParam_StereoSpread, "Stereo Spread", kParameterUnit_Generic, 0.0f, 1.0f, 0.0f, false },
+    { kParam_Osc1_Unison, "Osc 1 Unison", kParameterUnit_Generic, 1.0f, 8.0f, 1.0f, false },
+    { kParam_Osc1_UnisonDetune, "Osc 1 Unison Detune", kParameterUnit_Cents, 0.0f, 100.0f, 0.0f, false },
+    { kParam_Osc1_UnisonWidth, "Osc 1 Unison Width", kParameterUnit_Generic, 0.0f, 1.0f, 0.0f, false },
+    { kParam_Osc2_Unison, "Osc 2 Unison", kParameterUnit_Generic, 1.0f, 8.0f, 1.0f, false },
+    { kParam_Osc2_UnisonDetune, "Osc 2 Unison Detune", kParameterUnit_Cents, 0.0f, 100.0f, 0.0f, false },
+    { kParam_Osc2_UnisonWidth, "Osc 2 Unison Width", kParameterUnit_Generic, 0.0f, 1.0f, 0.0f, false },
+    { kParam_Osc3_Unison, "Osc 3 Unison", kParameterUnit_Generic, 1.0f, 8.0f, 1.0f, false },
+    { kParam_Osc3_UnisonDetune, "Osc 3 Unison Detune", kParameterUnit_Cents, 0.0f, 100.0f, 0.0f, false },
+    { kParam_Osc3_UnisonWidth, "Osc 3 Unison Width", kParameterUnit_Generic, 0.0f, 1.0f, 0.0f, false },
+    { kParam_VoiceStealPolicy, "Voice Steal Policy", kParameterUnit_Indexed, 0.0f, 3.0f, 2.0f, false },
+    { kParam_Polyphony, "Polyphony", kParameterUnit_Generic, 1.0f, 128.0f, 64.0f, false },
+    { kParam_SaturationOversampling, "Saturation Oversampling", kParameterUnit_Indexed, 0.0f, 2.0f, 1.0f, false },
+    { kParam_FilterMode, "Filter Mode", kParameterUnit_Indexed, 0.0f, 2.0f, 0.0f, false },
+};
+
+#undef MOD_SLOT_PARAMETERS
+
+// Every ID from 0 to kNumParameterIDs - 1 has exactly one descriptor, at its own index,
+// with its default in range
+static constexpr bool ParameterDescriptorsAreComplete(uint32_t paramID) {
+    return paramID == (uint32_t)kNumParameterIDs ||
+           (kParameterDescriptors[paramID].id == paramID &&
+            kParameterDescriptors[paramID].minValue <= kParameterDescriptors[paramID].defaultValue &&
+            kParameterDescriptors[paramID].defaultValue <= kParameterDescriptors[paramID].maxValue &&
+            ParameterDescriptorsAreComplete(paramID + 1));
+}
+static_assert(sizeof(kParameterDescriptors) / sizeof(kParameterDescriptors[0]) == (size_t)kNumParameterIDs,
+              "kParameterDescriptors needs one entry per parameter ID");
+static_assert(ParameterDescriptorsAreComplete(0),
+              "kParameterDescriptors must be in parameter ID order, with defaults in range");
+
+// NULL if the ID isn't a parameter
+static inline const ParameterDescriptor *GetParameterDescriptor(uint32_t paramID) {
+    return (paramID < (uint32_t)kNumParameterIDs) ? &kParameterDescriptors[paramID] : NULL;
+}
+
+// Parameters the engine reports but never takes: these aren't saved with the state
+static inline bool IsReadOnlyParameter(uint32_t paramID) {
+    return paramID < (uint32_t)kNumParameterIDs && kParameterDescriptors[paramID].readOnly;
+}
+
+// value limited to the parameter's range (a NaN becomes the maximum). paramID must be a
+// parameter.
+static inline float ClampParameter(uint32_t paramID, float value) {
+    const ParameterDescriptor& descriptor = kParameterDescriptors[paramID];
+    return fmaxf(descriptor.minValue, fminf(descriptor.maxValue, value));
+}
+
+#endif
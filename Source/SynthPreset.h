@@ -0,0 +1,227 @@
+#ifndef __SynthPreset_h__
+#define __SynthPreset_h__
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "SynthParameters.h"
+
+// A value for every saved parameter: what a host stores with a session and what a
+// preset file holds. Parameters a preset doesn't have (a state saved before they
+// existed) keep their current values when it is applied.
+//
+// Two formats, both keyed by parameter ID so old states load into newer builds:
+//   Binary: "CSyP", uint16 version, uint16 count, then count x (uint16 ID, float32),
+//           all little-endian. 6 bytes per parameter.
+//   Text:   "<parameter id> <value>" per line, '#' starts a comment (the same format
+//           as the renderer's parameter files). Values are written exactly, with the
+//           parameter's name as a comment.
+//
+// Plain C++ with no Apple dependencies.
+struct SynthPreset {
+    static const uint16_t kVersion = 1;
+    static const size_t kHeaderSize = 8;
+    static const size_t kEntrySize = 6;
+
+    float values[kNumParameterIDs];
+    bool present[kNumParameterIDs];
+
+    SynthPreset() {
+        Clear();
+    }
+
+    void Clear() {
+        memset(values, 0, sizeof(values));
+        memset(present, 0, sizeof(present));
+    }
+
+    // False for IDs that aren't saved (unknown or read-only). Values are limited to the
+    // parameter's range, so a damaged or hand-edited preset can't take one outside it.
+    bool Set(uint32_t paramID, float value) {
+        if (paramID >= (uint32_t)kNumParameterIDs || IsReadOnlyParameter(paramID)) {
+            return false;
+        }
+        values[paramID] = ClampParameter(paramID, value);
+        present[paramID] = true;
+        return true;
+    }
+
+    bool Get(uint32_t paramID, float *value) const {
+        if (paramID >= (uint32_t)kNumParameterIDs || !present[paramID]) {
+            return false;
+        }
+        *value = values[paramID];
+        return true;
+    }
+
+    int GetCount() const {
+        int count = 0;
+        for (int id = 0; id < kNumParameterIDs; id++) {
+            if (present[id]) count++;
+        }
+        return count;
+    }
+
+    bool operator==(const SynthPreset& other) const {
+        for (int id = 0; id < kNumParameterIDs; id++) {
+            if (present[id] != other.present[id]) return false;
+            // Compared as bits, so a value must come back exactly as it was saved (even -0)
+            if (present[id] && memcmp(&values[id], &other.values[id], sizeof(float)) != 0) return false;
+        }
+        return true;
+    }
+    bool operator!=(const SynthPreset& other) const { return !(*this == other); }
+
+    void WriteBinary(std::vector<uint8_t>& data) const {
+        int count = GetCount();
+        data.resize(kHeaderSize + kEntrySize * count);
+        uint8_t *out = &data[0];
+        memcpy(out, "CSyP", 4);
+        Store16(out + 4, kVersion);
+        Store16(out + 6, (uint16_t)count);
+        out += kHeaderSize;
+        for (int id = 0; id < kNumParameterIDs; id++) {
+            if (!present[id]) continue;
+            uint32_t bits;
+            memcpy(&bits, &values[id], sizeof(bits));
+            Store16(out, (uint16_t)id);
+            Store32(out + 2, bits);
+            out += kEntrySize;
+        }
+    }
+
+    // False (and the preset left empty) if data isn't a preset this build can read.
+    // IDs this build doesn't know are skipped.
+    bool ReadBinary(const uint8_t *data, size_t size) {
+        Clear();
+        if (size < kHeaderSize || memcmp(data, "CSyP", 4) != 0) {
+            return false;
+        }
+        uint16_t version = Load16(data + 4);
+        size_t count = Load16(data + 6);
+        if (version == 0 || version > kVersion || size < kHeaderSize + kEntrySize * count) {
+            return false;
+        }
+        const uint8_t *in = data + kHeaderSize;
+        for (size_t i = 0; i < count; i++, in += kEntrySize) {
+            uint32_t bits = Load32(in + 2);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            Set(Load16(in), value);
+        }
+        return true;
+    }
+
+    void WriteText(std::string& text) const {
+        char line[96];
+        snprintf(line, sizeof(line), "# ClaudeSynth preset, format %d: \"<parameter id> <value>\" per line\n",
+                 (int)kVersion);
+        text = line;
+        for (int id = 0; id < kNumParameterIDs; id++) {
+            if (!present[id]) continue;
+            // Nine significant digits are enough for any float to read back identically
+            snprintf(line, sizeof(line), "%d %.9g  # %s\n", id, values[id], kParameterDescriptors[id].name);
+            text += line;
+        }
+    }
+
+    // False (and the preset left empty) on a line that isn't a parameter assignment,
+    // including a negative ID. Unknown IDs are skipped.
+    bool ReadText(const char *text, size_t length) {
+        Clear();
+        size_t pos = 0;
+        while (pos < length) {
+            size_t end = pos;
+            while (end < length && text[end] != '\n') end++;
+            std::string line(text + pos, end - pos);
+            pos = end + 1;
+
+            size_t comment = line.find('#');
+            if (comment != std::string::npos) line.erase(comment);
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+            // Read as signed: %u would take "-1" as a huge (unknown, so skipped) ID
+            int id;
+            float value;
+            char extra;
+            if ((sscanf(line.c_str(), " %d = %f %c", &id, &value, &extra) != 2 &&
+                 sscanf(line.c_str(), " %d %f %c", &id, &value, &extra) != 2) || id < 0) {
+                Clear();
+                return false;
+            }
+            Set((uint32_t)id, value);
+        }
+        return true;
+    }
+
+private:
+    static void Store16(uint8_t *out, uint16_t value) {
+        out[0] = (uint8_t)value;
+        out[1] = (uint8_t)(value >> 8);
+    }
+
+    static void Store32(uint8_t *out, uint32_t value) {
+        Store16(out, (uint16_t)value);
+        Store16(out + 2, (uint16_t)(value >> 16));
+    }
+
+    static uint16_t Load16(const uint8_t *in) {
+        return (uint16_t)(in[0] | (in[1] << 8));
+    }
+
+    static uint32_t Load32(const uint8_t *in) {
+        return Load16(in) | ((uint32_t)Load16(in + 2) << 16);
+    }
+};
+
+// Hands whole presets from a loading thread to the render thread. A triple buffer: the
+// loader fills its own preset and exchanges it into the middle slot; the render thread
+// exchanges the middle slot for its own when there's a new one. Each side swaps an
+// index with one atomic exchange, so neither waits, allocates or sees half a preset.
+// Loading twice before a render just replaces the first preset.
+//
+// One loading thread at a time; only the render thread takes.
+class PresetMailbox {
+public:
+    PresetMailbox() {
+        Reset();
+    }
+
+    // Nothing waiting. Not thread-safe (SynthEngine::Reset calls it).
+    void Reset() {
+        mLoading = 0;
+        mMiddle.store(1, std::memory_order_relaxed);
+        mTaken = 2;
+    }
+
+    // Loading thread
+    void Post(const SynthPreset& preset) {
+        mSlots[mLoading] = preset;
+        int previous = mMiddle.exchange(mLoading | kNewFlag, std::memory_order_acq_rel);
+        mLoading = previous & ~kNewFlag;
+    }
+
+    // Render thread: the preset posted since the last call, or NULL
+    const SynthPreset *Take() {
+        if (!(mMiddle.load(std::memory_order_relaxed) & kNewFlag)) {
+            return NULL;
+        }
+        int middle = mMiddle.exchange(mTaken, std::memory_order_acq_rel);
+        mTaken = middle & ~kNewFlag;
+        return &mSlots[mTaken];
+    }
+
+private:
+    static const int kNewFlag = 4;
+
+    SynthPreset mSlots[3];
+    int mLoading;               // Slot the loader fills next (loading thread only)
+    std::atomic<int> mMiddle;   // Slot between the two, | kNewFlag when not yet taken
+    int mTaken;                 // Slot the render thread last took (render thread only)
+};
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef __VoiceAllocator_h__
+#define __VoiceAllocator_h__
+
+#include <stdint.h>
+
+// Most voices the synth can play at once (the polyphony setting picks how many it does)
+static const int kMaxVoices = 128;
+
+// Which voice a note takes when every voice is busy
+enum VoiceStealPolicy {
+    kVoiceSteal_Oldest = 0,         // The voice started longest ago
+    kVoiceSteal_Quietest = 1,       // The voice with the lowest level
+    kVoiceSteal_SameNote = 2,       // A repeated note reuses its own voice; otherwise released first
+    kVoiceSteal_ReleasedFirst = 3,  // The oldest released voice, or the oldest if all are held
+    kNumVoiceStealPolicies
+};
+
+// Assigns voices to notes. Free voices are a stack and each note maps straight to its
+// voice, so starting and releasing a note cost the same however many voices are busy;
+// only stealing looks at every voice. Knows nothing about rendering: the owner reports
+// voices that went silent (VoiceFinished) and passes voice levels in when stealing.
+class VoiceAllocator {
+public:
+    static const int kNumNotes = 128;
+
+    VoiceAllocator() {
+        Reset(kMaxVoices);
+    }
+
+    // Every voice free, voices [0, numVoices) in use
+    void Reset(int numVoices) {
+        mNumVoices = (numVoices < 1) ? 1 : (numVoices > kMaxVoices ? kMaxVoices : numVoices);
+        mPolicy = kVoiceSteal_SameNote;
+        mClock = 0;
+        for (int note = 0; note < kNumNotes; note++) {
+            mVoiceForNote[note] = -1;
+        }
+        for (int voice = 0; voice < kMaxVoices; voice++) {
+            mNote[voice] = -1;
+            mHeld[voice] = false;
+            mStartTime[voice] = 0;
+        }
+        // Stacked so voice 0 comes off first
+        mFreeCount = 0;
+        for (int voice = mNumVoices - 1; voice >= 0; voice--) {
+            mFree[mFreeCount++] = voice;
+        }
+    }
+
+    void SetPolicy(int policy) {
+        mPolicy = (policy >= 0 && policy < kNumVoiceStealPolicies) ? (VoiceStealPolicy)policy : kVoiceSteal_SameNote;
+    }
+    VoiceStealPolicy GetPolicy() const { return mPolicy; }
+
+    // Changes how many voices may be used without disturbing the ones playing. Voices
+    // beyond a lowered limit play on until they finish but aren't used again.
+    void SetNumVoices(int numVoices) {
+        numVoices = (numVoices < 1) ? 1 : (numVoices > kMaxVoices ? kMaxVoices : numVoices);
+        if (numVoices > mNumVoices) {
+            for (int voice = numVoices - 1; voice >= mNumVoices; voice--) {
+                if (mNote[voice] < 0) {
+                    mFree[mFreeCount++] = voice;
+                }
+            }
+        } else {
+            int count = 0;
+            for (int i = 0; i < mFreeCount; i++) {
+                if (mFree[i] < numVoices) {
+                    mFree[count++] = mFree[i];
+                }
+            }
+            mFreeCount = count;
+        }
+        mNumVoices = numVoices;
+    }
+
+    // Voice for a new note: the voice already on the note when it should be retriggered,
+    // otherwise a free voice. -1 when every voice is busy (see Steal).
+    int Allocate(int note) {
+        int current = mVoiceForNote[note];
+        if (current >= 0 && (mHeld[current] || mPolicy == kVoiceSteal_SameNote)) {
+            // A held note played again, or any repeat under SameNote: retrigger its voice
+            Start(current, note);
+            return current;
+        }
+        if (mFreeCount == 0) {
+            return -1;
+        }
+        int voice = mFree[--mFreeCount];
+        Start(voice, note);
+        return voice;
+    }
+
+    // Takes a busy voice for note by the steal policy. levels[voice] is how loud each
+    // voice is now (for kVoiceSteal_Quietest; may be NULL otherwise).
+    int Steal(int note, const float *levels) {
+        int voice = -1;
+        switch (mPolicy) {
+            case kVoiceSteal_Quietest:
+                voice = levels ? FindQuietest(levels) : FindOldest(false);
+                break;
+            case kVoiceSteal_Oldest:
+                voice = FindOldest(false);
+                break;
+            case kVoiceSteal_SameNote:
+            case kVoiceSteal_ReleasedFirst:
+            default:
+                voice = FindOldest(true);
+                if (voice < 0) voice = FindOldest(false);
+                break;
+        }
+        if (voice < 0) {
+            return -1;
+        }
+        if (mVoiceForNote[mNote[voice]] == voice) {
+            mVoiceForNote[mNote[voice]] = -1;
+        }
+        Start(voice, note);
+        return voice;
+    }
+
+    // Voice holding note (now released), or -1 if the note isn't held
+    int Release(int note) {
+        int voice = mVoiceForNote[note];
+        if (voice < 0 || !mHeld[voice]) {
+            return -1;
+        }
+        mHeld[voice] = false;
+        return voice;
+    }
+
+    void ReleaseAll() {
+        for (int voice = 0; voice < kMaxVoices; voice++) {
+            mHeld[voice] = false;
+        }
+    }
+
+    // The voice went silent: it's free again
+    void VoiceFinished(int voice) {
+        if (mNote[voice] < 0) {
+            return;
+        }
+        if (mVoiceForNote[mNote[voice]] == voice) {
+            mVoiceForNote[mNote[voice]] = -1;
+        }
+        mNote[voice] = -1;
+        mHeld[voice] = false;
+        if (voice < mNumVoices) {
+            mFree[mFreeCount++] = voice;
+        }
+    }
+
+    int GetVoiceForNote(int note) const { return mVoiceForNote[note]; }
+    int GetNote(int voice) const { return mNote[voice]; }
+    bool IsHeld(int voice) const { return mHeld[voice]; }
+    int GetFreeCount() const { return mFreeCount; }
+    int GetNumVoices() const { return mNumVoices; }
+
+private:
+    void Start(int voice, int note) {
+        mNote[voice] = note;
+        mHeld[voice] = true;
+        mStartTime[voice] = ++mClock;
+        mVoiceForNote[note] = voice;
+    }
+
+    // Oldest busy voice (only released ones if releasedOnly), or -1
+    int FindOldest(bool releasedOnly) const {
+        int oldest = -1;
+        for (int voice = 0; voice < mNumVoices; voice++) {
+            if (mNote[voice] < 0 || (releasedOnly && mHeld[voice])) continue;
+            // Start times are compared as differences so the counter may wrap
+            if (oldest < 0 || (int32_t)(mStartTime[voice] - mStartTime[oldest]) < 0) {
+                oldest = voice;
+            }
+        }
+        return oldest;
+    }
+
+    // Quietest busy voice, the older one on a tie
+    int FindQuietest(const float *levels) const {
+        int quietest = -1;
+        for (int voice = 0; voice < mNumVoices; voice++) {
+            if (mNote[voice] < 0) continue;
+            if (quietest < 0 || levels[voice] < levels[quietest] ||
+                (levels[voice] == levels[quietest] &&
+                 (int32_t)(mStartTime[voice] - mStartTime[quietest]) < 0)) {
+                quietest = voice;
+            }
+        }
+        return quietest;
+    }
+
+    int mNumVoices;
+    VoiceStealPolicy mPolicy;
+    uint32_t mClock;                   // Counts note starts; a voice's age is mClock - mStartTime
+
+    int mVoiceForNote[kNumNotes];      // Voice most recently started on each note, or -1
+    int mNote[kMaxVoices];             // Note each voice is assigned, -1 when free
+    bool mHeld[kMaxVoices];            // Note on and not yet released
+    uint32_t mStartTime[kMaxVoices];
+
+    int mFree[kMaxVoices];             // Free voices, as a stack
+    int mFreeCount;
+};
+
+#endif
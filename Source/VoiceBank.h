@@ -0,0 +1,898 @@
+#ifndef __VoiceBank_h__
+#define __VoiceBank_h__
+
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+#include "SynthVoice.h"
+#include "FastMath.h"
+#include "WavetableBank.h"
+#include "SIMDLanes.h"
+#include "StateVariableFilter.h"
+#include "ModulationMatrix.h"
+#include "VoiceAllocator.h"
+
+static const int kDefaultPolyphony = 64;
+static const int kNumOscillators = 3;
+static const float kVoiceStealFadeTime = 0.003f;  // Seconds a stolen voice fades before its new note
+static const int kMaxUnison = 8;  // Sub-oscillators per oscillator in unison mode
+
+// All voices of the synth. Per-voice state is stored as structure-of-arrays and
+// voices are addressed by index, so Render() can process VectorLanes::kWidth voices
+// per instruction. Only voices on the compacted active list are ever visited.
+//
+// State for kMaxVoices voices is allocated with the bank, whatever the polyphony, so
+// changing polyphony never allocates.
+class VoiceBank {
+public:
+    // Modulation for one block: the global values at its first frame and at the frame just
+    // after it (where the next block starts). Voices ramp linearly between the two, after
+    // adding the routes from per-voice sources (which may be NULL when there are none).
+    struct ModulationBlock {
+        ModulationValues start;
+        ModulationValues end;
+        const ModulationRoute *voiceRoutes;
+        int numVoiceRoutes;
+    };
+
+    VoiceBank() {
+        // Every per-voice array starts on its own cache line, so voices in one group of
+        // lanes never share a line with another array
+        mStorage.resize(LayOutStorage(NULL) + kCacheLineSize);
+        uintptr_t base = ((uintptr_t)&mStorage[0] + kCacheLineSize - 1) & ~(uintptr_t)(kCacheLineSize - 1);
+        LayOutStorage((uint8_t *)base);
+        Reset();
+    }
+
+    // Default settings with every voice idle. Not thread-safe (SynthEngine::Reset calls it).
+    void Reset() {
+        mSampleRate = 44100.0;
+        mFilterCutoff = 20000.0f;
+        mFilterResonance = 0.5f;
+        mFilterMode = kFilterMode_LowPass;
+        mStereoSpread = 0.0f;
+        SetEnvelope(0.01f, 0.1f, 0.7f, 0.3f);
+
+        for (int osc = 0; osc < kNumOscillators; osc++) {
+            mOscillators[osc].waveform = kWaveform_Sine;
+            mOscillators[osc].octave = 0;
+            mOscillators[osc].detune = 0.0f;
+            mOscillators[osc].volume = (osc == 0) ? 1.0f : 0.0f;  // Only oscillator 1 is audible
+            mOscillators[osc].pitchRatio = 1.0;
+            SetUnison(osc, 1, 0.0f, 0.0f);
+        }
+
+        for (int voice = 0; voice < kMaxVoices; voice++) {
+            mNote[voice] = -1;
+            mVelocityGain[voice] = 0.0f;
+            mVelocitySource[voice] = 0.0f;
+            mNoteSource[voice] = 0.0f;
+            mNoteIncrement[voice] = 0.0;
+            ResetPhases(voice);
+            mLowpass[voice] = 0.0f;
+            mBandpass[voice] = 0.0f;
+            mLowpassRight[voice] = 0.0f;
+            mBandpassRight[voice] = 0.0f;
+            mAmpEnv[voice].Reset();
+            mPanLeft[voice] = 1.0f;
+            mPanRight[voice] = 1.0f;
+            mActive[voice] = false;
+            mPendingNote[voice] = -1;
+        }
+        mActiveCount = 0;
+        mPendingCount = 0;
+        mAllocator.Reset(kDefaultPolyphony);
+    }
+
+    // How many voices may play at once, 1 to kMaxVoices. Lowering it lets voices above
+    // the new limit finish rather than cutting them off.
+    void SetPolyphony(int polyphony) {
+        mAllocator.SetNumVoices(polyphony);
+    }
+
+    int GetPolyphony() const {
+        return mAllocator.GetNumVoices();
+    }
+
+    // Starts note on a voice chosen by the allocator: the note's own voice when it's
+    // retriggered, a free voice, or else one taken by the steal policy. A stolen voice
+    // fades out over kVoiceStealFadeTime and the new note starts when it's silent.
+    // Returns the voice, or -1 if none could be had.
+    int StartNote(int note, int velocity, double sampleRate) {
+        int voice = mAllocator.Allocate(note);
+        if (voice >= 0 && mPendingNote[voice] < 0) {
+            NoteOn(voice, note, velocity, sampleRate);
+            return voice;
+        }
+        if (voice >= 0) {
+            // Played again while its stolen voice is still fading
+            mPendingVelocity[voice] = velocity;
+            mPendingReleased[voice] = false;
+            return voice;
+        }
+
+        float levels[kMaxVoices];
+        for (int v = 0; v < kMaxVoices; v++) {
+            levels[v] = mAmpEnv[v].level * mVelocityGain[v];
+        }
+        voice = mAllocator.Steal(note, levels);
+        if (voice < 0) {
+            return -1;
+        }
+        if (mAmpEnv[voice].stage == kEnvStage_Idle && mPendingNote[voice] < 0) {
+            NoteOn(voice, note, velocity, sampleRate);
+            return voice;
+        }
+        // A voice already fading for a waiting note (or done fading, with the note not
+        // started yet) keeps going, and the new note replaces the waiting one
+        if (mPendingNote[voice] < 0) {
+            mAmpEnv[voice].Fade(kVoiceStealFadeTime);
+            mPendingCount++;
+        }
+        mPendingNote[voice] = note;
+        mPendingVelocity[voice] = velocity;
+        mPendingReleased[voice] = false;
+        mSampleRate = sampleRate;
+        return voice;
+    }
+
+    // Releases the voice holding note; false if the note isn't held
+    bool ReleaseNote(int note) {
+        int voice = mAllocator.Release(note);
+        if (voice < 0) {
+            return false;
+        }
+        if (mPendingNote[voice] >= 0) {
+            // Not started yet: it starts and releases straight away
+            mPendingReleased[voice] = true;
+        } else {
+            NoteOff(voice);
+        }
+        return true;
+    }
+
+    void SetStealPolicy(int policy) {
+        mAllocator.SetPolicy(policy);
+    }
+
+    int GetStealPolicy() const {
+        return mAllocator.GetPolicy();
+    }
+
+    void NoteOn(int voice, int note, int velocity, double sampleRate) {
+        ADSREnvelope& env = mAmpEnv[voice];
+        bool wasIdle = (env.stage == kEnvStage_Idle);
+        bool noteChanged = (note != mNote[voice]);
+
+        mNote[voice] = note;
+        mSampleRate = sampleRate;
+        if (!mActive[voice]) {
+            mActive[voice] = true;
+            mActiveVoices[mActiveCount++] = voice;
+        }
+
+        // Reset phases and filter state if voice was idle OR if note changed
+        // This prevents clicks when retriggering the same note, but ensures
+        // clean filter response when switching to a different note
+        if (wasIdle || noteChanged) {
+            ResetPhases(voice);
+            mLowpass[voice] = 0.0f;
+            mBandpass[voice] = 0.0f;
+            mLowpassRight[voice] = 0.0f;
+            mBandpassRight[voice] = 0.0f;
+        }
+
+        // Reset amplitude envelope level only if voice was idle
+        // This prevents clicks when retriggering
+        if (wasIdle) {
+            env.level = 0.0f;
+        }
+        env.stage = kEnvStage_Attack;
+        env.fadeTime = 0.0f;
+
+        // Apply velocity and scaling (reduced from 0.5f to 0.15f to prevent clipping)
+        mVelocityGain[voice] = (velocity / 127.0f) * 0.15f;
+
+        // Per-voice modulation sources
+        mVelocitySource[voice] = velocity / 127.0f;
+        mNoteSource[voice] = (note - 60) / 64.0f;
+
+        // Convert MIDI note to frequency: 440 * 2^((note-69)/12), then to cycles per sample
+        double frequency = 440.0 * pow(2.0, (note - 69) / 12.0);
+        mNoteIncrement[voice] = frequency / mSampleRate;
+
+        UpdatePan(voice);
+    }
+
+    void NoteOff(int voice) {
+        // Enter release stage and store current level for linear release
+        mAmpEnv[voice].Release();
+    }
+
+    void AllNotesOff() {
+        for (int slot = 0; slot < mActiveCount; slot++) {
+            int voice = mActiveVoices[slot];
+            if (mPendingNote[voice] >= 0) {
+                mPendingReleased[voice] = true;
+            } else {
+                NoteOff(voice);
+            }
+        }
+        mAllocator.ReleaseAll();
+    }
+
+    void Kill(int voice) {
+        // Immediately stop the voice
+        mNote[voice] = -1;
+        mAmpEnv[voice].stage = kEnvStage_Idle;
+        mAmpEnv[voice].level = 0.0f;
+        if (mPendingNote[voice] >= 0) {
+            mPendingNote[voice] = -1;
+            mPendingCount--;
+        }
+        if (mActive[voice]) {
+            mActive[voice] = false;
+            CompactActiveVoices();
+        }
+    }
+
+    bool IsActive(int voice) const { return mActive[voice]; }
+    int GetNote(int voice) const { return mNote[voice]; }
+    int GetActiveVoiceCount() const { return mActiveCount; }
+
+    void SetOscillator(int osc, int waveform, int octave, float detune, float volume) {
+        Oscillator& o = mOscillators[osc];
+        bool pitchChanged = (octave != o.octave || detune != o.detune);
+        o.waveform = waveform;
+        o.octave = octave;
+        o.detune = detune;
+        o.volume = volume;
+        if (pitchChanged) {
+            // Octave: multiply frequency by 2^octave
+            // Detune: multiply frequency by 2^(cents/1200)
+            o.pitchRatio = pow(2.0, octave) * pow(2.0, detune / 1200.0);
+        }
+    }
+
+    // Unison: count (1 to kMaxUnison) copies of the oscillator, detuned evenly across
+    // +/- detune cents and panned evenly across +/- width (0 to 1). The copies share
+    // 1/sqrt(count) gain so a detuned stack is about as loud as a single oscillator.
+    void SetUnison(int osc, int count, float detune, float width) {
+        Oscillator& o = mOscillators[osc];
+        count = count < 1 ? 1 : (count > kMaxUnison ? kMaxUnison : count);
+        width = fmaxf(0.0f, fminf(1.0f, width));
+        o.unison = count;
+        o.unisonDetune = detune;
+        o.unisonWidth = width;
+
+        float gain = 1.0f / sqrtf((float)count);
+        for (int u = 0; u < count; u++) {
+            // -1 for the lowest copy to 1 for the highest; 0 for a single oscillator
+            float spread = (count > 1) ? (2.0f * u / (count - 1) - 1.0f) : 0.0f;
+            o.unisonRatio[u] = (spread != 0.0f && detune != 0.0f) ?
+                               pow(2.0, spread * detune / 1200.0) : 1.0;
+            PanGains(spread * width, gain, o.unisonLeft[u], o.unisonRight[u]);
+        }
+    }
+
+    // Sub-oscillators a voice renders: the unison count of each audible oscillator
+    int GetSubOscillatorsPerVoice() const {
+        int count = 0;
+        for (int osc = 0; osc < kNumOscillators; osc++) {
+            if (mOscillators[osc].volume > 0.0f) {
+                count += mOscillators[osc].unison;
+            }
+        }
+        return count;
+    }
+
+    void SetFilterCutoff(float cutoff) {
+        mFilterCutoff = cutoff;
+    }
+
+    void SetFilterResonance(float resonance) {
+        mFilterResonance = resonance;
+    }
+
+    // One of FilterMode. Voices keep their filter state, so a switch doesn't click.
+    void SetFilterMode(int mode) {
+        mFilterMode = (mode >= 0 && mode < kNumFilterModes) ? mode : kFilterMode_LowPass;
+    }
+
+    // Spreads voices across the stereo field by note, from 0 (all centred) to 1 (four
+    // octaves either side of middle C reach the edges). Sounding voices move too.
+    void SetStereoSpread(float spread) {
+        mStereoSpread = fmaxf(0.0f, fminf(1.0f, spread));
+        for (int voice = 0; voice < kMaxVoices; voice++) {
+            UpdatePan(voice);
+        }
+    }
+
+    // One envelope shape for every voice: sounding voices follow a change from where they are
+    void SetEnvelope(float attack, float decay, float sustain, float release) {
+        mAmpEnvSettings.attack = attack;
+        mAmpEnvSettings.decay = decay;
+        mAmpEnvSettings.sustain = sustain;
+        mAmpEnvSettings.release = release;
+    }
+
+    // Renders n frames (n <= kMaxVoiceBlockSize) of every active voice, panned, and adds them
+    // into left and right (separate buffers). Returns the number of frames at the start of the
+    // block during which at least one voice was sounding (0 if all voices were idle).
+    int Render(float *left, float *right, int n, const ModulationBlock& mod) {
+        return RenderWith<VectorLanes>(left, right, n, mod);
+    }
+
+    // Render() on a chosen lane type. RenderWith<ScalarLanes> is the scalar reference path;
+    // voices left over after the last full group of Lanes::kWidth always use it.
+    template <class Lanes>
+    int RenderWith(float *left, float *right, int n, const ModulationBlock& mod) {
+        if (mActiveCount == 0 || n <= 0) return 0;
+        n = BeginBlock(n, mod);
+        int activeFrames = RenderSlots<Lanes>(0, mActiveCount, left, right, n);
+        EndBlock();
+        return activeFrames;
+    }
+
+    // Render() split into steps so disjoint ranges of the active list can be rendered on
+    // different threads: BeginBlock once, RenderSlots for each range, then EndBlock once.
+    // BeginBlock returns the block length actually used.
+    int BeginBlock(int n, const ModulationBlock& mod) {
+        if (n > kMaxVoiceBlockSize) n = kMaxVoiceBlockSize;
+        if (mPendingCount > 0) {
+            StartPendingNotes();
+        }
+        PrepareBlock(mBlock, n, mod);
+        return n;
+    }
+
+    // Renders active-list slots [firstSlot, lastSlot) and adds them into left and right.
+    // Returns the number of frames at the start of the block during which one of them was
+    // sounding.
+    template <class Lanes>
+    int RenderSlots(int firstSlot, int lastSlot, float *left, float *right, int n) {
+        // Envelopes branch per voice, so they run scalar into a frame-major buffer the
+        // lanes can load directly. Frames after a voice finishes are silent.
+        int activeFrames = 0;
+        for (int slot = firstSlot; slot < lastSlot; slot++) {
+            int voice = mActiveVoices[slot];
+            float envelope[kMaxVoiceBlockSize];
+            float envelopeStart = mAmpEnv[voice].level;
+            int length = mAmpEnv[voice].Render(envelope, n, mAmpEnvSettings, mSampleRate);
+            if (mBlock.numVoiceRoutes > 0) {
+                PrepareVoice(slot, voice, envelopeStart, mAmpEnv[voice].level);
+            }
+            if (length < n && mAmpEnv[voice].stage == kEnvStage_Idle && mPendingNote[voice] < 0) {
+                mActive[voice] = false;
+                mNote[voice] = -1;
+            }
+            for (int i = 0; i < length; i++) {
+                mEnvelopes[i][slot] = envelope[i];
+            }
+            for (int i = length; i < n; i++) {
+                mEnvelopes[i][slot] = 0.0f;
+            }
+            if (length > activeFrames) {
+                activeFrames = length;
+            }
+        }
+
+        int slot = firstSlot;
+        for (; slot + Lanes::kWidth <= lastSlot; slot += Lanes::kWidth) {
+            RenderLanes<Lanes>(mBlock, slot, left, right, n);
+        }
+        for (; slot < lastSlot; slot++) {
+            RenderLanes<ScalarLanes>(mBlock, slot, left, right, n);
+        }
+        return activeFrames;
+    }
+
+    // Drops voices that finished during the block from the active list
+    void EndBlock() {
+        CompactActiveVoices();
+    }
+
+private:
+    static const size_t kCacheLineSize = 64;
+
+    // Points the per-voice arrays into storage at base, each on its own cache line, and
+    // returns the bytes they take. With base NULL it only measures.
+    size_t LayOutStorage(uint8_t *base) {
+        size_t size = 0;
+        Place(base, size, mNote, kMaxVoices);
+        Place(base, size, mVelocityGain, kMaxVoices);
+        Place(base, size, mVelocitySource, kMaxVoices);
+        Place(base, size, mNoteSource, kMaxVoices);
+        Place(base, size, mNoteIncrement, kMaxVoices);
+        Place(base, size, mPhase, kNumOscillators);
+        Place(base, size, mLowpass, kMaxVoices);
+        Place(base, size, mBandpass, kMaxVoices);
+        Place(base, size, mLowpassRight, kMaxVoices);
+        Place(base, size, mBandpassRight, kMaxVoices);
+        Place(base, size, mAmpEnv, kMaxVoices);
+        Place(base, size, mPanLeft, kMaxVoices);
+        Place(base, size, mPanRight, kMaxVoices);
+        Place(base, size, mActive, kMaxVoices);
+        Place(base, size, mActiveVoices, kMaxVoices);
+        Place(base, size, mPendingNote, kMaxVoices);
+        Place(base, size, mPendingVelocity, kMaxVoices);
+        Place(base, size, mPendingReleased, kMaxVoices);
+        Place(base, size, mSlotParameters, kMaxVoices);
+        Place(base, size, mEnvelopes, kMaxVoiceBlockSize);
+        return size;
+    }
+
+    template <class T>
+    static void Place(uint8_t *base, size_t& size, T *&array, size_t count) {
+        size = (size + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+        array = base ? (T *)(base + size) : NULL;
+        size += count * sizeof(T);
+    }
+
+    struct Oscillator {
+        int waveform;
+        int octave;
+        float detune;
+        float volume;
+        double pitchRatio;  // 2^octave * 2^(detune/1200)
+        int unison;         // Sub-oscillators (1 = unison off)
+        float unisonDetune;
+        float unisonWidth;
+        double unisonRatio[kMaxUnison];  // Pitch of each sub-oscillator relative to pitchRatio
+        float unisonLeft[kMaxUnison];    // Gain and pan of each sub-oscillator
+        float unisonRight[kMaxUnison];
+    };
+
+    // Modulated settings for one voice over a block
+    struct VoiceParameters {
+        struct {
+            bool audible;
+            float volumeStart;
+            float volumeStep;
+            double pitchScaleStart;  // Pitch ratio including detune modulation
+            double pitchScaleEnd;
+        } osc[kNumOscillators];
+        SVFCoefficients filterFrom;  // Filter at the edges of the block
+        SVFCoefficients filterTo;
+        float masterStart;
+        float masterStep;
+    };
+
+    // Everything about a block that is the same for every voice
+    struct BlockParameters {
+        float rampScale;
+        int waveform[kNumOscillators];
+        bool stereo;  // Unison width is in use, so voices have separate left and right signals
+        int filterMode;
+        ModulationBlock mod;
+        int numVoiceRoutes;
+        ModulationRoute voiceRoutes[kNumModSlots];
+        VoiceParameters shared;  // Used for every voice when there are no per-voice routes
+    };
+
+    void PrepareBlock(BlockParameters& block, int n, const ModulationBlock& mod) const {
+        // Ramp step so the frame after the block lands on mod.end
+        block.rampScale = 1.0f / (float)n;
+        for (int osc = 0; osc < kNumOscillators; osc++) {
+            block.waveform[osc] = mOscillators[osc].waveform;
+        }
+        block.stereo = false;
+        for (int osc = 0; osc < kNumOscillators; osc++) {
+            const Oscillator& o = mOscillators[osc];
+            block.stereo = block.stereo || (o.unison > 1 && o.unisonWidth > 0.0f);
+        }
+        block.filterMode = mFilterMode;
+        block.mod = mod;
+        block.numVoiceRoutes = mod.voiceRoutes ? mod.numVoiceRoutes : 0;
+        for (int r = 0; r < block.numVoiceRoutes; r++) {
+            block.voiceRoutes[r] = mod.voiceRoutes[r];
+        }
+        ComputeVoiceParameters(block.shared, mod.start, mod.end, block.rampScale);
+    }
+
+    // Per-voice routes on top of the block's global modulation, into mSlotParameters[slot].
+    // envelopeStart and envelopeEnd are the amp envelope before and after the block.
+    void PrepareVoice(int slot, int voice, float envelopeStart, float envelopeEnd) {
+        float sourcesStart[kNumModSources] = {0};
+        sourcesStart[kModSource_Velocity] = mVelocitySource[voice];
+        sourcesStart[kModSource_NoteNumber] = mNoteSource[voice];
+        float sourcesEnd[kNumModSources];
+        memcpy(sourcesEnd, sourcesStart, sizeof(sourcesEnd));
+        sourcesStart[kModSource_AmpEnv] = envelopeStart;
+        sourcesEnd[kModSource_AmpEnv] = envelopeEnd;
+
+        ModulationValues start = mBlock.mod.start;
+        ModulationValues end = mBlock.mod.end;
+        ApplyModulationRoutes(mBlock.voiceRoutes, mBlock.numVoiceRoutes, sourcesStart, start);
+        ApplyModulationRoutes(mBlock.voiceRoutes, mBlock.numVoiceRoutes, sourcesEnd, end);
+        ComputeVoiceParameters(mSlotParameters[slot], start, end, mBlock.rampScale);
+    }
+
+    void ComputeVoiceParameters(VoiceParameters& params, const ModulationValues& start,
+                                const ModulationValues& end, float rampScale) const {
+        const float volumeModStart[kNumOscillators] = {
+            start.osc1VolumeMod, start.osc2VolumeMod, start.osc3VolumeMod
+        };
+        const float volumeModEnd[kNumOscillators] = {
+            end.osc1VolumeMod, end.osc2VolumeMod, end.osc3VolumeMod
+        };
+        const float detuneModStart[kNumOscillators] = {
+            start.osc1DetuneMod, start.osc2DetuneMod, start.osc3DetuneMod
+        };
+        const float detuneModEnd[kNumOscillators] = {
+            end.osc1DetuneMod, end.osc2DetuneMod, end.osc3DetuneMod
+        };
+
+        for (int osc = 0; osc < kNumOscillators; osc++) {
+            const Oscillator& o = mOscillators[osc];
+            float volumeStart = fmaxf(0.0f, fminf(1.0f, o.volume + volumeModStart[osc]));
+            float volumeEnd = fmaxf(0.0f, fminf(1.0f, o.volume + volumeModEnd[osc]));
+            params.osc[osc].audible = (volumeStart > 0.0f || volumeEnd > 0.0f);
+            params.osc[osc].volumeStart = volumeStart;
+            params.osc[osc].volumeStep = (volumeEnd - volumeStart) * rampScale;
+
+            // FastExp2 only when detune is modulated; for global modulation it's paid once per
+            // block, not per voice
+            params.osc[osc].pitchScaleStart = PitchScale(o, detuneModStart[osc]);
+            params.osc[osc].pitchScaleEnd = (detuneModEnd[osc] != detuneModStart[osc]) ?
+                                            PitchScale(o, detuneModEnd[osc]) :
+                                            params.osc[osc].pitchScaleStart;
+        }
+
+        params.filterFrom = ComputeFilterCoefficients(start);
+        params.filterTo = (end.filterCutoffMod != start.filterCutoffMod ||
+                           end.filterResonanceMod != start.filterResonanceMod) ?
+                          ComputeFilterCoefficients(end) : params.filterFrom;
+
+        // Master volume modulation
+        params.masterStart = fmaxf(0.0f, fminf(1.0f, 1.0f + start.masterVolumeMod));
+        float masterEnd = fmaxf(0.0f, fminf(1.0f, 1.0f + end.masterVolumeMod));
+        params.masterStep = (masterEnd - params.masterStart) * rampScale;
+    }
+
+    static double PitchScale(const Oscillator& o, float detuneMod) {
+        if (detuneMod == 0.0f) {
+            return o.pitchRatio;
+        }
+        return o.pitchRatio * FastExp2(detuneMod / 1200.0);
+    }
+
+    // Once per block edge, and only for the end when modulation moved
+    SVFCoefficients ComputeFilterCoefficients(const ModulationValues& modValues) const {
+        // Apply modulated filter cutoff and resonance
+        float cutoff = fmaxf(20.0f, mFilterCutoff + modValues.filterCutoffMod);
+        float modulatedResonance = fmaxf(0.5f, fminf(10.0f, mFilterResonance + modValues.filterResonanceMod));
+        return ComputeSVFCoefficients(cutoff, modulatedResonance, mSampleRate);
+    }
+
+    // Renders the Lanes::kWidth active voices starting at active-list slot firstSlot:
+    // gathers their state, runs oscillators, velocity, filter, envelope, master volume
+    // and pan as separate loops across all lanes, then scatters the state back. In a
+    // stereo block (unison width in use) the voices carry a right signal through the
+    // filter as well, with its own filter state.
+    template <class Lanes>
+    void RenderLanes(const BlockParameters& block, int firstSlot, float *left, float *right, int n) {
+        typedef typename Lanes::F F;
+        typedef typename Lanes::U U;
+        const int kWidth = Lanes::kWidth;
+
+        int voices[kWidth];
+        const VoiceParameters *params[kWidth];
+        for (int lane = 0; lane < kWidth; lane++) {
+            voices[lane] = mActiveVoices[firstSlot + lane];
+            params[lane] = (block.numVoiceRoutes > 0) ? &mSlotParameters[firstSlot + lane] : &block.shared;
+        }
+
+        F mixed[kMaxVoiceBlockSize];
+        F mixedRight[kMaxVoiceBlockSize];
+        for (int i = 0; i < n; i++) {
+            mixed[i] = Lanes::Set(0.0f);
+        }
+        if (block.stereo) {
+            for (int i = 0; i < n; i++) {
+                mixedRight[i] = Lanes::Set(0.0f);
+            }
+        }
+
+        // Oscillators, each as one or more unison sub-oscillators
+        for (int osc = 0; osc < kNumOscillators; osc++) {
+            const Oscillator& o = mOscillators[osc];
+            double incrementStart[kWidth];
+            double incrementEnd[kWidth];
+            const float *tables[kWidth];
+            float volumeStart[kWidth];
+            float volumeStep[kWidth];
+            bool audible = false;
+            for (int lane = 0; lane < kWidth; lane++) {
+                int voice = voices[lane];
+                const VoiceParameters& p = *params[lane];
+                incrementStart[lane] = mNoteIncrement[voice] * p.osc[osc].pitchScaleStart;
+                incrementEnd[lane] = mNoteIncrement[voice] * p.osc[osc].pitchScaleEnd;
+                volumeStart[lane] = p.osc[osc].volumeStart;
+                volumeStep[lane] = p.osc[osc].volumeStep;
+                audible = audible || p.osc[osc].audible;
+
+                // Mip level for the highest pitch any sub-oscillator reaches in this block so
+                // nothing aliases
+                tables[lane] = NULL;
+                if (p.osc[osc].audible) {
+                    double highest = fmax(incrementStart[lane], incrementEnd[lane]) *
+                                     o.unisonRatio[o.unison - 1];
+                    tables[lane] = WavetableBank::Shared().GetTable(block.waveform[osc], highest);
+                }
+                if (!tables[lane]) {
+                    tables[lane] = WavetableBank::GetSilentTable();
+                }
+            }
+
+            for (int u = 0; u < o.unison; u++) {
+                uint32_t phase[kWidth];
+                uint32_t increment[kWidth];
+                uint32_t incrementStep[kWidth];
+                for (int lane = 0; lane < kWidth; lane++) {
+                    double start = incrementStart[lane] * o.unisonRatio[u];
+                    double end = incrementEnd[lane] * o.unisonRatio[u];
+                    phase[lane] = mPhase[osc][u][voices[lane]];
+                    increment[lane] = WavetableBank::ToFixedIncrement(start);
+                    incrementStep[lane] = (uint32_t)(int32_t)((end - start) * block.rampScale * 4294967296.0);
+                }
+
+                if (audible) {
+                    const U fractionMask = Lanes::SetU((1u << kWavetableFractionBits) - 1);
+                    const F fractionScale = Lanes::Set(1.0f / (float)(1u << kWavetableFractionBits));
+                    U p = Lanes::LoadU(phase);
+                    U inc = Lanes::LoadU(increment);
+                    U step = Lanes::LoadU(incrementStep);
+                    F gainLeft = Lanes::Set(o.unisonLeft[u]);
+                    F gainRight = Lanes::Set(o.unisonRight[u]);
+                    F volume0 = Lanes::Mul(Lanes::Load(volumeStart), gainLeft);
+                    F volumeRamp = Lanes::Mul(Lanes::Load(volumeStep), gainLeft);
+                    F volumeRight0 = Lanes::Mul(Lanes::Load(volumeStart), gainRight);
+                    F volumeRightRamp = Lanes::Mul(Lanes::Load(volumeStep), gainRight);
+                    for (int i = 0; i < n; i++) {
+                        // Table reads are a per-lane gather; the interpolation is vectorized
+                        uint32_t index[kWidth];
+                        float a[kWidth];
+                        float b[kWidth];
+                        Lanes::StoreU(index, Lanes::ShiftRightU(p, kWavetableFractionBits));
+                        for (int lane = 0; lane < kWidth; lane++) {
+                            a[lane] = tables[lane][index[lane]];
+                            b[lane] = tables[lane][index[lane] + 1];
+                        }
+                        F fraction = Lanes::Mul(Lanes::ToFloat(Lanes::AndU(p, fractionMask)), fractionScale);
+                        F va = Lanes::Load(a);
+                        F sample = Lanes::Add(va, Lanes::Mul(Lanes::Sub(Lanes::Load(b), va), fraction));
+                        F frame = Lanes::Set((float)i);
+                        F volume = Lanes::Add(volume0, Lanes::Mul(volumeRamp, frame));
+                        mixed[i] = Lanes::Add(mixed[i], Lanes::Mul(sample, volume));
+                        if (block.stereo) {
+                            F volumeRight = Lanes::Add(volumeRight0, Lanes::Mul(volumeRightRamp, frame));
+                            mixedRight[i] = Lanes::Add(mixedRight[i], Lanes::Mul(sample, volumeRight));
+                        }
+                        p = Lanes::AddU(p, inc);
+                        inc = Lanes::AddU(inc, step);
+                    }
+                    Lanes::StoreU(phase, p);
+                } else {
+                    // Silent oscillator: keep its phase running so it stays in step when faded in
+                    uint32_t steps = (uint32_t)(n * (n - 1) / 2);
+                    for (int lane = 0; lane < kWidth; lane++) {
+                        phase[lane] += increment[lane] * (uint32_t)n + incrementStep[lane] * steps;
+                    }
+                }
+
+                for (int lane = 0; lane < kWidth; lane++) {
+                    mPhase[osc][u][voices[lane]] = phase[lane];
+                }
+            }
+        }
+
+        // Velocity
+        float gains[kWidth];
+        for (int lane = 0; lane < kWidth; lane++) {
+            gains[lane] = mVelocityGain[voices[lane]];
+        }
+        F velocityGain = Lanes::Load(gains);
+        for (int i = 0; i < n; i++) {
+            mixed[i] = Lanes::Mul(mixed[i], velocityGain);
+        }
+
+        // Filter. A mono block leaves the right filter state following the left, so a voice
+        // picks up seamlessly when unison width is turned up under it.
+        FilterLanes<Lanes>(block, params, voices, mixed, n, mLowpass, mBandpass);
+        const F *voiceRight = mixed;
+        if (block.stereo) {
+            for (int i = 0; i < n; i++) {
+                mixedRight[i] = Lanes::Mul(mixedRight[i], velocityGain);
+            }
+            FilterLanes<Lanes>(block, params, voices, mixedRight, n, mLowpassRight, mBandpassRight);
+            voiceRight = mixedRight;
+        } else {
+            for (int lane = 0; lane < kWidth; lane++) {
+                mLowpassRight[voices[lane]] = mLowpass[voices[lane]];
+                mBandpassRight[voices[lane]] = mBandpass[voices[lane]];
+            }
+        }
+
+        // Apply ADSR envelope (after filter), then master volume with each lane's pan gains
+        // folded in, and sum the lanes into left and right
+        float masterLeftStart[kWidth], masterLeftStep[kWidth];
+        float masterRightStart[kWidth], masterRightStep[kWidth];
+        for (int lane = 0; lane < kWidth; lane++) {
+            int voice = voices[lane];
+            masterLeftStart[lane] = params[lane]->masterStart * mPanLeft[voice];
+            masterLeftStep[lane] = params[lane]->masterStep * mPanLeft[voice];
+            masterRightStart[lane] = params[lane]->masterStart * mPanRight[voice];
+            masterRightStep[lane] = params[lane]->masterStep * mPanRight[voice];
+        }
+        F masterLeft0 = Lanes::Load(masterLeftStart), masterLeftRamp = Lanes::Load(masterLeftStep);
+        F masterRight0 = Lanes::Load(masterRightStart), masterRightRamp = Lanes::Load(masterRightStep);
+        for (int i = 0; i < n; i++) {
+            F frame = Lanes::Set((float)i);
+            F envelope = Lanes::Load(&mEnvelopes[i][firstSlot]);
+            F masterLeft = Lanes::Add(masterLeft0, Lanes::Mul(masterLeftRamp, frame));
+            F masterRight = Lanes::Add(masterRight0, Lanes::Mul(masterRightRamp, frame));
+            float sumLeft, sumRight;
+            Lanes::SumPair(Lanes::Mul(Lanes::Mul(mixed[i], envelope), masterLeft),
+                           Lanes::Mul(Lanes::Mul(voiceRight[i], envelope), masterRight),
+                           &sumLeft, &sumRight);
+            left[i] += sumLeft;
+            right[i] += sumRight;
+        }
+    }
+
+    // The voice filter (see SVFLanes) over one signal of the lanes' voices, with its
+    // integrators in lowpassStates and bandpassStates (indexed by voice)
+    template <class Lanes>
+    static void FilterLanes(const BlockParameters& block, const VoiceParameters *const *params,
+                            const int *voices, typename Lanes::F *samples, int n,
+                            float *lowpassStates, float *bandpassStates) {
+        typedef typename Lanes::F F;
+        const int kWidth = Lanes::kWidth;
+
+        float lowpassState[kWidth];
+        float bandpassState[kWidth];
+        float gStart[kWidth], gStep[kWidth];
+        float kStart[kWidth], kStep[kWidth];
+        bool moving = false;
+        for (int lane = 0; lane < kWidth; lane++) {
+            lowpassState[lane] = lowpassStates[voices[lane]];
+            bandpassState[lane] = bandpassStates[voices[lane]];
+            const SVFCoefficients& from = params[lane]->filterFrom;
+            const SVFCoefficients& to = params[lane]->filterTo;
+            gStart[lane] = from.g;
+            gStep[lane] = (to.g - from.g) * block.rampScale;
+            kStart[lane] = from.k;
+            kStep[lane] = (to.k - from.k) * block.rampScale;
+            moving = moving || from.g != to.g || from.k != to.k;
+        }
+        F lowpass = Lanes::Load(lowpassState);
+        F bandpass = Lanes::Load(bandpassState);
+        SVFLanes<Lanes>::Process(block.filterMode, samples, n, bandpass, lowpass,
+                                 gStart, gStep, kStart, kStep, moving);
+        Lanes::Store(lowpassState, lowpass);
+        Lanes::Store(bandpassState, bandpass);
+        for (int lane = 0; lane < kWidth; lane++) {
+            lowpassStates[voices[lane]] = FlushDenormal(lowpassState[lane]);
+            bandpassStates[voices[lane]] = FlushDenormal(bandpassState[lane]);
+        }
+    }
+
+    // Oscillator phases for a new note. Unison copies start spread around the cycle (by the
+    // golden ratio, so no two line up) rather than all in phase, which would flange.
+    void ResetPhases(int voice) {
+        for (int osc = 0; osc < kNumOscillators; osc++) {
+            for (int u = 0; u < kMaxUnison; u++) {
+                mPhase[osc][u][voice] = (uint32_t)u * 0x9E3779B9u;
+            }
+        }
+    }
+
+    // Pan gains for the voice's note (the stereo mix matches the old mono one at zero spread)
+    void UpdatePan(int voice) {
+        float position = 0.0f;  // -1 (left) to 1 (right)
+        if (mNote[voice] >= 0) {
+            position = fmaxf(-1.0f, fminf(1.0f, mStereoSpread * (mNote[voice] - 60) / 48.0f));
+        }
+        PanGains(position, 1.0f, mPanLeft[voice], mPanRight[voice]);
+    }
+
+    // Constant-power gains for a position from -1 (left) to 1 (right), scaled so the centre
+    // keeps the given gain in both channels. Exact at the centre and the edges (rather than
+    // cos(pi/4) * sqrt(2), or cos(pi/2)), so a hard-panned voice is silent in the other
+    // channel.
+    static void PanGains(float position, float gain, float& left, float& right) {
+        if (position == 0.0f) {
+            left = gain;
+            right = gain;
+        } else if (position <= -1.0f || position >= 1.0f) {
+            left = (position < 0.0f) ? (float)M_SQRT2 * gain : 0.0f;
+            right = (position < 0.0f) ? 0.0f : (float)M_SQRT2 * gain;
+        } else {
+            float angle = (position + 1.0f) * (float)(M_PI / 4.0);
+            left = cosf(angle) * (float)M_SQRT2 * gain;
+            right = sinf(angle) * (float)M_SQRT2 * gain;
+        }
+    }
+
+    // Starts the notes waiting on stolen voices that have finished fading out
+    void StartPendingNotes() {
+        for (int slot = 0; slot < mActiveCount; slot++) {
+            int voice = mActiveVoices[slot];
+            if (mPendingNote[voice] < 0 || mAmpEnv[voice].stage != kEnvStage_Idle) continue;
+            int note = mPendingNote[voice];
+            mPendingNote[voice] = -1;
+            mPendingCount--;
+            NoteOn(voice, note, mPendingVelocity[voice], mSampleRate);
+            if (mPendingReleased[voice]) {
+                NoteOff(voice);
+            }
+        }
+    }
+
+    // Drop voices that went idle from the active list, keeping the order of the rest, and
+    // hand them back to the allocator
+    void CompactActiveVoices() {
+        int count = 0;
+        for (int slot = 0; slot < mActiveCount; slot++) {
+            int voice = mActiveVoices[slot];
+            if (mActive[voice]) {
+                mActiveVoices[count++] = voice;
+            } else {
+                mAllocator.VoiceFinished(voice);
+            }
+        }
+        mActiveCount = count;
+    }
+
+    double mSampleRate;
+    Oscillator mOscillators[kNumOscillators];
+    float mFilterCutoff;
+    float mFilterResonance;
+    int mFilterMode;
+    float mStereoSpread;
+    ADSRSettings mAmpEnvSettings;  // Every voice's amplitude envelope follows these
+
+    // Per-voice state, indexed by voice, in mStorage (see LayOutStorage)
+    std::vector<uint8_t> mStorage;
+    int *mNote;
+    float *mVelocityGain;
+    float *mVelocitySource;                           // Velocity as a modulation source, 0 to 1
+    float *mNoteSource;                               // Note number as a modulation source
+    double *mNoteIncrement;                           // Cycles per sample at the note's pitch
+    uint32_t (*mPhase)[kMaxUnison][kMaxVoices];       // [osc][unison][voice]; one cycle = 2^32
+    float *mLowpass;                                  // Filter integrators (low-pass and band-pass)
+    float *mBandpass;
+    float *mLowpassRight;                             // Right signal's filter (stereo blocks)
+    float *mBandpassRight;
+    ADSREnvelope *mAmpEnv;
+    float *mPanLeft;                                  // Pan gains (1 in both when centred)
+    float *mPanRight;
+    bool *mActive;
+
+    // Indices of the active voices, compacted after every block
+    int *mActiveVoices;
+    int mActiveCount;
+
+    // Notes waiting for their stolen voice to fade out (-1 when none)
+    int *mPendingNote;
+    int *mPendingVelocity;
+    bool *mPendingReleased;                           // Note off arrived before it started
+    int mPendingCount;
+
+    VoiceAllocator mAllocator;
+
+    // Settings for the block being rendered (see BeginBlock), and per-voice settings
+    // indexed by active-list slot when there are per-voice routes
+    BlockParameters mBlock;
+    VoiceParameters *mSlotParameters;
+
+    // Envelope levels for the current block, indexed [frame][active-list slot]
+    float (*mEnvelopes)[kMaxVoices];
+
+    // The arrays point into mStorage
+    VoiceBank(const VoiceBank&);
+    VoiceBank& operator=(const VoiceBank&);
+};
+
+#endif
@@ -0,0 +1,276 @@
+#ifndef __VoiceRenderPool_h__
+#define __VoiceRenderPool_h__
+
+#include <atomic>
+#include <thread>
+#include <string.h>
+#include "VoiceBank.h"
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <pthread.h>
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Optional worker threads for VoiceBank rendering. Each render slice, the active
+// voices are split between the audio thread and up to kMaxWorkers workers; every
+// worker renders its share into its own stereo mix buffers, and the audio thread sums them.
+//
+// The audio thread never locks or allocates. Workers spin briefly waiting for the
+// next slice (back-to-back slices of one render call keep them hot) and then sleep
+// on a futex (Linux) or Mach semaphore (macOS). The audio thread only makes a wake
+// call when a worker is actually asleep.
+class VoiceRenderPool {
+public:
+    static const int kMaxWorkers = 3;
+
+    // Below this many voices per thread the sync cost outweighs the work
+    static const int kMinVoicesPerThread = 8;
+
+    // Host buffers shorter than this render single-threaded: workers would go to
+    // sleep between render calls and the wake-up latency dominates
+    static const int kMinFramesForWorkers = 128;
+
+    VoiceRenderPool() : mNumWorkers(0), mSlice(0), mPending(0), mSleeping(0), mQuit(false) {
+        memset(&mJob, 0, sizeof(mJob));
+    }
+
+    ~VoiceRenderPool() {
+        Stop();
+    }
+
+    // Spawns the workers. Allocates, so call it from Initialize, never from the render thread.
+    void Start(int numWorkers) {
+        Stop();
+        if (numWorkers > kMaxWorkers) numWorkers = kMaxWorkers;
+        if (numWorkers < 0) numWorkers = 0;
+
+        mQuit.store(false);
+        for (int w = 0; w < numWorkers; w++) {
+#if defined(__APPLE__)
+            semaphore_create(mach_task_self(), &mSemaphores[w], SYNC_POLICY_FIFO, 0);
+#endif
+            mThreads[w] = std::thread(&VoiceRenderPool::WorkerMain, this, w);
+        }
+        mNumWorkers = numWorkers;
+    }
+
+    void Stop() {
+        if (mNumWorkers == 0) return;
+        mQuit.store(true);
+        PublishSlice(0);
+        WakeWorkers();
+        for (int w = 0; w < mNumWorkers; w++) {
+            mThreads[w].join();
+#if defined(__APPLE__)
+            semaphore_destroy(mach_task_self(), mSemaphores[w]);
+#endif
+        }
+        mNumWorkers = 0;
+    }
+
+    int GetWorkerCount() const { return mNumWorkers; }
+
+    // Same contract as VoiceBank::Render. Uses at most maxWorkers workers, and fewer
+    // (down to none) when there aren't minVoicesPerThread active voices for each thread.
+    int Render(VoiceBank& bank, float *left, float *right, int n, const VoiceBank::ModulationBlock& mod,
+               int maxWorkers, int minVoicesPerThread = kMinVoicesPerThread) {
+        int activeVoices = bank.GetActiveVoiceCount();
+        int workers = activeVoices / minVoicesPerThread - 1;
+        if (workers > maxWorkers) workers = maxWorkers;
+        if (workers > mNumWorkers) workers = mNumWorkers;
+        if (workers <= 0 || n <= 0) {
+            return bank.Render(left, right, n, mod);
+        }
+
+        n = bank.BeginBlock(n, mod);
+
+        // Split the active list into equal ranges, rounded to whole lane groups
+        const int kWidth = VectorLanes::kWidth;
+        int threads = workers + 1;
+        int perThread = (activeVoices + threads - 1) / threads;
+        perThread = ((perThread + kWidth - 1) / kWidth) * kWidth;
+        int slot = 0;
+        for (int t = 0; t <= threads; t++) {
+            mJob.rangeStart[t] = (slot < activeVoices) ? slot : activeVoices;
+            slot += perThread;
+        }
+        mJob.bank = &bank;
+        mJob.frames = n;
+
+        // Publish the slice; seq_cst pairs with the worker's sleep check in WaitForSlice
+        mPending.store(workers, std::memory_order_relaxed);
+        PublishSlice(workers);
+        if (mSleeping.load() > 0) {
+            WakeWorkers();
+        }
+
+        // The audio thread takes the first range itself
+        int activeFrames = bank.RenderSlots<VectorLanes>(mJob.rangeStart[0], mJob.rangeStart[1], left, right, n);
+
+        for (int spins = 0; mPending.load(std::memory_order_acquire) != 0; spins++) {
+            if (spins < kSpinIterations) {
+                CpuRelax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        for (int w = 0; w < workers; w++) {
+            const float *bufferLeft = mBuffers[w][0];
+            const float *bufferRight = mBuffers[w][1];
+            for (int i = 0; i < n; i++) {
+                left[i] += bufferLeft[i];
+                right[i] += bufferRight[i];
+            }
+            if (mJob.activeFrames[w] > activeFrames) {
+                activeFrames = mJob.activeFrames[w];
+            }
+        }
+
+        bank.EndBlock();
+        return activeFrames;
+    }
+
+private:
+    // Pause iterations before a waiting worker sleeps (roughly 50-100 us)
+    static const int kSpinIterations = 4096;
+
+    // Layout of the slice word: worker count in the low bits, counter above
+    static const int kSliceCounterShift = 2;
+    static const uint32_t kSliceWorkerMask = (1u << kSliceCounterShift) - 1;
+
+    // Only the workers taking part in a slice read the job, and the audio thread doesn't
+    // touch it again until they are done
+    struct Job {
+        VoiceBank *bank;
+        int frames;
+        int rangeStart[kMaxWorkers + 2];  // Thread t renders [rangeStart[t], rangeStart[t + 1])
+        int activeFrames[kMaxWorkers];
+    };
+
+    static inline void CpuRelax() {
+#if defined(__SSE2__)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+
+    void WorkerMain(int index) {
+        PinWorker(index);
+        ScopedFlushDenormals flushDenormals;  // Like the render thread, for the worker's whole life
+
+        uint32_t seen = 0;
+        while (true) {
+            seen = WaitForSlice(index, seen);
+            if (mQuit.load()) break;
+            if (index >= (int)(seen & kSliceWorkerMask)) continue;
+
+            float *bufferLeft = mBuffers[index][0];
+            float *bufferRight = mBuffers[index][1];
+            int n = mJob.frames;
+            for (int i = 0; i < n; i++) {
+                bufferLeft[i] = 0.0f;
+                bufferRight[i] = 0.0f;
+            }
+            mJob.activeFrames[index] = mJob.bank->RenderSlots<VectorLanes>(mJob.rangeStart[index + 1],
+                                                                           mJob.rangeStart[index + 2],
+                                                                           bufferLeft, bufferRight, n);
+            mPending.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    // Starts a new slice for the given number of workers. The slice word carries the worker
+    // count so that workers sitting the slice out never have to read the job.
+    void PublishSlice(int workers) {
+        uint32_t counter = (mSlice.load(std::memory_order_relaxed) >> kSliceCounterShift) + 1;
+        mSlice.store((counter << kSliceCounterShift) | (uint32_t)workers);
+    }
+
+    // Spins, then sleeps, until the slice word moves past seen. Returns the new word.
+    uint32_t WaitForSlice(int index, uint32_t seen) {
+#if !defined(__APPLE__)
+        (void)index;  // Only the Mach semaphores are per worker
+#endif
+        for (int spins = 0; spins < kSpinIterations; spins++) {
+            uint32_t slice = mSlice.load(std::memory_order_acquire);
+            if (slice != seen) return slice;
+            CpuRelax();
+        }
+
+        while (true) {
+            mSleeping.fetch_add(1);
+            uint32_t slice = mSlice.load();
+            if (slice == seen) {
+#if defined(__APPLE__)
+                semaphore_wait(mSemaphores[index]);
+#elif defined(__linux__)
+                syscall(SYS_futex, (uint32_t *)&mSlice, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+#else
+                std::this_thread::yield();
+#endif
+                slice = mSlice.load();
+            }
+            mSleeping.fetch_sub(1);
+            if (slice != seen) return slice;
+        }
+    }
+
+    void WakeWorkers() {
+#if defined(__APPLE__)
+        for (int w = 0; w < mNumWorkers; w++) {
+            semaphore_signal(mSemaphores[w]);
+        }
+#elif defined(__linux__)
+        syscall(SYS_futex, (uint32_t *)&mSlice, FUTEX_WAKE_PRIVATE, kMaxWorkers, NULL, NULL, 0);
+#endif
+    }
+
+    // Keeps each worker on its own core (Linux) or gives the scheduler an affinity and
+    // priority hint (macOS has no hard pinning)
+    static void PinWorker(int index) {
+#if defined(__APPLE__)
+        thread_affinity_policy_data_t affinity = { index + 1 };
+        thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_AFFINITY_POLICY,
+                          (thread_policy_t)&affinity, THREAD_AFFINITY_POLICY_COUNT);
+        pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+#elif defined(__linux__)
+        unsigned int cores = std::thread::hardware_concurrency();
+        if (cores > 1) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET((index + 1) % cores, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+#else
+        (void)index;
+#endif
+    }
+
+    int mNumWorkers;
+    std::thread mThreads[kMaxWorkers];
+#if defined(__APPLE__)
+    semaphore_t mSemaphores[kMaxWorkers];
+#endif
+
+    std::atomic<uint32_t> mSlice;       // Slice counter and worker count; also the futex word
+    std::atomic<int> mPending;          // Workers still rendering the current slice
+    std::atomic<int> mSleeping;         // Workers blocked in WaitForSlice
+    std::atomic<bool> mQuit;
+
+    Job mJob;
+    float mBuffers[kMaxWorkers][2][kMaxVoiceBlockSize];  // Left and right per worker
+};
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef __WavetableBank_h__
+#define __WavetableBank_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cmath>
+#include <complex>
+#include <mutex>
+#include <vector>
+
+// Band-limited single-cycle tables for each Waveform, one mip level per octave.
+// Level k serves phase increments up to 2^k / kWavetableSize cycles per sample and
+// holds only the harmonics that stay below Nyquist at that increment.
+static const int kWavetableSizeBits = 11;
+static const int kWavetableSize = 1 << kWavetableSizeBits;  // 2048 samples per cycle
+static const int kWavetableLevels = kWavetableSizeBits;     // 1024 harmonics down to 1
+static const int kWavetableFractionBits = 32 - kWavetableSizeBits;
+
+class WavetableBank {
+public:
+    // One bank shared by every plugin instance
+    static WavetableBank& Shared() {
+        static WavetableBank bank;
+        return bank;
+    }
+
+    // Builds all tables. Allocates, so call it from Initialize, never from the render thread.
+    // Later calls are no-ops.
+    void Build() {
+        std::lock_guard<std::mutex> lock(mBuildMutex);
+        if (mBuilt) return;
+
+        mStorage.assign((size_t)kNumTables * kTableStride, 0.0f);
+
+        // Sine has no harmonics to limit, so a single table covers every level
+        float *sine = TableAt(0);
+        for (int i = 0; i <= kWavetableSize; i++) {
+            sine[i] = (float)sin(2.0 * M_PI * i / kWavetableSize);
+        }
+        for (int level = 0; level < kWavetableLevels; level++) {
+            mTables[0][level] = sine;
+        }
+
+        int tableIndex = 1;
+        for (int waveform = 1; waveform < kNumWaveforms; waveform++) {
+            for (int level = 0; level < kWavetableLevels; level++) {
+                int maxHarmonic = (kWavetableSize / 2) >> level;
+                if (maxHarmonic >= kWavetableSize / 2) {
+                    maxHarmonic = kWavetableSize / 2 - 1;
+                }
+                float *table = TableAt(tableIndex++);
+                FillTable(table, waveform, maxHarmonic);
+                mTables[waveform][level] = table;
+            }
+        }
+
+        mBuilt = true;
+    }
+
+    bool IsBuilt() const { return mBuilt; }
+
+    int GetTableCount() const { return kNumTables; }
+
+    size_t GetMemoryUsage() const { return (size_t)kNumTables * kTableStride * sizeof(float); }
+
+    // Table for a waveform played at the given increment (cycles per sample). Returns NULL
+    // if the bank isn't built yet or the fundamental itself would be above Nyquist.
+    const float *GetTable(int waveform, double phaseIncrement) const {
+        if (!mBuilt || waveform < 0 || waveform >= kNumWaveforms) return NULL;
+        if (phaseIncrement >= 0.5) return NULL;
+
+        int level = 0;
+        double levelLimit = 1.0 / kWavetableSize;
+        while (level < kWavetableLevels - 1 && phaseIncrement > levelLimit) {
+            levelLimit *= 2.0;
+            level++;
+        }
+        return mTables[waveform][level];
+    }
+
+    // All-zero table for oscillators that have nothing to play
+    static const float *GetSilentTable() {
+        static const float silence[kWavetableSize + 1] = { 0.0f };
+        return silence;
+    }
+
+    // Linearly interpolated read at a 32-bit fixed-point phase (one cycle = 2^32)
+    static inline float Read(const float *table, uint32_t phase) {
+        uint32_t index = phase >> kWavetableFractionBits;
+        float fraction = (float)(phase & ((1u << kWavetableFractionBits) - 1)) *
+                         (1.0f / (float)(1u << kWavetableFractionBits));
+        float a = table[index];
+        float b = table[index + 1];
+        return a + (b - a) * fraction;
+    }
+
+    // Converts cycles per sample to a fixed-point phase increment (wraps like the phase does)
+    static inline uint32_t ToFixedIncrement(double phaseIncrement) {
+        return (uint32_t)(int64_t)(phaseIncrement * 4294967296.0);
+    }
+
+private:
+    static const int kNumWaveforms = 4;
+    static const int kTableStride = kWavetableSize + 1;  // Guard sample for interpolation
+    static const int kNumTables = 1 + (kNumWaveforms - 1) * kWavetableLevels;
+
+    WavetableBank() : mBuilt(false) {
+        for (int w = 0; w < kNumWaveforms; w++) {
+            for (int level = 0; level < kWavetableLevels; level++) {
+                mTables[w][level] = NULL;
+            }
+        }
+    }
+
+    WavetableBank(const WavetableBank&);
+    WavetableBank& operator=(const WavetableBank&);
+
+    float *TableAt(int index) { return &mStorage[(size_t)index * kTableStride]; }
+
+    // Sums the Fourier series of the naive waveforms up to maxHarmonic with an inverse FFT:
+    //   square   = (4/pi) * sum over odd k of sin(2 pi k x) / k
+    //   sawtooth = -(2/pi) * sum over k of sin(2 pi k x) / k
+    //   triangle = -(8/pi^2) * sum over odd k of cos(2 pi k x) / k^2
+    static void FillTable(float *table, int waveform, int maxHarmonic) {
+        std::vector<std::complex<double> > spectrum(kWavetableSize);
+        for (int k = 1; k <= maxHarmonic; k++) {
+            bool odd = (k & 1) != 0;
+            switch (waveform) {
+                case 1: // Square
+                    if (odd) spectrum[k] = std::complex<double>(0.0, -0.5 * 4.0 / (M_PI * k));
+                    break;
+                case 2: // Sawtooth
+                    spectrum[k] = std::complex<double>(0.0, 0.5 * 2.0 / (M_PI * k));
+                    break;
+                case 3: // Triangle
+                    if (odd) spectrum[k] = std::complex<double>(-0.5 * 8.0 / (M_PI * M_PI * k * k), 0.0);
+                    break;
+            }
+            spectrum[kWavetableSize - k] = std::conj(spectrum[k]);
+        }
+
+        InverseFFT(spectrum);
+
+        for (int i = 0; i < kWavetableSize; i++) {
+            table[i] = (float)spectrum[i].real();
+        }
+        table[kWavetableSize] = table[0];
+    }
+
+    // In-place radix-2 inverse DFT without the 1/N scale: x[n] = sum X[k] e^(+2 pi i k n / N)
+    static void InverseFFT(std::vector<std::complex<double> >& x) {
+        int n = (int)x.size();
+        for (int i = 1, j = 0; i < n; i++) {
+            int bit = n >> 1;
+            for (; j & bit; bit >>= 1) {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j) std::swap(x[i], x[j]);
+        }
+        for (int length = 2; length <= n; length <<= 1) {
+            double angle = 2.0 * M_PI / length;
+            std::complex<double> step(cos(angle), sin(angle));
+            for (int i = 0; i < n; i += length) {
+                std::complex<double> w(1.0, 0.0);
+                for (int j = 0; j < length / 2; j++) {
+                    std::complex<double> u = x[i + j];
+                    std::complex<double> v = x[i + j + length / 2] * w;
+                    x[i + j] = u + v;
+                    x[i + j + length / 2] = u - v;
+                    w *= step;
+                }
+            }
+        }
+    }
+
+    std::mutex mBuildMutex;
+    bool mBuilt;
+    std::vector<float> mStorage;
+    const float *mTables[kNumWaveforms][kWavetableLevels];
+};
+
+#endif
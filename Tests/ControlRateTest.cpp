@@ -0,0 +1,98 @@
+// Control-rate modulation in SynthEngine: LFOs, the filter envelope and the mod matrix
+// evaluated every kParam_ControlBlockSize frames and ramped across the block must stay
+// close to evaluating them every frame (a control block of 1).
+
+#include "SynthEngine.h"
+#include "TestCheck.h"
+#include <vector>
+
+namespace {
+
+const double kSampleRate = 44100.0;
+const int kBufferFrames = 256;
+const int kBuffers = 400;       // About 2.3 seconds
+const int kReleaseBuffer = 250;
+
+// Every global source in use: LFO 1 on the cutoff and master volume, LFO 2 on osc 1's
+// detune and the filter envelope on the cutoff, through a resonant filter
+const float kParameters[][2] = {
+    { kParam_Osc1_Waveform, 2 },
+    { kParam_Osc2_Waveform, 1 },
+    { kParam_Osc2_Volume, 0.5f },
+    { kParam_FilterCutoff, 1500 },
+    { kParam_FilterResonance, 2 },
+    { kParam_EnvRelease, 0.3f },
+    { kParam_FilterEnvAttack, 0.05f },
+    { kParam_FilterEnvDecay, 0.3f },
+    { kParam_FilterEnvSustain, 0.3f },
+    { kParam_LFO1_Rate, 6 },
+    { kParam_LFO2_Rate, 4 },
+    { kParam_ModSlot1_Source, kModSource_LFO1 },
+    { kParam_ModSlot1_Dest, kModDest_FilterCutoff },
+    { kParam_ModSlot1_Intensity, 0.3f },
+    { kParam_ModSlot2_Source, kModSource_LFO1 },
+    { kParam_ModSlot2_Dest, kModDest_MasterVolume },
+    { kParam_ModSlot2_Intensity, 0.3f },
+    { kParam_ModSlot3_Source, kModSource_LFO2 },
+    { kParam_ModSlot3_Dest, kModDest_Osc1_Detune },
+    { kParam_ModSlot3_Intensity, 0.3f },
+    { kParam_ModSlot4_Source, kModSource_FilterEnv },
+    { kParam_ModSlot4_Dest, kModDest_FilterCutoff },
+    { kParam_ModSlot4_Intensity, 0.4f },
+};
+
+// Renders two 4-note chords (one entering mid-buffer) and their release, mono
+std::vector<float> RenderScenario(int controlBlockSize) {
+    SynthEngine *engine = new SynthEngine();
+    engine->SetSampleRate(kSampleRate);
+    engine->Initialize();
+    for (size_t i = 0; i < sizeof(kParameters) / sizeof(kParameters[0]); i++) {
+        engine->SetParameter((uint32_t)kParameters[i][0], kParameters[i][1]);
+    }
+    engine->SetParameter(kParam_ControlBlockSize, (float)controlBlockSize);
+
+    static const uint8_t kNotes[] = { 48, 55, 60, 64, 67, 71, 74, 79 };
+    std::vector<float> output(kBufferFrames * kBuffers);
+    for (int b = 0; b < kBuffers; b++) {
+        for (int i = 0; i < 8; i++) {
+            if (b == 0 && i < 4) engine->QueueMIDIEvent(0x90, kNotes[i], 100, 0);
+            if (b == 60 && i >= 4) engine->QueueMIDIEvent(0x90, kNotes[i], 80, 101);
+            if (b == kReleaseBuffer) engine->QueueMIDIEvent(0x80, kNotes[i], 0, 37);
+        }
+        float *buffer = &output[b * kBufferFrames];
+        engine->Render(buffer, buffer, kBufferFrames);
+    }
+    engine->Uninitialize();
+    delete engine;
+    return output;
+}
+
+void TestDeviationFromPerSample() {
+    std::vector<float> reference = RenderScenario(1);
+    float peak = 0.0f;
+    for (size_t i = 0; i < reference.size(); i++) {
+        peak = fmaxf(peak, fabsf(reference[i]));
+    }
+    CHECK(peak > 0.1f);
+
+    // Bounds a little above what each block size measures; the ramps keep the error to
+    // the curvature of the modulation within a block, so it grows with the block
+    static const int kBlockSizes[] = { 16, 32, 64 };
+    static const float kMaxDeviation[] = { 3e-3f, 5e-3f, 2e-2f };
+    for (int s = 0; s < 3; s++) {
+        std::vector<float> output = RenderScenario(kBlockSizes[s]);
+        float maxDiff = 0.0f;
+        for (size_t i = 0; i < output.size(); i++) {
+            maxDiff = fmaxf(maxDiff, fabsf(output[i] - reference[i]));
+        }
+        printf("  control block %2d: max |diff| %.3g (peak %.3f)\n", kBlockSizes[s], maxDiff, peak);
+        CHECK(maxDiff <= kMaxDeviation[s]);
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestDeviationFromPerSample);
+    return TestExitCode();
+}
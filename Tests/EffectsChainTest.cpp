@@ -0,0 +1,106 @@
+// EffectsChain: each effect at 44.1 and 192 kHz (where its delay lines are four times
+// longer) gives finite, bounded output from a chord, and once the input stops it goes
+// idle after GetTailFrames of silence, with its tail died away by then.
+
+#include "EffectsChain.h"
+#include "TestCheck.h"
+#include <vector>
+
+namespace {
+
+const int kBlockSize = 512;
+const char *const kEffectNames[kNumEffectTypes] = { "none", "chorus", "phaser", "flanger" };
+
+// Three detuned saws, like a held chord
+void FillChord(float *left, float *right, int frames, double sampleRate, int64_t& frame) {
+    static const double kFrequencies[] = { 220.0, 277.2, 329.6 };
+    for (int i = 0; i < frames; i++, frame++) {
+        float sample = 0.0f;
+        for (int n = 0; n < 3; n++) {
+            double phase = frame * kFrequencies[n] / sampleRate;
+            sample += 0.25f * (float)(2.0 * (phase - floor(phase)) - 1.0);
+        }
+        left[i] = sample;
+        right[i] = sample;
+    }
+}
+
+void TestEffect(int type, float intensity, double sampleRate) {
+    EffectsChain chain;
+    chain.SetSampleRate(sampleRate);
+    chain.SetType(type);
+    chain.SetRate(4.0f);
+    chain.SetIntensity(intensity);
+    CHECK(chain.IsIdle());
+
+    // Half a second of the chord
+    std::vector<float> left(kBlockSize), right(kBlockSize);
+    int64_t frame = 0;
+    bool finite = true;
+    float peak = 0.0f, maxSideDiff = 0.0f;
+    int chordBlocks = (int)(0.5 * sampleRate) / kBlockSize;
+    for (int b = 0; b < chordBlocks; b++) {
+        FillChord(&left[0], &right[0], kBlockSize, sampleRate, frame);
+        chain.Process(&left[0], &right[0], kBlockSize, kBlockSize);
+        for (int i = 0; i < kBlockSize; i++) {
+            if (!std::isfinite(left[i]) || !std::isfinite(right[i])) finite = false;
+            peak = fmaxf(peak, fmaxf(fabsf(left[i]), fabsf(right[i])));
+            maxSideDiff = fmaxf(maxSideDiff, fabsf(left[i] - right[i]));
+        }
+    }
+    CHECK(finite);
+    CHECK(peak > 0.1f);
+    CHECK(peak < 2.0f);
+    CHECK(!chain.IsIdle());
+    if (type == kEffect_Chorus || type == kEffect_Flanger) {
+        CHECK(maxSideDiff > 0.01f);  // Decorrelated taps: a mono input comes out wide
+    }
+
+    // Then silence until it goes idle. It can't before its tail is over, and notices
+    // within two blocks of the end; by then the tail is 80 dB down.
+    int tailFrames = EffectsChain::GetTailFrames(type, intensity, sampleRate);
+    int silentFrames = 0;
+    float afterTail = 0.0f;  // Peak once the tail should be over
+    while (!chain.IsIdle() && silentFrames <= tailFrames + 2 * kBlockSize) {
+        memset(&left[0], 0, kBlockSize * sizeof(float));
+        memset(&right[0], 0, kBlockSize * sizeof(float));
+        chain.Process(&left[0], &right[0], kBlockSize, 0);
+        for (int i = 0; i < kBlockSize; i++) {
+            if (!std::isfinite(left[i]) || !std::isfinite(right[i])) finite = false;
+            if (silentFrames + i >= tailFrames) {
+                afterTail = fmaxf(afterTail, fmaxf(fabsf(left[i]), fabsf(right[i])));
+            }
+        }
+        silentFrames += kBlockSize;
+    }
+    printf("  %-7s intensity %.1f at %6.0f Hz: peak %.3f, idle after %6d silent frames (tail %6d), "
+           "then %.0f dB below the peak\n", kEffectNames[type], intensity, sampleRate, peak,
+           silentFrames, tailFrames, 20.0 * log10(fmax(afterTail, 1e-12f) / peak));
+    CHECK(finite);
+    CHECK(chain.IsIdle());
+    CHECK(silentFrames > tailFrames);
+    CHECK(silentFrames <= tailFrames + 2 * kBlockSize);
+    CHECK(afterTail < 1e-4f * peak);
+
+    // Idle, silent blocks are left as they are
+    memset(&left[0], 0, kBlockSize * sizeof(float));
+    chain.Process(&left[0], &right[0], kBlockSize, 0);
+    CHECK(chain.IsIdle());
+}
+
+void TestEffects() {
+    static const double kSampleRates[] = { 44100.0, 192000.0 };
+    for (int type = kEffect_Chorus; type < kNumEffectTypes; type++) {
+        for (int r = 0; r < 2; r++) {
+            TestEffect(type, 0.5f, kSampleRates[r]);
+            TestEffect(type, 1.0f, kSampleRates[r]);
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestEffects);
+    return TestExitCode();
+}
@@ -0,0 +1,326 @@
+// The hand-offs between the threads a host calls SynthEngine from and its render thread:
+// EventQueue with several pushing threads, PresetMailbox, and the whole engine with
+// SetParameter, LoadPreset and QueueMIDIEvent hammered from their own threads while
+// Render runs. Build with -DCLAUDESYNTH_TSAN=ON to run it under ThreadSanitizer.
+
+#include "SynthEngine.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Next value of a small per-thread random sequence
+inline uint32_t NextRandom(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+struct TaggedEvent {
+    uint32_t producer;
+    uint32_t sequence;
+};
+
+// Several threads push numbered events into a small queue while one pops. Every event
+// pushed arrives exactly once, in each producer's order, and every one that didn't was
+// counted as an overflow.
+void TestEventQueueProducers() {
+    static const int kProducers = 3;
+    static const uint32_t kEventsEach = 50000;
+    typedef EventQueue<TaggedEvent, 256> Queue;
+    Queue *queue = new Queue();
+    std::atomic<int> running(kProducers);
+    uint32_t pushed[kProducers] = { 0 };
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.push_back(std::thread([&, p]() {
+            for (uint32_t i = 0; i < kEventsEach; i++) {
+                TaggedEvent event = { (uint32_t)p, i };
+                if (queue->Push(event)) pushed[p]++;
+                if ((i & 63) == 0) std::this_thread::yield();
+            }
+            running.fetch_sub(1);
+        }));
+    }
+
+    uint32_t received[kProducers] = { 0 };
+    int64_t last[kProducers];
+    for (int p = 0; p < kProducers; p++) last[p] = -1;
+    bool ordered = true, known = true;
+    TaggedEvent event;
+    while (true) {
+        bool done = (running.load() == 0);
+        while (queue->Pop(event)) {
+            if (event.producer >= (uint32_t)kProducers) {
+                known = false;
+                continue;
+            }
+            if ((int64_t)event.sequence <= last[event.producer]) ordered = false;
+            last[event.producer] = event.sequence;
+            received[event.producer]++;
+        }
+        if (done) break;
+        std::this_thread::yield();
+    }
+    for (size_t p = 0; p < producers.size(); p++) {
+        producers[p].join();
+    }
+
+    uint32_t totalPushed = 0;
+    for (int p = 0; p < kProducers; p++) {
+        CHECK(received[p] == pushed[p]);
+        totalPushed += pushed[p];
+    }
+    printf("  %u of %u events through, %u overflows\n", totalPushed, kProducers * kEventsEach,
+           queue->GetOverflowCount());
+    CHECK(known);
+    CHECK(ordered);
+    CHECK(totalPushed > 0);
+    CHECK(totalPushed + queue->GetOverflowCount() == kProducers * kEventsEach);
+    delete queue;
+}
+
+// Parameters with a 0 to 1 range, which the mailbox test fills with one value per preset
+const uint32_t kUnitParameters[] = {
+    kParam_MasterVolume, kParam_Osc1_Volume, kParam_Osc2_Volume, kParam_Osc3_Volume,
+    kParam_EnvSustain, kParam_FilterEnvSustain, kParam_EffectIntensity, kParam_StereoSpread,
+};
+const int kNumUnitParameters = sizeof(kUnitParameters) / sizeof(kUnitParameters[0]);
+
+// Preset number n: the cutoff counts presets and every unit parameter holds n's fraction
+SynthPreset MakeNumberedPreset(int n) {
+    SynthPreset preset;
+    preset.Set(kParam_FilterCutoff, 20.0f + (float)n);
+    for (int i = 0; i < kNumUnitParameters; i++) {
+        preset.Set(kUnitParameters[i], (float)(n % 256) / 256.0f);
+    }
+    return preset;
+}
+
+// One thread posts numbered presets as fast as it can while another takes them. Every
+// preset taken must be one whole preset (no values from two), and newer than the last.
+void TestPresetMailbox() {
+    static const int kPresets = 19000;
+    PresetMailbox *mailbox = new PresetMailbox();
+    std::atomic<bool> done(false);
+
+    std::thread loader([&]() {
+        for (int n = 1; n <= kPresets; n++) {
+            mailbox->Post(MakeNumberedPreset(n));
+            if ((n & 15) == 0) std::this_thread::yield();
+        }
+        done.store(true);
+    });
+
+    int taken = 0, lastNumber = 0;
+    bool torn = false, backwards = false;
+    while (true) {
+        bool finished = done.load();
+        const SynthPreset *preset = mailbox->Take();
+        if (preset) {
+            float cutoff = 0.0f;
+            preset->Get(kParam_FilterCutoff, &cutoff);
+            int n = (int)(cutoff - 20.0f);
+            if (n <= lastNumber) backwards = true;
+            lastNumber = n;
+            for (int i = 0; i < kNumUnitParameters; i++) {
+                float value = -1.0f;
+                if (!preset->Get(kUnitParameters[i], &value) || value != (float)(n % 256) / 256.0f) {
+                    torn = true;
+                }
+            }
+            taken++;
+        } else if (finished) {
+            break;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    loader.join();
+
+    printf("  %d of %d presets taken, last %d\n", taken, kPresets, lastNumber);
+    CHECK(!torn);
+    CHECK(!backwards);
+    CHECK(taken > 0);
+    CHECK(lastNumber == kPresets);  // The last one posted is never lost
+    delete mailbox;
+}
+
+// Parameters the setter thread owns; the loaded presets leave them alone
+const uint32_t kSetterParameters[] = {
+    kParam_Osc2_Volume, kParam_Osc3_Volume, kParam_FilterResonance, kParam_Osc1_Detune,
+    kParam_ModSlot1_Intensity, kParam_ModSlot2_Intensity, kParam_Saturation, kParam_RenderThreads,
+};
+const int kNumSetterParameters = sizeof(kSetterParameters) / sizeof(kSetterParameters[0]);
+
+// Two patches the loader switches between: different effects, filter modes, polyphony,
+// steal policy and control rate, so loads change the render path and not just values
+SynthPreset MakeLoadedPreset(int which) {
+    SynthPreset preset;
+    preset.Set(kParam_Osc1_Waveform, which ? 2.0f : 1.0f);
+    preset.Set(kParam_Osc2_Waveform, which ? 1.0f : 3.0f);
+    preset.Set(kParam_FilterCutoff, which ? 800.0f : 5000.0f);
+    preset.Set(kParam_FilterMode, which ? 0.0f : 1.0f);
+    preset.Set(kParam_EnvAttack, 0.002f);
+    preset.Set(kParam_EnvRelease, which ? 0.05f : 0.2f);
+    preset.Set(kParam_EffectType, which ? 1.0f : 2.0f);
+    preset.Set(kParam_Osc1_Unison, which ? 4.0f : 1.0f);
+    preset.Set(kParam_Polyphony, which ? 8.0f : 32.0f);
+    preset.Set(kParam_VoiceStealPolicy, which ? 1.0f : 3.0f);
+    preset.Set(kParam_ControlBlockSize, which ? 16.0f : 64.0f);
+    preset.Set(kParam_ModSlot1_Source, kModSource_LFO1);
+    preset.Set(kParam_ModSlot1_Dest, kModDest_FilterCutoff);
+    preset.Set(kParam_ModSlot2_Source, kModSource_Velocity);
+    preset.Set(kParam_ModSlot2_Dest, which ? kModDest_Osc2_Volume : kModDest_FilterCutoff);
+    return preset;
+}
+
+// Keeps the host threads and Render in step however slowly Render runs (under
+// ThreadSanitizer, or sharing one core): a host thread does its work for buffer n while
+// Render renders it, and Render waits for every thread's work for the buffer before,
+// so the threads really overlap and the queues never fill from one catching up
+class RenderPacer {
+public:
+    static const int kHostThreads = 3;
+
+    RenderPacer() : mRendered(0) {
+        for (int t = 0; t < kHostThreads; t++) mDone[t].store(0);
+    }
+
+    // Host thread: before its work for buffer n, and after it
+    void WaitForTurn(int n) {
+        while (mRendered.load() < n) std::this_thread::yield();
+    }
+    void Done(int thread, int n) { mDone[thread].store(n + 1); }
+
+    // Render thread: before buffer n, and after it
+    void WaitForHosts(int n) {
+        for (int t = 0; t < kHostThreads; t++) {
+            while (mDone[t].load() < n) std::this_thread::yield();
+        }
+    }
+    void Rendered(int n) { mRendered.store(n + 1); }
+
+private:
+    std::atomic<int> mRendered;
+    std::atomic<int> mDone[kHostThreads];
+};
+
+// The render thread renders while three host threads set parameters, load presets and
+// queue notes. The output must stay finite and bounded, each thread's last word must be
+// what the engine reports, and every voice must end once the notes are released.
+void TestEngineUnderLoad() {
+    static const int kBuffers = 1500;
+    static const uint32_t kFrames = 256;
+    SynthEngine *engine = new SynthEngine();
+    engine->SetSampleRate(44100.0);
+    engine->Initialize();
+    RenderPacer pacer;
+
+    // Two parameter rounds a buffer
+    float lastSet[kNumSetterParameters];
+    bool setterOK = true;
+    std::thread setter([&]() {
+        uint32_t random = 1;
+        for (int buffer = 0; buffer < kBuffers; buffer++) {
+            pacer.WaitForTurn(buffer);
+            for (int round = 0; round < 2; round++) {
+                for (int i = 0; i < kNumSetterParameters; i++) {
+                    const ParameterDescriptor& d = kParameterDescriptors[kSetterParameters[i]];
+                    float value = d.minValue + (d.maxValue - d.minValue) * (float)(NextRandom(random) % 1000) / 999.0f;
+                    if (kSetterParameters[i] == kParam_RenderThreads) value = floorf(value);
+                    if (!engine->SetParameter(kSetterParameters[i], value)) setterOK = false;
+                    lastSet[i] = value;
+                }
+            }
+            pacer.Done(0, buffer);
+        }
+    });
+
+    // A preset load every five buffers
+    int lastLoaded = 0;
+    std::thread loader([&]() {
+        SynthPreset presets[2] = { MakeLoadedPreset(0), MakeLoadedPreset(1) };
+        for (int buffer = 0; buffer < kBuffers; buffer++) {
+            pacer.WaitForTurn(buffer);
+            if (buffer % 5 == 0) {
+                lastLoaded = (buffer / 5) & 1;
+                engine->LoadPreset(presets[lastLoaded]);
+            }
+            pacer.Done(1, buffer);
+        }
+    });
+
+    // Eight note events a buffer, at random offsets
+    uint32_t dropped = 0;
+    std::thread midi([&]() {
+        uint32_t random = 2;
+        for (int buffer = 0; buffer < kBuffers; buffer++) {
+            pacer.WaitForTurn(buffer);
+            for (int i = 0; i < 8; i++) {
+                uint8_t note = (uint8_t)(36 + NextRandom(random) % 48);
+                uint32_t offset = NextRandom(random) % kFrames;
+                bool on = (NextRandom(random) & 3) != 0;
+                if (!engine->QueueMIDIEvent(on ? 0x90 : 0x80, note, on ? 100 : 0, offset)) dropped++;
+            }
+            pacer.Done(2, buffer);
+        }
+    });
+
+    std::vector<float> left(kFrames), right(kFrames);
+    float peak = 0.0f;
+    bool finite = true;
+    for (int buffer = 0; buffer < kBuffers; buffer++) {
+        pacer.WaitForHosts(buffer);
+        engine->Render(&left[0], &right[0], kFrames);
+        pacer.Rendered(buffer);
+        for (uint32_t i = 0; i < kFrames; i++) {
+            if (!std::isfinite(left[i]) || !std::isfinite(right[i])) finite = false;
+            peak = fmaxf(peak, fmaxf(fabsf(left[i]), fabsf(right[i])));
+        }
+    }
+    setter.join();
+    loader.join();
+    midi.join();
+
+    // One more render applies whatever was still waiting
+    engine->Render(&left[0], &right[0], kFrames);
+    printf("  %d buffers, peak %.3f, %u MIDI events dropped\n", kBuffers, peak, dropped);
+    CHECK(finite);
+    CHECK(peak > 0.01f && peak < 8.0f);
+    CHECK(setterOK);
+    float value = 0.0f;
+    for (int i = 0; i < kNumSetterParameters; i++) {
+        CHECK(engine->GetParameter(kSetterParameters[i], &value) && value == lastSet[i]);
+    }
+    SynthPreset loaded = MakeLoadedPreset(lastLoaded);
+    for (int id = 0; id < kNumParameterIDs; id++) {
+        float expected;
+        if (loaded.Get(id, &expected)) {
+            CHECK(engine->GetParameter(id, &value) && value == expected);
+        }
+    }
+    // In step with Render, the queue never holds more than two buffers' events
+    CHECK(dropped == 0);
+    CHECK(engine->GetParameter(kParam_MIDIQueueOverflows, &value) && value == (float)dropped);
+
+    // Nothing stuck: every voice finishes once released
+    engine->AllNotesOff();
+    for (int b = 0; b < 200; b++) {
+        engine->Render(&left[0], &right[0], kFrames);
+    }
+    CHECK(engine->GetActiveVoiceCount() == 0);
+    engine->Uninitialize();
+    delete engine;
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestEventQueueProducers);
+    RUN_TEST(TestPresetMailbox);
+    RUN_TEST(TestEngineUnderLoad);
+    return TestExitCode();
+}
@@ -0,0 +1,110 @@
+// ClaudeLogger: a full queue drops and counts records rather than blocking, the writer
+// formats what was queued and notes the drops, and calls above CLAUDESYNTH_LOG_LEVEL
+// compile to nothing. Built with logging off, whatever the build's level.
+
+#undef CLAUDESYNTH_LOG_LEVEL
+#define CLAUDESYNTH_LOG_LEVEL 0
+
+#include "ClaudeSynthLogger.h"
+#include "TestCheck.h"
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+// What a log macro expands to, as a string
+#define LOG_EXPANSION_TEXT(...) LOG_EXPANSION_QUOTE(__VA_ARGS__)
+#define LOG_EXPANSION_QUOTE(...) #__VA_ARGS__
+
+constexpr bool StartsWith(const char *text, const char *prefix) {
+    return *prefix == '\0' || (*text == *prefix && StartsWith(text + 1, prefix + 1));
+}
+
+constexpr bool Contains(const char *text, const char *word) {
+    return *text != '\0' && (StartsWith(text, word) || Contains(text + 1, word));
+}
+
+// With logging off, no call reaches the logger: each is a sizeof, generating no code
+static_assert(!Contains(LOG_EXPANSION_TEXT(ClaudeLogDebug("x %d", 1)), "ClaudeLogger"),
+              "ClaudeLogDebug must compile out at CLAUDESYNTH_LOG_OFF");
+static_assert(!Contains(LOG_EXPANSION_TEXT(ClaudeLog("x %d", 1)), "ClaudeLogger"),
+              "ClaudeLog must compile out at CLAUDESYNTH_LOG_OFF");
+static_assert(!Contains(LOG_EXPANSION_TEXT(ClaudeLogError("x %d", 1)), "ClaudeLogger"),
+              "ClaudeLogError must compile out at CLAUDESYNTH_LOG_OFF");
+static_assert(Contains(LOG_EXPANSION_TEXT(ClaudeLogDebug("x %d", 1)), "sizeof"),
+              "ClaudeLogDebug should discard its arguments inside sizeof");
+
+int gEvaluated = 0;
+
+int CountEvaluation() {
+    return ++gEvaluated;
+}
+
+// Compiled-out calls don't evaluate their arguments or queue anything
+void TestCompiledOut() {
+    uint32_t dropped = ClaudeLogger::Shared().GetDroppedCount();
+    ClaudeLogDebug("debug %d", CountEvaluation());
+    ClaudeLog("info %d", CountEvaluation());
+    ClaudeLogError("error %d", CountEvaluation());
+    CHECK(gEvaluated == 0);
+    CHECK(ClaudeLogger::Shared().GetDroppedCount() == dropped);
+}
+
+// Fills the queue with no writer running: kCapacity records fit, the rest are dropped
+// and counted. Then the writer drains them into a log that ends with the drop count.
+void TestDroppedRecords() {
+    ClaudeLogger& logger = ClaudeLogger::Shared();
+    const int kExtra = 37;
+    int accepted = 0;
+    for (int i = 0; i < ClaudeLogger::kCapacity + kExtra; i++) {
+        if (logger.Log(CLAUDESYNTH_LOG_INFO, "record %d of %u, %.2f %s", i, 99u, 0.5, "done")) {
+            accepted++;
+        }
+    }
+    CHECK(accepted == ClaudeLogger::kCapacity);
+    CHECK(logger.GetDroppedCount() == (uint32_t)kExtra);
+
+    char path[] = "/tmp/claudesynth_logger_test_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    close(fd);
+    logger.Start(path);
+
+    // Wait (up to a few seconds) for the writer to get to the drop note
+    std::string text;
+    for (int attempt = 0; attempt < 300; attempt++) {
+        usleep(10000);
+        text.clear();
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+        char buffer[4096];
+        size_t count;
+        while ((count = fread(buffer, 1, sizeof(buffer), f)) > 0) text.append(buffer, count);
+        fclose(f);
+        if (text.find("records dropped") != std::string::npos) break;
+    }
+    remove(path);
+
+    int lines = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\n') lines++;
+    }
+    printf("  %d records queued, %u dropped; log has %d lines\n", accepted, logger.GetDroppedCount(), lines);
+    CHECK(lines == ClaudeLogger::kCapacity + 1);
+    CHECK(text.find("record 0 of 99, 0.50 done\n") != std::string::npos);
+    CHECK(text.find("record 2047 of 99, 0.50 done\n") != std::string::npos);
+    CHECK(text.find("[logger] 37 records dropped (queue full)\n") != std::string::npos);
+
+    // Drained, so there's room again
+    CHECK(logger.Log(CLAUDESYNTH_LOG_INFO, "after %d", 1));
+    CHECK(logger.GetDroppedCount() == (uint32_t)kExtra);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestCompiledOut);
+    RUN_TEST(TestDroppedRecords);
+    return TestExitCode();
+}
@@ -0,0 +1,146 @@
+// ModulationMatrix: the compiled route table must modulate as walking the slots did
+// before it (the per-slot switch on source and destination it replaced), to within float
+// rounding.
+
+#include "ModulationMatrix.h"
+#include "TestCheck.h"
+#include <math.h>
+
+namespace {
+
+uint32_t NextRandom(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+float RandomFloat(uint32_t& state, float low, float high) {
+    return low + (high - low) * (float)(NextRandom(state) % 100000) / 99999.0f;
+}
+
+// The slot walk the route table replaced: every slot's source value times its
+// intensity, scaled to its destination's units. With perVoice set it takes only the
+// per-voice sources, otherwise only the global ones. With magnitudes set, sums the
+// slots' absolute amounts instead, the scale of the rounding in the sum.
+ModulationValues EvaluateSlots(const ModulationMatrix& matrix, const float *sources, bool perVoice,
+                               bool magnitudes = false) {
+    ModulationValues values;
+    memset(&values, 0, sizeof(values));
+    for (int slot = 0; slot < kNumModSlots; slot++) {
+        const ModulationMatrix::Slot& s = matrix.GetSlot(slot);
+        float sourceValue = 0.0f;
+        if (s.source > kModSource_None && s.source < kNumModSources &&
+            IsPerVoiceModSource(s.source) == perVoice) {
+            sourceValue = sources[s.source];
+        }
+        float amount = sourceValue * s.intensity;
+        if (magnitudes) amount = fabsf(amount);
+        switch (s.destination) {
+            case kModDest_FilterCutoff: values.filterCutoffMod += amount * 10000.0f; break;
+            case kModDest_FilterResonance: values.filterResonanceMod += amount * 5.0f; break;
+            case kModDest_MasterVolume: values.masterVolumeMod += amount * 0.5f; break;
+            case kModDest_Osc1_Detune: values.osc1DetuneMod += amount * 100.0f; break;
+            case kModDest_Osc1_Volume: values.osc1VolumeMod += amount * 0.5f; break;
+            case kModDest_Osc2_Detune: values.osc2DetuneMod += amount * 100.0f; break;
+            case kModDest_Osc2_Volume: values.osc2VolumeMod += amount * 0.5f; break;
+            case kModDest_Osc3_Detune: values.osc3DetuneMod += amount * 100.0f; break;
+            case kModDest_Osc3_Volume: values.osc3VolumeMod += amount * 0.5f; break;
+            default: break;
+        }
+    }
+    return values;
+}
+
+// Largest difference between the routes' values and the slot walk's, relative to the
+// sum of the magnitudes that went into each (the routes scale intensity before
+// multiplying, the slot walk after, so they round differently)
+float MaxRelativeDiff(const ModulationValues& routes, const ModulationMatrix& matrix,
+                      const float *sources, bool perVoice) {
+    ModulationValues slots = EvaluateSlots(matrix, sources, perVoice);
+    ModulationValues magnitudes = EvaluateSlots(matrix, sources, perVoice, true);
+    const float *x = (const float *)&routes;
+    const float *y = (const float *)&slots;
+    const float *scale = (const float *)&magnitudes;
+    float diff = 0.0f;
+    for (int i = 0; i < kNumModulationValues; i++) {
+        diff = fmaxf(diff, fabsf(x[i] - y[i]) / fmaxf(1e-6f, scale[i]));
+    }
+    return diff;
+}
+
+// Random matrices, including out-of-range sources and destinations, zero intensities and
+// several slots on one destination, against random source values
+void TestRoutesMatchSlots() {
+    uint32_t random = 12345;
+    float worst = 0.0f;
+    int routes = 0;
+    for (int trial = 0; trial < 2000; trial++) {
+        ModulationMatrix matrix;
+        for (int slot = 0; slot < kNumModSlots; slot++) {
+            if (NextRandom(random) % 4 == 0) continue;  // Left empty
+            matrix.SetSlotSource(slot, (int)(NextRandom(random) % (kNumModSources + 1)));
+            matrix.SetSlotDestination(slot, (int)(NextRandom(random) % (kNumModDestinations + 1)));
+            matrix.SetSlotIntensity(slot, (NextRandom(random) % 8 == 0) ? 0.0f : RandomFloat(random, -1.0f, 1.0f));
+        }
+
+        float sources[kNumModSources];
+        sources[kModSource_None] = 0.0f;
+        for (int source = 1; source < kNumModSources; source++) {
+            sources[source] = RandomFloat(random, -1.0f, 1.0f);
+            if (!IsPerVoiceModSource(source)) matrix.SetSource(source, sources[source]);
+        }
+
+        // Global routes, as SynthEngine evaluates them each control block
+        worst = fmaxf(worst, MaxRelativeDiff(matrix.Evaluate(), matrix, sources, false));
+
+        // Per-voice routes, as VoiceBank applies them with one voice's sources
+        const ModulationRouteTable& table = matrix.GetRoutes();
+        ModulationValues voiceValues;
+        memset(&voiceValues, 0, sizeof(voiceValues));
+        ApplyModulationRoutes(table.voiceRoutes, table.numVoiceRoutes, sources, voiceValues);
+        worst = fmaxf(worst, MaxRelativeDiff(voiceValues, matrix, sources, true));
+
+        // Only slots that can modulate anything become routes, each once
+        int active = 0;
+        for (int slot = 0; slot < kNumModSlots; slot++) {
+            const ModulationMatrix::Slot& s = matrix.GetSlot(slot);
+            if (s.source > kModSource_None && s.source < kNumModSources && s.destination > kModDest_None &&
+                s.destination < kNumModDestinations && s.intensity != 0.0f) {
+                active++;
+            }
+        }
+        CHECK(table.numGlobalRoutes + table.numVoiceRoutes == active);
+        for (int r = 0; r < table.numVoiceRoutes; r++) {
+            CHECK(IsPerVoiceModSource(table.voiceRoutes[r].source));
+        }
+        routes += active;
+    }
+    printf("  %d routes over 2000 matrices, max relative difference %.3g\n", routes, worst);
+    CHECK(worst < 1e-6f);
+}
+
+// Recompiling writes the other table: routes taken before a slot change are untouched
+void TestDoubleBuffered() {
+    ModulationMatrix matrix;
+    matrix.SetSlotSource(0, kModSource_LFO1);
+    matrix.SetSlotDestination(0, kModDest_FilterCutoff);
+    matrix.SetSlotIntensity(0, 0.5f);
+    const ModulationRouteTable& before = matrix.GetRoutes();
+    CHECK(before.numGlobalRoutes == 1);
+    CHECK_NEAR(before.globalRoutes[0].scale, 5000.0f, 1e-3f);
+
+    matrix.SetSlotIntensity(0, 0.25f);
+    const ModulationRouteTable& after = matrix.GetRoutes();
+    CHECK(&after != &before);
+    CHECK_NEAR(before.globalRoutes[0].scale, 5000.0f, 1e-3f);
+    CHECK_NEAR(after.globalRoutes[0].scale, 2500.0f, 1e-3f);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestRoutesMatchSlots);
+    RUN_TEST(TestDoubleBuffered);
+    return TestExitCode();
+}
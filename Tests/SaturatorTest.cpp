@@ -0,0 +1,178 @@
+// Saturator at 1x, 2x and 4x: how far below a full-drive sine its aliases are, that the
+// resampling filters pass a low-level (unclipped) signal at the shaper's own gain, and
+// that a drive ramp runs on smoothly across the 64-frame pieces it is processed in.
+
+#include "Saturator.h"
+#include "TestCheck.h"
+#include <vector>
+
+namespace {
+
+const int kSampleRate = 44100;
+const int kLength = 65536;  // One analysis period
+const int kFactors[] = { 1, 2, 4 };
+
+// Mean square of the sinusoid at frequency bin (Goertzel) in a kLength-sample period
+double BinPower(const float *samples, int bin) {
+    double coefficient = 2.0 * cos(2.0 * M_PI * bin / kLength);
+    double s1 = 0.0, s2 = 0.0;
+    for (int i = 0; i < kLength; i++) {
+        double s0 = samples[i] + coefficient * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    double power = s1 * s1 + s2 * s2 - coefficient * s1 * s2;
+    return 2.0 * power / ((double)kLength * kLength);
+}
+
+// The bin nearest frequency, made odd so no alias folds back onto a harmonic
+int FrequencyBin(double frequency) {
+    return (int)(frequency * kLength / kSampleRate) | 1;
+}
+
+// A sine exactly on bin through the saturator at a fixed drive, in blocks as SynthEngine
+// renders: two periods, returning the second, after the filters have settled
+std::vector<float> Saturate(int factor, int bin, float amplitude, float drive) {
+    std::vector<float> signal(2 * kLength);
+    for (int i = 0; i < 2 * kLength; i++) {
+        signal[i] = amplitude * (float)sin(2.0 * M_PI * bin * (double)(i % kLength) / kLength);
+    }
+    Saturator saturator;
+    saturator.SetOversampling(factor);
+    for (int offset = 0; offset < 2 * kLength; offset += 512) {
+        saturator.Process(&signal[offset], 512, drive, drive);
+    }
+    return std::vector<float>(signal.begin() + kLength, signal.end());
+}
+
+// Aliasing power below the fundamental (dB): everything that isn't on a harmonic's bin
+double AliasingDB(const std::vector<float>& output, int bin) {
+    double total = 0.0;
+    for (int i = 0; i < kLength; i++) {
+        total += (double)output[i] * output[i];
+    }
+    total /= kLength;
+    double fundamental = BinPower(&output[0], bin);
+    double harmonics = 0.0;
+    for (int h = 1; h * bin < kLength / 2; h++) {
+        harmonics += BinPower(&output[0], h * bin);
+    }
+    double aliasing = fmax(total - harmonics, fundamental * 1e-15);
+    return 10.0 * log10(aliasing / fundamental);
+}
+
+// A 0.8 sine at full drive, which clips it hard. Oversampling must push the aliases down:
+// at 1 kHz to the half-band filters' stopband (where 2x and 4x are level), at 5 kHz
+// (whose harmonics reach far past the 2x rate) further with each factor.
+void TestAliasing() {
+    static const double kFrequencies[] = { 1000.0, 5000.0 };
+    static const double kLimits[2][3] = { { -40.0, -85.0, -85.0 }, { -10.0, -28.0, -55.0 } };
+    for (int n = 0; n < 2; n++) {
+        int bin = FrequencyBin(kFrequencies[n]);
+        double previous = 0.0;
+        printf("  %4.0f Hz aliasing vs fundamental:", kFrequencies[n]);
+        for (int f = 0; f < 3; f++) {
+            double aliasing = AliasingDB(Saturate(kFactors[f], bin, 0.8f, 10.0f), bin);
+            printf("  %dx %6.1f dB", kFactors[f], aliasing);
+            CHECK(aliasing < kLimits[n][f]);
+            if (f > 0) CHECK(aliasing < previous + 1.0);
+            previous = aliasing;
+        }
+        printf("\n");
+    }
+}
+
+// Far below clipping, tanh(x * drive) / tanh(drive) is x * drive / tanh(drive): at every
+// factor and anywhere in the audio band the level out must be that, the filters adding
+// nothing (the 2x half-band is flat to 19.4 kHz)
+void TestLowLevelGain() {
+    static const double kFrequencies[] = { 100.0, 1000.0, 10000.0, 18000.0 };
+    static const float kDrives[] = { 1.0f, 4.0f };
+    const float kAmplitude = 1e-3f;
+    double worst = 0.0;
+    for (int f = 0; f < 3; f++) {
+        for (int d = 0; d < 2; d++) {
+            double expected = kAmplitude * kDrives[d] / tanh(kDrives[d]);
+            for (int n = 0; n < 4; n++) {
+                int bin = FrequencyBin(kFrequencies[n]);
+                std::vector<float> output = Saturate(kFactors[f], bin, kAmplitude, kDrives[d]);
+                double level = sqrt(2.0 * BinPower(&output[0], bin));
+                double errorDB = 20.0 * log10(level / expected);
+                worst = fmax(worst, fabs(errorDB));
+                CHECK_NEAR(errorDB, 0.0, 0.01);
+            }
+        }
+    }
+    printf("  low-level gain within %.2g dB of the shaper's at every factor\n", worst);
+}
+
+// The drive ramping from 1 to 10 over a slow sine, given to Process in one call and in
+// pieces, each ramping on from where the last one ended. Pieces of 64 frames are the
+// blocks one call is split into, so must come out the same; odd lengths only change
+// where the makeup gain is interpolated from. Either way the output must never step
+// further from one frame to the next than the shaped curve itself does, and at 1x (no
+// filter delay to line up) each step must be the curve's, so a piece boundary can't
+// add a jump.
+void TestDriveRamp() {
+    const int kFrames = 4000;
+    const float kDriveStart = 1.0f, kDriveEnd = 10.0f;
+    std::vector<float> input(kFrames), ideal(kFrames);
+    double idealStep = 0.0;
+    for (int i = 0; i < kFrames; i++) {
+        input[i] = 0.5f * (float)sin(2.0 * M_PI * 150.0 * i / kSampleRate);
+        double drive = kDriveStart + (kDriveEnd - kDriveStart) * (double)i / kFrames;
+        ideal[i] = (float)(tanh(input[i] * drive) / tanh(drive));
+        if (i > 0) idealStep = fmax(idealStep, fabs(ideal[i] - ideal[i - 1]));
+    }
+
+    static const int kBlockPieces[] = { 64 };
+    static const int kOddPieces[] = { 17, 50, 1, 64, 33 };  // Cycled through
+    for (int f = 0; f < 3; f++) {
+        Saturator whole;
+        whole.SetOversampling(kFactors[f]);
+        std::vector<float> wholeOutput(input);
+        whole.Process(&wholeOutput[0], kFrames, kDriveStart, kDriveEnd);
+
+        for (int odd = 0; odd < 2; odd++) {
+            const int *lengths = odd ? kOddPieces : kBlockPieces;
+            int numLengths = odd ? 5 : 1;
+            Saturator pieces;
+            pieces.SetOversampling(kFactors[f]);
+            std::vector<float> pieceOutput(input);
+            float driveStep = (kDriveEnd - kDriveStart) / (float)kFrames;
+            int offset = 0;
+            for (int p = 0; offset < kFrames; p++) {
+                int length = lengths[p % numLengths];
+                if (length > kFrames - offset) length = kFrames - offset;
+                pieces.Process(&pieceOutput[offset], length, kDriveStart + driveStep * (float)offset,
+                               kDriveStart + driveStep * (float)(offset + length));
+                offset += length;
+            }
+
+            double maxDiff = 0.0, maxStep = 0.0, stepError = 0.0;
+            for (int i = 0; i < kFrames; i++) {
+                maxDiff = fmax(maxDiff, fabs(wholeOutput[i] - pieceOutput[i]));
+                if (i == 0) continue;
+                double step = pieceOutput[i] - pieceOutput[i - 1];
+                maxStep = fmax(maxStep, fabs(step));
+                stepError = fmax(stepError, fabs(step - (ideal[i] - ideal[i - 1])));
+            }
+            printf("  %dx, %-8s pieces: within %.3g of one call; largest step %.4f (the curve's %.4f)",
+                   kFactors[f], odd ? "odd" : "64-frame", maxDiff, maxStep, idealStep);
+            if (kFactors[f] == 1) printf(", steps within %.2g of its", stepError);
+            printf("\n");
+            CHECK(maxDiff <= (odd ? 2e-3 : 1e-6));
+            CHECK(maxStep <= idealStep * 1.01);
+            if (kFactors[f] == 1) CHECK(stepError < 2e-4);
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestAliasing);
+    RUN_TEST(TestLowLevelGain);
+    RUN_TEST(TestDriveRamp);
+    return TestExitCode();
+}
@@ -0,0 +1,135 @@
+// ScopeRingBuffer: the oscilloscope's single-producer/single-consumer ring, on its own
+// and with a render thread pushing while a UI thread takes snapshots.
+
+#include "ScopeRingBuffer.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Pushed samples count up, wrapping well inside float's exact integers
+const uint32_t kValueMask = (1u << 20) - 1;
+
+inline float SampleValue(uint32_t position) {
+    return (float)(position & kValueMask);
+}
+
+// Pushes count counting samples starting at position
+void PushCounting(ScopeRingBuffer& ring, uint32_t position, int count) {
+    std::vector<float> samples(count);
+    for (int i = 0; i < count; i++) {
+        samples[i] = SampleValue(position + (uint32_t)i);
+    }
+    ring.Push(&samples[0], count);
+}
+
+// A snapshot of count samples ending at writePosition holds exactly the samples pushed
+// there (zero for slots not yet written)
+bool IsConsistent(const float *out, int count, uint32_t writePosition) {
+    for (int i = 0; i < count; i++) {
+        int64_t position = (int64_t)writePosition - count + i;
+        float expected = (position < 0) ? 0.0f : SampleValue((uint32_t)position);
+        if (out[i] != expected) return false;
+    }
+    return true;
+}
+
+void TestSingleThread() {
+    ScopeRingBuffer ring;
+    std::vector<float> out(ScopeRingBuffer::kCapacity);
+    uint32_t writePosition = 1;
+
+    // Nothing pushed yet: zeros, at position 0
+    CHECK(ring.Snapshot(&out[0], 16, writePosition));
+    CHECK(writePosition == 0);
+    CHECK(IsConsistent(&out[0], 16, 0));
+
+    // Partly filled, then wrapping the end of the ring
+    PushCounting(ring, 0, 100);
+    CHECK(ring.Snapshot(&out[0], 200, writePosition));
+    CHECK(writePosition == 100);
+    CHECK(IsConsistent(&out[0], 200, 100));
+    uint32_t position = 100;
+    while (position < 3 * ScopeRingBuffer::kCapacity + 17) {
+        PushCounting(ring, position, 333);
+        position += 333;
+    }
+    CHECK(ring.Snapshot(&out[0], ScopeRingBuffer::kCapacity, writePosition));
+    CHECK(writePosition == position);
+    CHECK(IsConsistent(&out[0], ScopeRingBuffer::kCapacity, position));
+
+    // A push longer than the ring keeps only its newest samples
+    PushCounting(ring, position, ScopeRingBuffer::kCapacity + 500);
+    position += ScopeRingBuffer::kCapacity + 500;
+    CHECK(ring.Snapshot(&out[0], ScopeRingBuffer::kCapacity, writePosition));
+    CHECK(writePosition == position);
+    CHECK(IsConsistent(&out[0], ScopeRingBuffer::kCapacity, position));
+}
+
+// The render thread pushes counting samples in host-sized buffers while the UI thread
+// snapshots as fast as it can, until both have done plenty (on one core they only
+// interleave when the scheduler switches them). Every snapshot that reports success must
+// be a clean run of the samples pushed up to its write position: never torn by a push.
+void TestConcurrentPushAndSnapshot() {
+    const uint32_t kMinSamples = 4000000;
+    const int kMinSnapshots = 20000;
+    const uint32_t kMaxSamples = 400000000;  // Gives up if snapshots never succeed
+    ScopeRingBuffer ring;
+    std::atomic<int> snapshotCount(0);
+    std::atomic<bool> done(false);
+
+    std::thread producer([&]() {
+        static const int kBufferSizes[] = { 64, 128, 511, 1024, 37, 4096 };
+        std::vector<float> samples(4096);
+        uint32_t position = 0;
+        for (int buffer = 0; (position < kMinSamples || snapshotCount.load() < kMinSnapshots) &&
+                                    position < kMaxSamples; buffer++) {
+            int count = kBufferSizes[buffer % 6];
+            for (int i = 0; i < count; i++) {
+                samples[i] = SampleValue(position + (uint32_t)i);
+            }
+            ring.Push(&samples[0], count);
+            position += (uint32_t)count;
+        }
+        done.store(true);
+    });
+
+    std::vector<float> out(ScopeRingBuffer::kCapacity);
+    int snapshots = 0, torn = 0, skipped = 0;
+    uint32_t lastPosition = 0;
+    bool backwards = false;
+    while (!done.load()) {
+        int count = 256 << (snapshots % 5);  // 256 to 4096
+        uint32_t writePosition;
+        if (!ring.Snapshot(&out[0], count, writePosition)) {
+            skipped++;
+            continue;
+        }
+        if (!IsConsistent(&out[0], count, writePosition)) torn++;
+        if (writePosition < lastPosition) backwards = true;
+        lastPosition = writePosition;
+        snapshots++;
+        snapshotCount.store(snapshots);
+    }
+    producer.join();
+
+    printf("  %d snapshots, %d skipped after racing pushes\n", snapshots, skipped);
+    CHECK(torn == 0);
+    CHECK(!backwards);
+    CHECK(snapshots >= kMinSnapshots);
+
+    uint32_t writePosition;
+    CHECK(ring.Snapshot(&out[0], ScopeRingBuffer::kCapacity, writePosition));
+    CHECK(writePosition >= kMinSamples);
+    CHECK(IsConsistent(&out[0], ScopeRingBuffer::kCapacity, writePosition));
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestSingleThread);
+    RUN_TEST(TestConcurrentPushAndSnapshot);
+    return TestExitCode();
+}
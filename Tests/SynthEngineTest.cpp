@@ -0,0 +1,181 @@
+// SynthEngine end to end: notes in through the MIDI queue, stereo out of Render.
+// A voice panned hard to one side stays silent in the other channel, through the
+// chorus and flanger too (each channel has its own delay lines). A queued parameter
+// change starts on its frame, gliding from there. After the last note off, Render
+// reports silence within the tail the engine tells the host about.
+
+#include "SynthEngine.h"
+#include "TestCheck.h"
+#include <vector>
+
+namespace {
+
+const double kSampleRate = 48000.0;
+const uint32_t kBufferFrames = 512;
+
+SynthEngine *MakeEngine() {
+    SynthEngine *engine = new SynthEngine();
+    engine->SetSampleRate(kSampleRate);
+    engine->Initialize();
+    return engine;
+}
+
+void DeleteEngine(SynthEngine *engine) {
+    engine->Uninitialize();
+    delete engine;
+}
+
+// Note 12 and note 108 are four octaves from middle C, the edges at full spread: each
+// plays into one channel only, unison copies and all
+void TestHardPan() {
+    static const int kNotes[] = { 12, 108 };
+    static const int kEffects[] = { kEffect_None, kEffect_Chorus, kEffect_Flanger };
+    for (int n = 0; n < 2; n++) {
+        for (int e = 0; e < 3; e++) {
+            SynthEngine *engine = MakeEngine();
+            engine->SetParameter(kParam_StereoSpread, 1.0f);
+            engine->SetParameter(kParam_EffectType, (float)kEffects[e]);
+            engine->SetParameter(kParam_EffectIntensity, 1.0f);
+            engine->SetParameter(kParam_Osc1_Unison, 3.0f);
+            engine->SetParameter(kParam_Osc1_UnisonDetune, 20.0f);
+            engine->QueueMIDIEvent(0x90, (uint8_t)kNotes[n], 100, 0);
+
+            std::vector<float> left(kBufferFrames), right(kBufferFrames);
+            float leftPeak = 0.0f, rightPeak = 0.0f;
+            for (int b = 0; b < 200; b++) {
+                if (b == 100) engine->QueueMIDIEvent(0x80, (uint8_t)kNotes[n], 0, 0);
+                engine->Render(&left[0], &right[0], kBufferFrames);
+                for (uint32_t i = 0; i < kBufferFrames; i++) {
+                    leftPeak = fmaxf(leftPeak, fabsf(left[i]));
+                    rightPeak = fmaxf(rightPeak, fabsf(right[i]));
+                }
+            }
+            printf("  note %3d, effect %d: left peak %.3g, right peak %.3g\n", kNotes[n], kEffects[e],
+                   leftPeak, rightPeak);
+            float playing = (kNotes[n] < 60) ? leftPeak : rightPeak;
+            float silent = (kNotes[n] < 60) ? rightPeak : leftPeak;
+            CHECK(playing > 0.05f);
+            CHECK(silent == 0.0f);
+            DeleteEngine(engine);
+        }
+    }
+}
+
+// Master volume from 0.8 to 0 at offset in the second buffer, queued as an event (a
+// glide over kParameterSmoothingTime, 480 frames here) or as a ramp of rampFrames,
+// against the same notes rendered without it. Master volume scales the output, so up to
+// the offset the two match and from it the ratio between them follows the ramp.
+void CheckVolumeChange(uint32_t offset, uint32_t rampFrames) {
+    const float kVolume = 0.8f;
+    const uint32_t glideFrames = (rampFrames > 0) ? rampFrames : (uint32_t)(0.01 * kSampleRate + 0.5);
+    SynthEngine *changed = MakeEngine();
+    SynthEngine *reference = MakeEngine();
+    SynthEngine *engines[2] = { changed, reference };
+    for (int e = 0; e < 2; e++) {
+        engines[e]->SetParameter(kParam_MasterVolume, kVolume);
+        engines[e]->QueueMIDIEvent(0x90, 48, 100, 0);
+        engines[e]->QueueMIDIEvent(0x90, 55, 100, 0);
+    }
+
+    const int kBuffers = 4;
+    std::vector<float> changedOut, referenceOut;
+    std::vector<float> left(kBufferFrames), right(kBufferFrames);
+    for (int b = 0; b < kBuffers; b++) {
+        if (b == 1) {
+            bool queued = (rampFrames > 0) ?
+                          changed->QueueParameterRamp(kParam_MasterVolume, kVolume, 0.0f, offset, rampFrames) :
+                          changed->QueueParameterEvent(kParam_MasterVolume, 0.0f, offset);
+            CHECK(queued);
+        }
+        changed->Render(&left[0], &right[0], kBufferFrames);
+        changedOut.insert(changedOut.end(), left.begin(), left.end());
+        reference->Render(&left[0], &right[0], kBufferFrames);
+        referenceOut.insert(referenceOut.end(), left.begin(), left.end());
+    }
+
+    size_t eventFrame = kBufferFrames + offset;
+    float peak = 0.0f, before = 0.0f, during = 0.0f, after = 0.0f;
+    for (size_t i = 0; i < changedOut.size(); i++) {
+        peak = fmaxf(peak, fabsf(referenceOut[i]));
+        if (i < eventFrame) {
+            before = fmaxf(before, fabsf(changedOut[i] - referenceOut[i]));
+        } else if (i < eventFrame + glideFrames) {
+            float gain = 1.0f - (float)(i - eventFrame) / (float)glideFrames;
+            during = fmaxf(during, fabsf(changedOut[i] - gain * referenceOut[i]));
+        } else {
+            after = fmaxf(after, fabsf(changedOut[i]));
+        }
+    }
+    printf("  change at frame %u, %4u frame %s: max |diff| %.3g before, %.3g from the ramp, "
+           "%.3g after (peak %.3f)\n", offset, glideFrames, (rampFrames > 0) ? "ramp " : "glide",
+           before, during, after, peak);
+    CHECK(peak > 0.1f);
+    CHECK(before <= 1e-5f * peak);
+    CHECK(during <= 1e-6f * peak);
+    CHECK(after == 0.0f);
+
+    // The first changed frame is the offset's, not the buffer's or its control block's
+    CHECK(changedOut[eventFrame - 1] == referenceOut[eventFrame - 1]);
+    CHECK(fabsf(changedOut[eventFrame + 8]) < fabsf(referenceOut[eventFrame + 8]) ||
+          referenceOut[eventFrame + 8] == 0.0f);
+
+    float value = -1.0f;
+    CHECK(changed->GetParameter(kParam_MasterVolume, &value) && value == 0.0f);
+    DeleteEngine(changed);
+    DeleteEngine(reference);
+}
+
+void TestQueuedParameterOffset() {
+    CheckVolumeChange(300, 0);
+    CheckVolumeChange(37, 0);
+    CheckVolumeChange(300, 1000);
+}
+
+// A chord released, then rendered until Render reports a silent buffer: that must
+// come within GetTailTime of the note off (plus the buffer that notices), for every
+// effect and a short and a long release
+void TestSilentWithinTailTime() {
+    static const float kReleases[] = { 0.05f, 1.5f };
+    for (int effect = kEffect_None; effect < kNumEffectTypes; effect++) {
+        for (int r = 0; r < 2; r++) {
+            SynthEngine *engine = MakeEngine();
+            engine->SetParameter(kParam_EnvRelease, kReleases[r]);
+            engine->SetParameter(kParam_EffectType, (float)effect);
+            engine->SetParameter(kParam_EffectIntensity, 1.0f);
+            std::vector<float> left(kBufferFrames), right(kBufferFrames);
+            static const uint8_t kChord[] = { 48, 52, 55 };
+            for (int n = 0; n < 3; n++) engine->QueueMIDIEvent(0x90, kChord[n], 100, 0);
+            bool silentWhilePlaying = false;
+            for (int b = 0; b < 20; b++) {
+                if (engine->Render(&left[0], &right[0], kBufferFrames)) silentWhilePlaying = true;
+            }
+
+            const uint32_t kOffset = 100;
+            for (int n = 0; n < 3; n++) engine->QueueMIDIEvent(0x80, kChord[n], 0, kOffset);
+            double tailFrames = engine->GetTailTime() * kSampleRate;
+            uint32_t framesAfterRelease = 0;
+            bool silent = false;
+            while (!silent && framesAfterRelease <= tailFrames + 2 * kBufferFrames) {
+                silent = engine->Render(&left[0], &right[0], kBufferFrames);
+                framesAfterRelease += kBufferFrames;
+            }
+            framesAfterRelease -= kOffset + kBufferFrames;  // Up to the start of the silent buffer
+            printf("  effect %d, release %.2fs: silent %u frames after the note off (tail %.0f)\n",
+                   effect, kReleases[r], framesAfterRelease, tailFrames);
+            CHECK(!silentWhilePlaying);
+            CHECK(silent);
+            CHECK(framesAfterRelease <= tailFrames + kBufferFrames);
+            CHECK(engine->GetActiveVoiceCount() == 0);
+            DeleteEngine(engine);
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestHardPan);
+    RUN_TEST(TestQueuedParameterOffset);
+    RUN_TEST(TestSilentWithinTailTime);
+    return TestExitCode();
+}
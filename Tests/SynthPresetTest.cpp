@@ -0,0 +1,236 @@
+// SynthPreset, the format the Audio Unit saves its state in (ClassInfo) and reads back in
+// RestoreClassInfo: binary and text round trips of every saved parameter, and rejection
+// of anything that isn't a preset this build can read.
+
+#include "SynthPreset.h"
+#include "SynthEngine.h"
+#include "TestCheck.h"
+#include <math.h>
+
+namespace {
+
+// A value inside every saved parameter's range, different for each parameter and not
+// a round number (whole numbers for indexed and boolean parameters)
+SynthPreset MakeFullPreset() {
+    SynthPreset preset;
+    for (int id = 0; id < kNumParameterIDs; id++) {
+        const ParameterDescriptor& d = kParameterDescriptors[id];
+        if (d.readOnly) continue;
+        float fraction = fmodf(0.1f + 0.377f * id, 1.0f);
+        float value = d.minValue + (d.maxValue - d.minValue) * fraction;
+        if (d.unit == kParameterUnit_Indexed || d.unit == kParameterUnit_Boolean) {
+            value = floorf(value + 0.5f);
+        }
+        CHECK(preset.Set(id, value));
+    }
+    return preset;
+}
+
+int SavedParameterCount() {
+    int count = 0;
+    for (int id = 0; id < kNumParameterIDs; id++) {
+        if (!kParameterDescriptors[id].readOnly) count++;
+    }
+    return count;
+}
+
+// A binary preset of raw (ID, value) entries, with the given header fields
+std::vector<uint8_t> MakeBlob(const char *magic, uint16_t version, uint16_t count,
+                              const uint16_t *ids, const float *values, int entries) {
+    std::vector<uint8_t> data(SynthPreset::kHeaderSize + SynthPreset::kEntrySize * entries);
+    memcpy(&data[0], magic, 4);
+    data[4] = (uint8_t)version;
+    data[5] = (uint8_t)(version >> 8);
+    data[6] = (uint8_t)count;
+    data[7] = (uint8_t)(count >> 8);
+    for (int i = 0; i < entries; i++) {
+        uint8_t *entry = &data[SynthPreset::kHeaderSize + SynthPreset::kEntrySize * i];
+        uint32_t bits;
+        memcpy(&bits, &values[i], sizeof(bits));
+        entry[0] = (uint8_t)ids[i];
+        entry[1] = (uint8_t)(ids[i] >> 8);
+        for (int b = 0; b < 4; b++) {
+            entry[2 + b] = (uint8_t)(bits >> (8 * b));
+        }
+    }
+    return data;
+}
+
+void TestBinaryRoundTrip() {
+    SynthPreset preset = MakeFullPreset();
+    CHECK(preset.GetCount() == SavedParameterCount());
+
+    std::vector<uint8_t> data;
+    preset.WriteBinary(data);
+    CHECK(data.size() == SynthPreset::kHeaderSize + SynthPreset::kEntrySize * preset.GetCount());
+    CHECK(memcmp(&data[0], "CSyP", 4) == 0);
+    CHECK(data[4] == SynthPreset::kVersion && data[5] == 0);
+
+    SynthPreset loaded;
+    CHECK(loaded.ReadBinary(&data[0], data.size()));
+    CHECK(loaded == preset);
+
+    // Extremes and negative zero come back bit for bit
+    SynthPreset edges;
+    edges.Set(kParam_FilterCutoff, kParameterDescriptors[kParam_FilterCutoff].maxValue);
+    edges.Set(kParam_Osc1_Detune, -0.0f);
+    edges.Set(kParam_Osc2_Octave, kParameterDescriptors[kParam_Osc2_Octave].minValue);
+    edges.WriteBinary(data);
+    CHECK(loaded.ReadBinary(&data[0], data.size()));
+    CHECK(loaded == edges);
+    float value = 1.0f;
+    CHECK(loaded.Get(kParam_Osc1_Detune, &value) && signbit(value));
+
+    // An empty preset is valid
+    SynthPreset empty;
+    empty.WriteBinary(data);
+    CHECK(data.size() == SynthPreset::kHeaderSize);
+    CHECK(loaded.ReadBinary(&data[0], data.size()));
+    CHECK(loaded.GetCount() == 0);
+}
+
+void TestTextRoundTrip() {
+    SynthPreset preset = MakeFullPreset();
+    std::string text;
+    preset.WriteText(text);
+    SynthPreset loaded;
+    CHECK(loaded.ReadText(text.c_str(), text.size()));
+    CHECK(loaded == preset);
+
+    // Comments, blank lines, CRLF and "<id>=<value>" are all accepted
+    const char *kText = "# comment\r\n\r\n  13 1500.5 # cutoff\r\n14=2\n\t\n1 2";
+    CHECK(loaded.ReadText(kText, strlen(kText)));
+    CHECK(loaded.GetCount() == 3);
+    float value = 0.0f;
+    CHECK(loaded.Get(kParam_FilterCutoff, &value) && value == 1500.5f);
+    CHECK(loaded.Get(kParam_FilterResonance, &value) && value == 2.0f);
+    CHECK(loaded.Get(kParam_Osc1_Waveform, &value) && value == 2.0f);
+}
+
+void TestRejectsBadHeader() {
+    uint16_t ids[] = { kParam_FilterCutoff };
+    float values[] = { 1000.0f };
+    SynthPreset preset = MakeFullPreset();
+
+    std::vector<uint8_t> good = MakeBlob("CSyP", SynthPreset::kVersion, 1, ids, values, 1);
+    CHECK(preset.ReadBinary(&good[0], good.size()));
+    CHECK(preset.GetCount() == 1);
+
+    // Wrong magic, a version of 0 or newer than this build's: rejected and left empty
+    std::vector<uint8_t> magic = MakeBlob("CSyQ", SynthPreset::kVersion, 1, ids, values, 1);
+    std::vector<uint8_t> zero = MakeBlob("CSyP", 0, 1, ids, values, 1);
+    std::vector<uint8_t> newer = MakeBlob("CSyP", SynthPreset::kVersion + 1, 1, ids, values, 1);
+    CHECK(!preset.ReadBinary(&magic[0], magic.size()));
+    CHECK(preset.GetCount() == 0);
+    preset = MakeFullPreset();
+    CHECK(!preset.ReadBinary(&zero[0], zero.size()));
+    CHECK(preset.GetCount() == 0);
+    CHECK(!preset.ReadBinary(&newer[0], newer.size()));
+
+    // Text that isn't a preset
+    const char *kBad[] = { "13", "13 abc", "x 1", "13 1000 7", "-1 5", "plist" };
+    for (size_t i = 0; i < sizeof(kBad) / sizeof(kBad[0]); i++) {
+        preset = MakeFullPreset();
+        CHECK(!preset.ReadText(kBad[i], strlen(kBad[i])));
+        CHECK(preset.GetCount() == 0);
+    }
+}
+
+void TestRejectsTruncated() {
+    SynthPreset preset = MakeFullPreset();
+    std::vector<uint8_t> data;
+    preset.WriteBinary(data);
+
+    // Cut anywhere short of the last entry, including inside the header
+    SynthPreset loaded;
+    bool anyAccepted = false;
+    for (size_t size = 0; size < data.size(); size++) {
+        if (loaded.ReadBinary(&data[0], size)) anyAccepted = true;
+        if (loaded.GetCount() != 0) anyAccepted = true;
+    }
+    CHECK(!anyAccepted);
+
+    // A count larger than the entries that follow
+    uint16_t ids[] = { kParam_FilterCutoff, kParam_FilterResonance };
+    float values[] = { 1000.0f, 2.0f };
+    std::vector<uint8_t> overCount = MakeBlob("CSyP", SynthPreset::kVersion, 3, ids, values, 2);
+    CHECK(!loaded.ReadBinary(&overCount[0], overCount.size()));
+}
+
+void TestSkipsUnknownIDs() {
+    // Unknown and read-only IDs are skipped; the rest still load
+    uint16_t ids[] = { kParam_FilterCutoff, (uint16_t)kNumParameterIDs, 0xFFFF,
+                       kParam_LFO1_Output, kParam_MIDIQueueOverflows, kParam_FilterResonance };
+    float values[] = { 1000.0f, 1.0f, 1.0f, 0.5f, 3.0f, 2.0f };
+    std::vector<uint8_t> data = MakeBlob("CSyP", SynthPreset::kVersion, 6, ids, values, 6);
+    SynthPreset preset;
+    CHECK(preset.ReadBinary(&data[0], data.size()));
+    CHECK(preset.GetCount() == 2);
+    float value = 0.0f;
+    CHECK(preset.Get(kParam_FilterCutoff, &value) && value == 1000.0f);
+    CHECK(preset.Get(kParam_FilterResonance, &value) && value == 2.0f);
+    CHECK(!preset.Get(kParam_LFO1_Output, &value));
+    CHECK(!preset.Get(kNumParameterIDs, &value));
+
+    char text[128];
+    snprintf(text, sizeof(text), "13 1000\n%d 1\n%d 0.5\n14 2\n", kNumParameterIDs, kParam_LFO1_Output);
+    CHECK(preset.ReadText(text, strlen(text)));
+    CHECK(preset.GetCount() == 2);
+
+    // Set and Get refuse them too
+    CHECK(!preset.Set(kNumParameterIDs, 1.0f));
+    CHECK(!preset.Set(kParam_LFO2_Output, 1.0f));
+}
+
+void TestClampsOutOfRange() {
+    const ParameterDescriptor& cutoff = kParameterDescriptors[kParam_FilterCutoff];
+    const ParameterDescriptor& octave = kParameterDescriptors[kParam_Osc1_Octave];
+    const ParameterDescriptor& volume = kParameterDescriptors[kParam_MasterVolume];
+    const ParameterDescriptor& detune = kParameterDescriptors[kParam_Osc1_Detune];
+    uint16_t ids[] = { kParam_FilterCutoff, kParam_Osc1_Octave, kParam_MasterVolume, kParam_Osc1_Detune };
+    float values[] = { 1e9f, -7.0f, NAN, -INFINITY };
+    std::vector<uint8_t> data = MakeBlob("CSyP", SynthPreset::kVersion, 4, ids, values, 4);
+
+    // Beyond either end takes the end, and a NaN the maximum
+    SynthPreset preset;
+    CHECK(preset.ReadBinary(&data[0], data.size()));
+    float value = 0.0f;
+    CHECK(preset.Get(kParam_FilterCutoff, &value) && value == cutoff.maxValue);
+    CHECK(preset.Get(kParam_Osc1_Octave, &value) && value == octave.minValue);
+    CHECK(preset.Get(kParam_MasterVolume, &value) && value == volume.maxValue);
+    CHECK(preset.Get(kParam_Osc1_Detune, &value) && value == detune.minValue);
+
+    const char *kText = "13 1e9\n2 -7\n0 nan\n3 -inf\n";
+    SynthPreset fromText;
+    CHECK(fromText.ReadText(kText, strlen(kText)));
+    CHECK(fromText == preset);
+}
+
+// What RestoreClassInfo does with a parsed preset: the engine then reports every value
+void TestEngineRoundTrip() {
+    SynthPreset preset = MakeFullPreset();
+    std::vector<uint8_t> data;
+    preset.WriteBinary(data);
+    SynthPreset loaded;
+    CHECK(loaded.ReadBinary(&data[0], data.size()));
+
+    SynthEngine *engine = new SynthEngine();
+    engine->SetPreset(loaded);
+    SynthPreset saved;
+    engine->GetPreset(&saved);
+    CHECK(saved == preset);
+    delete engine;
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestBinaryRoundTrip);
+    RUN_TEST(TestTextRoundTrip);
+    RUN_TEST(TestRejectsBadHeader);
+    RUN_TEST(TestRejectsTruncated);
+    RUN_TEST(TestSkipsUnknownIDs);
+    RUN_TEST(TestClampsOutOfRange);
+    RUN_TEST(TestEngineRoundTrip);
+    return TestExitCode();
+}
@@ -0,0 +1,171 @@
+// Headless test of the voice building blocks in SynthVoice.h: ADSREnvelope rendered a
+// block at a time must match the per-sample envelope it replaced, for any block size.
+
+#include "SynthVoice.h"
+#include "TestCheck.h"
+#include <vector>
+
+namespace {
+
+const double kSampleRate = 44100.0;
+
+// The envelope as SynthVoice::RenderSample stepped it before block rendering: one
+// update per frame, emitting the level after the update
+struct PerSampleEnvelope {
+    float level;
+    EnvelopeStage stage;
+    float releaseStartLevel;
+
+    PerSampleEnvelope() : level(0.0f), stage(kEnvStage_Idle), releaseStartLevel(0.0f) {}
+
+    void Release() {
+        stage = kEnvStage_Release;
+        releaseStartLevel = level;
+    }
+
+    float Step(const ADSRSettings& s) {
+        switch (stage) {
+            case kEnvStage_Idle:
+                level = 0.0f;
+                break;
+            case kEnvStage_Attack:
+                if (s.attack > 0.0001f) {
+                    level += 1.0f / (s.attack * kSampleRate);
+                    if (level >= 1.0f) {
+                        level = 1.0f;
+                        stage = kEnvStage_Decay;
+                    }
+                } else {
+                    level = 1.0f;
+                    stage = kEnvStage_Decay;
+                }
+                break;
+            case kEnvStage_Decay:
+                if (s.decay > 0.0001f) {
+                    level -= (1.0f - s.sustain) / (s.decay * kSampleRate);
+                    if (level <= s.sustain) {
+                        level = s.sustain;
+                        stage = kEnvStage_Sustain;
+                    }
+                } else {
+                    level = s.sustain;
+                    stage = kEnvStage_Sustain;
+                }
+                break;
+            case kEnvStage_Sustain:
+                level = s.sustain;
+                break;
+            case kEnvStage_Release:
+                if (s.release > 0.0001f) {
+                    level -= releaseStartLevel / (s.release * kSampleRate);
+                    if (level <= 0.0f) {
+                        level = 0.0f;
+                        stage = kEnvStage_Idle;
+                    }
+                } else {
+                    level = 0.0f;
+                    stage = kEnvStage_Idle;
+                }
+                break;
+        }
+        return level;
+    }
+};
+
+// Plays a note through both envelopes, released at releaseFrame, rendering the block
+// envelope blockSize frames at a time, and compares them frame by frame until both end
+void CompareWithPerSample(const ADSRSettings& settings, int releaseFrame, int blockSize) {
+    ADSREnvelope envelope;
+    envelope.Reset();
+    envelope.stage = kEnvStage_Attack;
+    PerSampleEnvelope reference;
+    reference.stage = kEnvStage_Attack;
+
+    const int kMaxFrames = (int)(kSampleRate * 4.0);
+    std::vector<float> block(blockSize);
+    float maxDiff = 0.0f;
+    int frame = 0;
+    bool finished = false;
+    while (!finished && frame < kMaxFrames) {
+        // Blocks split at the release, as VoiceBank splits them at note-off events
+        int n = blockSize;
+        if (frame < releaseFrame && frame + n > releaseFrame) n = releaseFrame - frame;
+        if (frame == releaseFrame) {
+            envelope.Release();
+            reference.Release();
+        }
+        int rendered = envelope.Render(&block[0], n, settings, kSampleRate);
+        for (int i = 0; i < rendered; i++) {
+            maxDiff = fmaxf(maxDiff, fabsf(block[i] - reference.Step(settings)));
+        }
+        if (rendered < n) {
+            // The block envelope ended: so must the reference, on the same frame
+            CHECK(reference.stage == kEnvStage_Idle);
+            CHECK(envelope.stage == kEnvStage_Idle);
+            finished = true;
+        }
+        frame += rendered;
+    }
+    CHECK(finished);
+    CHECK(maxDiff <= 1e-6f);
+}
+
+void TestBlockMatchesPerSample() {
+    static const ADSRSettings kSettings[] = {
+        { 0.01f, 0.1f, 0.7f, 0.3f },     // The default
+        { 0.0f, 0.0f, 0.5f, 0.0f },      // Every stage instant
+        { 0.5f, 0.2f, 0.0f, 0.05f },     // Released during the attack, zero sustain
+        { 0.001f, 1.0f, 1.0f, 2.0f },    // Sustain at full level
+    };
+    static const int kBlockSizes[] = { 1, 7, 16, 64 };
+    for (size_t s = 0; s < sizeof(kSettings) / sizeof(kSettings[0]); s++) {
+        for (size_t b = 0; b < sizeof(kBlockSizes) / sizeof(kBlockSizes[0]); b++) {
+            CompareWithPerSample(kSettings[s], 2205, kBlockSizes[b]);
+            CompareWithPerSample(kSettings[s], 30000, kBlockSizes[b]);
+        }
+    }
+}
+
+void TestStageTiming() {
+    ADSRSettings settings = { 0.01f, 0.1f, 0.5f, 0.2f };
+    ADSREnvelope envelope;
+    envelope.Reset();
+    envelope.stage = kEnvStage_Attack;
+
+    // Attack reaches full level after attack * sampleRate frames
+    std::vector<float> out(kMaxVoiceBlockSize);
+    int frames = 0;
+    while (envelope.stage == kEnvStage_Attack) {
+        envelope.Render(&out[0], 1, settings, kSampleRate);
+        frames++;
+    }
+    CHECK_NEAR(frames, 0.01 * kSampleRate, 1.0);
+    CHECK(envelope.level == 1.0f);
+
+    // Then decays to the sustain level and holds it
+    for (int i = 0; i < 100; i++) {
+        envelope.Render(&out[0], kMaxVoiceBlockSize, settings, kSampleRate);
+    }
+    CHECK(envelope.stage == kEnvStage_Sustain);
+    CHECK(out[kMaxVoiceBlockSize - 1] == 0.5f);
+
+    // A fade overrides the release time, and Render reports where it ended
+    envelope.Fade(0.001f);
+    int total = 0, rendered;
+    do {
+        rendered = envelope.Render(&out[0], kMaxVoiceBlockSize, settings, kSampleRate);
+        total += rendered;
+    } while (rendered == kMaxVoiceBlockSize);
+    CHECK_NEAR(total, 0.001 * kSampleRate, 1.0);
+    CHECK(out[rendered - 1] == 0.0f);
+    CHECK(envelope.stage == kEnvStage_Idle);
+    CHECK(envelope.Render(&out[0], kMaxVoiceBlockSize, settings, kSampleRate) == 0);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestBlockMatchesPerSample);
+    RUN_TEST(TestStageTiming);
+    return TestExitCode();
+}
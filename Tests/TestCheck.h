@@ -0,0 +1,48 @@
+#ifndef __TestCheck_h__
+#define __TestCheck_h__
+
+#include <math.h>
+#include <stdio.h>
+
+// Checks for the headless tests. Each test is a program run by ctest: a failed check
+// prints where and why and the run goes on, and main returns TestExitCode() so ctest
+// sees the failure. Unlike assert, checks stay on in Release builds.
+
+static int gTestFailures = 0;
+
+#define CHECK(condition)                                                               \
+    do {                                                                               \
+        if (!(condition)) {                                                            \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            gTestFailures++;                                                           \
+        }                                                                              \
+    } while (0)
+
+// |actual - expected| <= tolerance (and neither is NaN)
+#define CHECK_NEAR(actual, expected, tolerance)                                        \
+    do {                                                                               \
+        double checkActual = (double)(actual), checkExpected = (double)(expected);     \
+        if (!(fabs(checkActual - checkExpected) <= (double)(tolerance))) {             \
+            fprintf(stderr, "%s:%d: CHECK_NEAR failed: %s = %.9g, expected %.9g +/- %.3g\n", \
+                    __FILE__, __LINE__, #actual, checkActual, checkExpected, (double)(tolerance)); \
+            gTestFailures++;                                                           \
+        }                                                                              \
+    } while (0)
+
+// Runs one test function, reporting its name and whether it added failures
+#define RUN_TEST(test)                                                                 \
+    do {                                                                               \
+        int failuresBefore = gTestFailures;                                            \
+        test();                                                                        \
+        printf("%s %s\n", (gTestFailures == failuresBefore) ? "PASS" : "FAIL", #test); \
+    } while (0)
+
+static inline int TestExitCode() {
+    if (gTestFailures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", gTestFailures);
+        return 1;
+    }
+    return 0;
+}
+
+#endif
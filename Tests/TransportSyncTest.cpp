@@ -0,0 +1,216 @@
+// Tempo sync: tempo-synced LFOs and the arpeggiator driven by a fake host transport
+// through tempo changes, loop jumps and stop/start. While the host plays they must stay
+// locked to its beat, picking it up again on the first buffer after every jump.
+
+#include "LFO.h"
+#include "Arpeggiator.h"
+#include "TestCheck.h"
+#include <vector>
+
+namespace {
+
+const double kSampleRate = 48000.0;
+const int kBufferFrames = 512;
+const int kControlBlockSize = 64;
+const int kBuffers = 1200;
+
+// A host's transport as an Audio Unit sees it: tempo, the beat at the start of each
+// buffer and whether it is playing. Jumps (tempo changes, loops, relocating) happen
+// between buffers.
+class FakeHost {
+public:
+    FakeHost() : mTempo(120.0), mBeat(0.0), mPlaying(false), mJumped(true),
+                 mLoopStart(0.0), mLoopEnd(0.0) {}
+
+    double GetTempo() const { return mTempo; }
+    double GetBeat() const { return mBeat; }
+    bool IsPlaying() const { return mPlaying; }
+
+    // True on the first buffer after the beat moved other than by playing on
+    bool Jumped() const { return mJumped; }
+
+    // The beat at a frame of the current buffer
+    double BeatAt(double frame) const {
+        return mPlaying ? mBeat + frame * mTempo / (60.0 * kSampleRate) : mBeat;
+    }
+
+    void SetTempo(double tempo) { mTempo = tempo; }
+    void Play() { mPlaying = true; mJumped = true; }
+    void Stop() { mPlaying = false; }
+    void Locate(double beat) { mBeat = beat; mJumped = true; }
+
+    // Cycle between the two beats (no loop when they are equal)
+    void SetLoop(double start, double end) { mLoopStart = start; mLoopEnd = end; }
+
+    // On to the next buffer
+    void Advance() {
+        mJumped = false;
+        if (!mPlaying) return;
+        mBeat = BeatAt(kBufferFrames);
+        if (mLoopEnd > mLoopStart && mBeat >= mLoopEnd) {
+            mBeat -= mLoopEnd - mLoopStart;
+            mJumped = true;
+        }
+    }
+
+private:
+    double mTempo;
+    double mBeat;
+    bool mPlaying;
+    bool mJumped;
+    double mLoopStart;
+    double mLoopEnd;
+};
+
+// What the host does before buffer b: plays from the top, changes tempo twice, loops
+// four beats, stops and starts somewhere else, then pauses and resumes in place
+void RunScript(FakeHost& host, int b) {
+    switch (b) {
+        case 0: host.Play(); break;
+        case 150: host.SetTempo(97.3); break;
+        case 300: host.SetTempo(140.0); host.SetLoop(8.0, 12.0); break;
+        case 700: host.Stop(); host.SetLoop(0.0, 0.0); break;
+        case 800: host.Locate(21.37); host.Play(); break;
+        case 900: host.Stop(); break;
+        case 950: host.Play(); break;
+        default: break;
+    }
+}
+
+// Distance (in cycles, 0 to 0.5) between two phases given in cycles
+double PhaseDistance(double a, double b) {
+    double d = fabs(a - b);
+    d -= floor(d);
+    return (d > 0.5) ? 1.0 - d : d;
+}
+
+// A sawtooth LFO's phase read back from its value, in cycles
+double SawPhase(float value) {
+    return 0.5 * ((double)value + 1.0);
+}
+
+// Synced LFOs, handled per buffer as SynthEngine::Render does, against the phase the
+// host's beat puts them at at the end of each control block
+void TestLFOLock() {
+    static const int kDivisions[] = { 1, 2, 3, 9, 12 };  // 1/16, 1/8, 1/4, 1/4T, 1/8.
+    for (int d = 0; d < 5; d++) {
+        const LFONoteDivision& division = kLFONoteDivisions[kDivisions[d]];
+        LFO lfo;
+        lfo.SetWaveform(2);
+        lfo.SetTempoSync(true);
+        lfo.SetNoteDivision(kDivisions[d]);
+        FakeHost host;
+        double maxError = 0.0, errorAfterJump = 0.0;
+        int checked = 0;
+        for (int b = 0; b < kBuffers; b++) {
+            RunScript(host, b);
+            lfo.SetTempo(host.GetTempo(), kSampleRate);
+            if (host.IsPlaying()) {
+                lfo.Sync(host.GetBeat());
+            }
+            for (int frame = 0; frame < kBufferFrames; frame += kControlBlockSize) {
+                float value = lfo.Advance(kControlBlockSize);
+                if (!host.IsPlaying()) continue;
+                double expected = host.BeatAt(frame + kControlBlockSize) * division.cyclesPerBeat;
+                double error = PhaseDistance(SawPhase(value), expected);
+                maxError = fmax(maxError, error);
+                if (host.Jumped() && frame == 0) {
+                    errorAfterJump = fmax(errorAfterJump, error);
+                }
+                checked++;
+            }
+            host.Advance();
+        }
+        printf("  %-5s %d blocks checked, max phase error %.2g cycles (%.2g on the first block after a jump)\n",
+               division.name, checked, maxError, errorAfterJump);
+        CHECK(checked > kBuffers * 6);
+        CHECK(maxError < 1e-5);
+    }
+
+    // A free-running LFO keeps its own phase whatever the host says
+    LFO freeRunning;
+    freeRunning.SetWaveform(2);
+    freeRunning.SetRate(3.0f);
+    freeRunning.SetTempo(120.0, kSampleRate);
+    LFO synced = freeRunning;
+    synced.Sync(7.3);
+    CHECK(freeRunning.Advance(100) == synced.Advance(100));
+}
+
+// Plays one buffer of the arpeggiator as SynthEngine::Render does (steps and gate ends
+// cut the buffer into blocks) and appends the frames its steps land on
+void RenderArpeggiator(Arpeggiator& arp, std::vector<int>& stepFrames) {
+    int frame = 0;
+    while (frame < kBufferFrames) {
+        if (arp.GetFramesToNextAction() == 0) {
+            ArpeggiatorAction action = arp.Process();
+            if (action.startNote >= 0) stepFrames.push_back(frame);
+        }
+        int end = kBufferFrames;
+        int arpFrames = arp.GetFramesToNextAction();
+        arpFrames = (arpFrames > 0) ? arpFrames : 1;
+        if (end - frame > arpFrames) end = frame + arpFrames;
+        arp.Advance(end - frame);
+        frame = end;
+    }
+}
+
+// The arpeggiator at each rate, chord held throughout. While the host plays every step
+// must land within a frame of the step grid, and between jumps the steps must be
+// consecutive grid points: none repeated or skipped across buffers or tempo changes.
+void TestArpeggiatorLock() {
+    for (int rate = 0; rate < 4; rate++) {
+        double stepsPerBeat = (double)(1 << rate);
+        Arpeggiator arp;
+        arp.SetRate(rate);
+        arp.SetTempo(120.0, kSampleRate);
+        arp.AddNote(60);
+        arp.AddNote(64);
+        arp.AddNote(67);
+        FakeHost host;
+        int steps = 0, offGrid = 0, broken = 0;
+        double maxOffset = 0.0;
+        double lastStep = -1.0;
+        for (int b = 0; b < kBuffers; b++) {
+            RunScript(host, b);
+            arp.SetTempo(host.GetTempo(), kSampleRate);
+            if (host.IsPlaying()) {
+                arp.Sync(host.GetBeat());
+            } else {
+                arp.Unsync();
+            }
+            if (host.Jumped() || !host.IsPlaying()) {
+                lastStep = -1.0;
+            }
+
+            std::vector<int> stepFrames;
+            RenderArpeggiator(arp, stepFrames);
+            if (host.IsPlaying()) {
+                double framesPerStep = 60.0 * kSampleRate / (host.GetTempo() * stepsPerBeat);
+                for (size_t i = 0; i < stepFrames.size(); i++) {
+                    double position = host.BeatAt(stepFrames[i]) * stepsPerBeat;
+                    double gridStep = floor(position + 0.5);
+                    double offset = fabs(position - gridStep) * framesPerStep;
+                    maxOffset = fmax(maxOffset, offset);
+                    if (offset > 1.0 + 1e-6) offGrid++;
+                    if (lastStep >= 0.0 && gridStep != lastStep + 1.0) broken++;
+                    lastStep = gridStep;
+                    steps++;
+                }
+            }
+            host.Advance();
+        }
+        printf("  rate %d: %d steps while playing, max %.2f frames off the grid\n", rate, steps, maxOffset);
+        CHECK(steps > 0);
+        CHECK(offGrid == 0);
+        CHECK(broken == 0);
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestLFOLock);
+    RUN_TEST(TestArpeggiatorLock);
+    return TestExitCode();
+}
@@ -0,0 +1,219 @@
+// Voice allocation: VoiceAllocator's free list and steal policies on their own, and
+// VoiceBank::StartNote's fade-then-start handling of stolen voices.
+
+#include "VoiceBank.h"
+#include "TestCheck.h"
+#include <string.h>
+
+namespace {
+
+const double kSampleRate = 48000.0;
+
+// Four voices holding notes 60 to 63, started in that order
+void Fill(VoiceAllocator& allocator, int policy) {
+    allocator.Reset(4);
+    allocator.SetPolicy(policy);
+    for (int i = 0; i < 4; i++) {
+        CHECK(allocator.Allocate(60 + i) == i);
+    }
+    CHECK(allocator.GetFreeCount() == 0);
+}
+
+void TestFreeList() {
+    VoiceAllocator allocator;
+    Fill(allocator, kVoiceSteal_Oldest);
+    CHECK(allocator.Allocate(70) == -1);
+
+    // A finished voice is free again, and its note no longer maps to it
+    allocator.VoiceFinished(2);
+    CHECK(allocator.GetVoiceForNote(62) == -1);
+    CHECK(allocator.GetFreeCount() == 1);
+    CHECK(allocator.Allocate(70) == 2);
+    CHECK(allocator.GetNote(2) == 70);
+
+    // Releasing only marks the voice; it stays busy until it finishes
+    CHECK(allocator.Release(61) == 1);
+    CHECK(!allocator.IsHeld(1));
+    CHECK(allocator.Release(61) == -1);
+    CHECK(allocator.GetFreeCount() == 0);
+
+    // Voices above a lowered limit play on but aren't used again
+    allocator.SetNumVoices(2);
+    allocator.VoiceFinished(3);
+    CHECK(allocator.GetFreeCount() == 0);
+    allocator.VoiceFinished(1);
+    CHECK(allocator.Allocate(80) == 1);
+    allocator.SetNumVoices(4);
+    CHECK(allocator.Allocate(81) == 3);
+}
+
+void TestStealOrder() {
+    VoiceAllocator allocator;
+    float levels[kMaxVoices] = { 0.0f };
+
+    // Oldest takes the first started, held or not
+    Fill(allocator, kVoiceSteal_Oldest);
+    allocator.Release(62);
+    CHECK(allocator.Steal(70, NULL) == 0);
+    CHECK(allocator.GetVoiceForNote(60) == -1);
+    CHECK(allocator.GetVoiceForNote(70) == 0);
+    CHECK(allocator.Steal(71, NULL) == 1);  // Voice 0 is now the newest
+
+    // Quietest by level, the older on a tie; oldest without levels
+    Fill(allocator, kVoiceSteal_Quietest);
+    levels[0] = 0.5f;
+    levels[1] = 0.2f;
+    levels[2] = 0.1f;
+    levels[3] = 0.1f;
+    CHECK(allocator.Steal(70, levels) == 2);
+    Fill(allocator, kVoiceSteal_Quietest);
+    CHECK(allocator.Steal(70, NULL) == 0);
+
+    // Released first takes the oldest released voice, then the oldest held
+    Fill(allocator, kVoiceSteal_ReleasedFirst);
+    allocator.Release(63);
+    allocator.Release(61);
+    CHECK(allocator.Steal(70, levels) == 1);
+    CHECK(allocator.Steal(71, levels) == 3);
+    CHECK(allocator.Steal(72, levels) == 0);
+
+    // Same note steals as released first
+    Fill(allocator, kVoiceSteal_SameNote);
+    allocator.Release(62);
+    CHECK(allocator.Steal(70, levels) == 2);
+    CHECK(allocator.Steal(71, levels) == 0);
+}
+
+void TestSameNoteRetrigger() {
+    VoiceAllocator allocator;
+
+    // A held note played again keeps its voice under every policy
+    for (int policy = 0; policy < kNumVoiceStealPolicies; policy++) {
+        Fill(allocator, policy);
+        allocator.VoiceFinished(3);
+        CHECK(allocator.Allocate(61) == 1);
+        CHECK(allocator.GetFreeCount() == 1);
+    }
+
+    // A released note played again: its own voice under SameNote, a fresh one otherwise
+    Fill(allocator, kVoiceSteal_SameNote);
+    allocator.VoiceFinished(3);
+    allocator.Release(61);
+    CHECK(allocator.Allocate(61) == 1);
+    CHECK(allocator.IsHeld(1));
+    Fill(allocator, kVoiceSteal_Oldest);
+    allocator.VoiceFinished(3);
+    allocator.Release(61);
+    CHECK(allocator.Allocate(61) == 3);
+    CHECK(allocator.GetNote(1) == 61);
+    CHECK(allocator.GetVoiceForNote(61) == 3);
+
+    // The old voice finishing later leaves the note on its new voice
+    allocator.VoiceFinished(1);
+    CHECK(allocator.GetVoiceForNote(61) == 3);
+}
+
+// Renders n frames with no modulation
+void RenderFrames(VoiceBank& bank, int n) {
+    VoiceBank::ModulationBlock mod;
+    memset(&mod, 0, sizeof(mod));
+    float left[kMaxVoiceBlockSize], right[kMaxVoiceBlockSize];
+    while (n > 0) {
+        int block = (n < kMaxVoiceBlockSize) ? n : kMaxVoiceBlockSize;
+        memset(left, 0, sizeof(left));
+        memset(right, 0, sizeof(right));
+        bank.Render(left, right, block, mod);
+        n -= block;
+    }
+}
+
+void TestFadeThenStart() {
+    VoiceBank *bank = new VoiceBank();
+    bank->SetPolyphony(2);
+    bank->SetEnvelope(0.001f, 0.1f, 0.8f, 0.5f);
+    CHECK(bank->StartNote(60, 100, kSampleRate) == 0);
+    CHECK(bank->StartNote(62, 100, kSampleRate) == 1);
+    RenderFrames(*bank, 1024);
+
+    // The stolen voice fades out on its old note before the new one starts
+    const int kFadeFrames = (int)(kVoiceStealFadeTime * kSampleRate);
+    CHECK(bank->StartNote(64, 100, kSampleRate) == 0);
+    CHECK(bank->GetNote(0) == 60);
+    RenderFrames(*bank, kFadeFrames / 2);
+    CHECK(bank->GetNote(0) == 60);
+    RenderFrames(*bank, kFadeFrames);
+    CHECK(bank->GetNote(0) == 64);
+    CHECK(bank->GetActiveVoiceCount() == 2);
+
+    // A voice stolen again while its note waits takes the newer note instead, and a
+    // note released before it started plays its release and frees the voice
+    CHECK(bank->StartNote(65, 100, kSampleRate) == 1);
+    CHECK(bank->StartNote(67, 100, kSampleRate) == 0);
+    CHECK(bank->StartNote(69, 100, kSampleRate) == 1);
+    CHECK(bank->ReleaseNote(69));
+    CHECK(!bank->ReleaseNote(65));
+    RenderFrames(*bank, 2 * kFadeFrames);
+    CHECK(bank->GetNote(0) == 67);
+    CHECK(bank->GetActiveVoiceCount() == 1);
+
+    // Stolen again after its fade ended but before the waiting note started: the newer
+    // note still waits its turn, and the voice is never left holding both
+    bank->SetStealPolicy(kVoiceSteal_Quietest);
+    CHECK(bank->StartNote(70, 100, kSampleRate) == 1);
+    RenderFrames(*bank, 256);
+    CHECK(bank->StartNote(72, 100, kSampleRate) == 0);
+    RenderFrames(*bank, kFadeFrames + 1);
+    CHECK(bank->StartNote(74, 100, kSampleRate) == 0);
+    CHECK(!bank->ReleaseNote(72));
+    CHECK(bank->ReleaseNote(74));
+    CHECK(bank->ReleaseNote(70));
+    RenderFrames(*bank, (int)(0.6 * kSampleRate));
+    CHECK(bank->GetActiveVoiceCount() == 0);
+    delete bank;
+}
+
+void TestFullBank() {
+    // Every policy keeps a flood of notes within the polyphony, and every note gets a voice
+    for (int policy = 0; policy < kNumVoiceStealPolicies; policy++) {
+        VoiceBank *bank = new VoiceBank();
+        bank->SetPolyphony(8);
+        bank->SetStealPolicy(policy);
+        bank->SetEnvelope(0.001f, 0.1f, 0.8f, 0.05f);
+        uint32_t random = 1;
+        bool allStarted = true, withinPolyphony = true;
+        for (int i = 0; i < 2000; i++) {
+            random = random * 1664525u + 1013904223u;
+            int note = 36 + (int)((random >> 8) % 48);
+            if (bank->StartNote(note, 100, kSampleRate) < 0) allStarted = false;
+            if ((random >> 20) & 1) bank->ReleaseNote(36 + (int)((random >> 12) % 48));
+            RenderFrames(*bank, 1 + (int)((random >> 24) % 64));
+            if (bank->GetActiveVoiceCount() > 8) withinPolyphony = false;
+        }
+        CHECK(allStarted);
+        CHECK(withinPolyphony);
+
+        // And every voice comes back once everything is released
+        bank->AllNotesOff();
+        RenderFrames(*bank, (int)(0.1 * kSampleRate));
+        CHECK(bank->GetActiveVoiceCount() == 0);
+        bool used[8] = { false };
+        for (int i = 0; i < 8; i++) {
+            int voice = bank->StartNote(90 + i, 100, kSampleRate);
+            CHECK(voice >= 0 && voice < 8 && !used[voice]);
+            if (voice >= 0 && voice < 8) used[voice] = true;
+        }
+        delete bank;
+    }
+}
+
+}  // namespace
+
+int main() {
+    WavetableBank::Shared().Build();
+    RUN_TEST(TestFreeList);
+    RUN_TEST(TestStealOrder);
+    RUN_TEST(TestSameNoteRetrigger);
+    RUN_TEST(TestFadeThenStart);
+    RUN_TEST(TestFullBank);
+    return TestExitCode();
+}
@@ -0,0 +1,143 @@
+// Multi-threaded voice rendering: VoiceRenderPool splitting the voices between the audio
+// thread and its workers must sound the same as VoiceBank rendering them all, to within
+// the rounding of summing the threads' mixes in another order.
+
+#include "VoiceRenderPool.h"
+#include "SynthEngine.h"
+#include "TestCheck.h"
+#include <string.h>
+#include <vector>
+
+namespace {
+
+const double kSampleRate = 48000.0;
+const int kBlockSize = 64;
+
+void Configure(VoiceBank& bank) {
+    bank.SetOscillator(0, kWaveform_Sawtooth, 0, 0.0f, 0.8f);
+    bank.SetOscillator(1, kWaveform_Square, -1, 7.0f, 0.5f);
+    bank.SetUnison(0, 3, 15.0f, 0.6f);
+    bank.SetFilterCutoff(2500.0f);
+    bank.SetFilterResonance(2.0f);
+    bank.SetStereoSpread(0.5f);
+    bank.SetEnvelope(0.005f, 0.1f, 0.6f, 0.05f);
+}
+
+// The pool with every worker it can have, started whatever the core count, and its
+// thresholds at their lowest so every block is split (a share per thread from 1 voice)
+void TestPoolMatchesBank() {
+    VoiceBank *single = new VoiceBank();
+    VoiceBank *pooled = new VoiceBank();
+    Configure(*single);
+    Configure(*pooled);
+    VoiceRenderPool pool;
+    pool.Start(VoiceRenderPool::kMaxWorkers);
+    CHECK(pool.GetWorkerCount() == VoiceRenderPool::kMaxWorkers);
+
+    // More voices than lane groups per thread, so every thread gets a share, some of
+    // them released part way so the active list shrinks while rendering
+    static const int kNotes = 29;
+    for (int i = 0; i < kNotes; i++) {
+        single->StartNote(36 + 2 * i, 60 + i, kSampleRate);
+        pooled->StartNote(36 + 2 * i, 60 + i, kSampleRate);
+    }
+
+    VoiceBank::ModulationBlock mod;
+    memset(&mod, 0, sizeof(mod));
+    float singleLeft[kBlockSize], singleRight[kBlockSize];
+    float pooledLeft[kBlockSize], pooledRight[kBlockSize];
+    float maxDiff = 0.0f, peak = 0.0f;
+    bool sameFrames = true;
+    for (int b = 0; b < 600; b++) {
+        if (b == 200) {
+            for (int i = 0; i < kNotes; i += 3) {
+                single->ReleaseNote(36 + 2 * i);
+                pooled->ReleaseNote(36 + 2 * i);
+            }
+        }
+        memset(singleLeft, 0, sizeof(singleLeft));
+        memset(singleRight, 0, sizeof(singleRight));
+        memset(pooledLeft, 0, sizeof(pooledLeft));
+        memset(pooledRight, 0, sizeof(pooledRight));
+        int singleFrames = single->Render(singleLeft, singleRight, kBlockSize, mod);
+        int pooledFrames = pool.Render(*pooled, pooledLeft, pooledRight, kBlockSize, mod,
+                                       VoiceRenderPool::kMaxWorkers, 1);
+        if (singleFrames != pooledFrames) sameFrames = false;
+        for (int i = 0; i < kBlockSize; i++) {
+            maxDiff = fmaxf(maxDiff, fabsf(singleLeft[i] - pooledLeft[i]));
+            maxDiff = fmaxf(maxDiff, fabsf(singleRight[i] - pooledRight[i]));
+            peak = fmaxf(peak, fmaxf(fabsf(singleLeft[i]), fabsf(singleRight[i])));
+        }
+    }
+    printf("  %d workers: max |diff| %.3g, peak %.3f\n", pool.GetWorkerCount(), maxDiff, peak);
+    CHECK(sameFrames);
+    CHECK(single->GetActiveVoiceCount() == pooled->GetActiveVoiceCount());
+    CHECK(peak > 0.1f);
+    CHECK(maxDiff <= 1e-5f * peak);
+
+    pool.Stop();
+    delete single;
+    delete pooled;
+}
+
+// Renders notes through an engine with the given render threads, workers allowed at any
+// buffer size and voice count
+std::vector<float> RenderEngine(int renderThreads, int *workers) {
+    const uint32_t kFrames = 256;
+    SynthEngine *engine = new SynthEngine();
+    engine->SetSampleRate(kSampleRate);
+    engine->Initialize();
+    engine->SetWorkerThresholds(0, 1);
+    engine->SetParameter(kParam_RenderThreads, (float)renderThreads);
+    engine->SetParameter(kParam_Osc2_Volume, 0.5f);
+    engine->SetParameter(kParam_Osc1_Unison, 3.0f);
+    *workers = engine->GetRenderWorkerCount();
+
+    std::vector<float> output;
+    std::vector<float> left(kFrames), right(kFrames);
+    for (int b = 0; b < 400; b++) {
+        if (b == 0) {
+            for (int i = 0; i < 24; i++) {
+                engine->QueueMIDIEvent(0x90, (uint8_t)(40 + i), (uint8_t)(50 + 3 * i), (uint32_t)(7 * i));
+            }
+        } else if (b == 150) {
+            for (int i = 0; i < 24; i += 2) {
+                engine->QueueMIDIEvent(0x80, (uint8_t)(40 + i), 0, (uint32_t)(5 * i));
+            }
+        }
+        engine->Render(&left[0], &right[0], kFrames);
+        output.insert(output.end(), left.begin(), left.end());
+        output.insert(output.end(), right.begin(), right.end());
+    }
+    engine->Uninitialize();
+    delete engine;
+    return output;
+}
+
+// The engine with RenderThreads at 0 and at its most. Workers start only once asked for,
+// so the first engine has none; on one core the second has none either, and both renders
+// are single-threaded.
+void TestEngineMatchesSingleThreaded() {
+    int noWorkers = 0, workers = 0;
+    std::vector<float> single = RenderEngine(0, &noWorkers);
+    std::vector<float> threaded = RenderEngine(VoiceRenderPool::kMaxWorkers, &workers);
+    CHECK(noWorkers == 0);
+    CHECK(single.size() == threaded.size());
+    float maxDiff = 0.0f, peak = 0.0f;
+    for (size_t i = 0; i < single.size() && i < threaded.size(); i++) {
+        maxDiff = fmaxf(maxDiff, fabsf(single[i] - threaded[i]));
+        peak = fmaxf(peak, fabsf(single[i]));
+    }
+    printf("  engine with %d workers: max |diff| %.3g, peak %.3f\n", workers, maxDiff, peak);
+    CHECK(peak > 0.1f);
+    CHECK_NEAR(maxDiff, 0.0f, 1e-5f * peak);
+}
+
+}  // namespace
+
+int main() {
+    WavetableBank::Shared().Build();
+    RUN_TEST(TestPoolMatchesBank);
+    RUN_TEST(TestEngineMatchesSingleThreaded);
+    return TestExitCode();
+}
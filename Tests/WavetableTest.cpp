@@ -0,0 +1,141 @@
+// Spectral test of the band-limited oscillators in WavetableBank.h: how far below the
+// harmonics their aliasing is at high notes, against the naive generators they replaced.
+
+#include "WavetableBank.h"
+#include "SynthVoice.h"
+#include "TestCheck.h"
+#include <vector>
+
+namespace {
+
+const int kSampleRate = 44100;
+const int kLength = 65536;  // One analysis period
+
+// Mean square of the sinusoid at frequency bin (Goertzel) in a kLength-sample period
+double BinPower(const std::vector<double>& samples, int bin) {
+    double coefficient = 2.0 * cos(2.0 * M_PI * bin / kLength);
+    double s1 = 0.0, s2 = 0.0;
+    for (int i = 0; i < kLength; i++) {
+        double s0 = samples[i] + coefficient * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    double power = s1 * s1 + s2 * s2 - coefficient * s1 * s2;
+    return 2.0 * power / ((double)kLength * kLength);
+}
+
+// Aliasing power relative to the harmonics (dB) of one period of a waveform whose
+// fundamental is exactly on frequency bin. With bin odd, no alias folds back onto a
+// harmonic, so everything that isn't on a harmonic's bin is aliasing.
+double AliasingDB(const std::vector<double>& samples, int bin) {
+    double total = 0.0, mean = 0.0;
+    for (int i = 0; i < kLength; i++) {
+        mean += samples[i];
+    }
+    mean /= kLength;
+    for (int i = 0; i < kLength; i++) {
+        total += (samples[i] - mean) * (samples[i] - mean);
+    }
+    total /= kLength;
+    double harmonics = 0.0;
+    for (int h = 1; h * bin < kLength / 2; h++) {
+        harmonics += BinPower(samples, h * bin);
+    }
+    double aliasing = fmax(total - harmonics, harmonics * 1e-15);
+    return 10.0 * log10(aliasing / harmonics);
+}
+
+// The fundamental's bin for a MIDI note, made odd
+int NoteBin(int note) {
+    double frequency = 440.0 * pow(2.0, (note - 69) / 12.0);
+    return (int)(frequency * kLength / kSampleRate) | 1;
+}
+
+// One period from the wavetables, read as the voices read them
+std::vector<double> RenderWavetable(int waveform, int bin) {
+    double increment = (double)bin / kLength;
+    const float *table = WavetableBank::Shared().GetTable(waveform, increment);
+    uint32_t step = WavetableBank::ToFixedIncrement(increment);
+    uint32_t phase = 0;
+    std::vector<double> samples(kLength);
+    for (int i = 0; i < kLength; i++) {
+        samples[i] = WavetableBank::Read(table, phase);
+        phase += step;
+    }
+    return samples;
+}
+
+// One period from the generators the wavetables replaced (SynthVoice before them)
+std::vector<double> RenderNaive(int waveform, int bin) {
+    std::vector<double> samples(kLength);
+    for (int i = 0; i < kLength; i++) {
+        float phase = (float)((double)((int64_t)i * bin % kLength) / kLength);
+        float sample = 0.0f;
+        switch (waveform) {
+            case kWaveform_Square:
+                sample = (phase < 0.5f) ? 1.0f : -1.0f;
+                break;
+            case kWaveform_Sawtooth:
+                sample = 2.0f * phase - 1.0f;
+                break;
+            case kWaveform_Triangle:
+                sample = (phase < 0.5f) ? 4.0f * phase - 1.0f : -4.0f * phase + 3.0f;
+                break;
+        }
+        samples[i] = sample;
+    }
+    return samples;
+}
+
+void TestAliasing() {
+    static const int kWaveforms[] = { kWaveform_Square, kWaveform_Sawtooth, kWaveform_Triangle };
+    static const char *kNames[] = { "square", "saw", "triangle" };
+    static const int kNotes[] = { 60, 84, 96, 108 };
+    printf("  aliasing vs harmonics, wavetable (naive):\n");
+    for (int w = 0; w < 3; w++) {
+        printf("  %-8s", kNames[w]);
+        for (int n = 0; n < 4; n++) {
+            int bin = NoteBin(kNotes[n]);
+            double wavetable = AliasingDB(RenderWavetable(kWaveforms[w], bin), bin);
+            double naive = AliasingDB(RenderNaive(kWaveforms[w], bin), bin);
+            printf("  note %d %6.1f dB (%5.1f)", kNotes[n], wavetable, naive);
+            CHECK(wavetable < -75.0);
+            CHECK(wavetable < naive - 10.0);
+        }
+        printf("\n");
+    }
+}
+
+void TestLevels() {
+    // The band-limited sawtooth keeps the naive one's fundamental, 2 / pi
+    int bin = NoteBin(60);
+    std::vector<double> saw = RenderWavetable(kWaveform_Sawtooth, bin);
+    CHECK_NEAR(sqrt(2.0 * BinPower(saw, bin)), 2.0 / M_PI, 1e-3);
+
+    // Sine is a single exact table
+    const float *sine = WavetableBank::Shared().GetTable(kWaveform_Sine, 0.01);
+    for (int i = 0; i <= kWavetableSize; i += 64) {
+        CHECK_NEAR(sine[i], sin(2.0 * M_PI * i / kWavetableSize), 1e-6);
+    }
+    CHECK(sine == WavetableBank::Shared().GetTable(kWaveform_Sine, 0.4));
+}
+
+void TestBounds() {
+    WavetableBank& bank = WavetableBank::Shared();
+    // A fundamental above Nyquist gets no table, and neither does an unknown waveform
+    CHECK(bank.GetTable(kWaveform_Sawtooth, 0.5) == NULL);
+    CHECK(bank.GetTable(4, 0.01) == NULL);
+    // Memory is fixed: one sine table and a level per octave for the other three
+    CHECK(bank.GetTableCount() == 1 + 3 * kWavetableLevels);
+    CHECK(bank.GetMemoryUsage() == (size_t)bank.GetTableCount() * (kWavetableSize + 1) * sizeof(float));
+}
+
+}  // namespace
+
+int main() {
+    WavetableBank::Shared().Build();
+    RUN_TEST(TestAliasing);
+    RUN_TEST(TestLevels);
+    RUN_TEST(TestBounds);
+    return TestExitCode();
+}
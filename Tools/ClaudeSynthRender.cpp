@@ -0,0 +1,1286 @@
+// claudesynth_render: offline renderer and benchmark for the synth engine
+//
+// Renders a MIDI file or note script through SynthEngine exactly as a host would (fixed
+// size buffers, MIDI events queued at their frame offsets), writes the result as a
+// 32-bit float WAV, and reports how long each render stage took. Runs anywhere the
+// engine builds, so it doubles as the performance regression check.
+//
+// Note script format (one event per line, times in seconds, '#' starts a comment):
+//     note <time> <note> <velocity> <duration>
+//     cc <time> <controller> <value>
+//     aftertouch <time> <value>
+//     param <time> <parameter id> <value>
+//     ramp <time> <parameter id> <start value> <end value> <duration>
+//
+// Parameter files hold "<parameter id> <value>" (or "<id>=<value>") lines; IDs are the
+// kParam_ values in SynthParameters.h. Presets (--preset, --save-preset) are complete
+// parameter sets in SynthPreset's binary format, or its text format, which is a
+// parameter file.
+
+#include "SynthEngine.h"
+#include "VoiceRenderPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+
+// One timed input event: a MIDI message, or a parameter change when isParameter is set
+// (a ramp from startValue to value when rampDuration isn't 0)
+struct RenderEvent {
+    double time;  // Seconds
+    bool isParameter;
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+    uint32_t paramID;
+    float value;
+    float startValue;
+    double rampDuration;  // Seconds
+};
+
+bool EventTimeLess(const RenderEvent& a, const RenderEvent& b) {
+    return a.time < b.time;
+}
+
+RenderEvent MakeMIDIEvent(double time, uint8_t status, uint8_t data1, uint8_t data2) {
+    RenderEvent event;
+    memset(&event, 0, sizeof(event));
+    event.time = time;
+    event.status = status;
+    event.data1 = data1;
+    event.data2 = data2;
+    return event;
+}
+
+RenderEvent MakeParameterEvent(double time, uint32_t paramID, float value) {
+    RenderEvent event;
+    memset(&event, 0, sizeof(event));
+    event.time = time;
+    event.isParameter = true;
+    event.paramID = paramID;
+    event.value = value;
+    return event;
+}
+
+bool ReadFile(const char *path, std::vector<uint8_t>& contents) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t buffer[65536];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        contents.insert(contents.end(), buffer, buffer + count);
+    }
+    fclose(f);
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------
+// Standard MIDI files (format 0 and 1)
+
+class MIDIFileReader {
+public:
+    MIDIFileReader(const std::vector<uint8_t>& data) : mData(data), mPos(0), mError(NULL) {}
+
+    // Appends the file's note, controller and pressure events; NULL on success, else why not
+    const char *Read(std::vector<RenderEvent>& events) {
+        if (!Expect("MThd")) return "not a MIDI file";
+        uint32_t headerLength = Read32();
+        uint16_t format = Read16();
+        uint16_t numTracks = Read16();
+        int16_t division = (int16_t)Read16();
+        mPos += headerLength - 6;
+        if (mError) return mError;
+        if (format > 1) return "format 2 MIDI files are not supported";
+
+        std::vector<TimedMessage> messages;
+        std::vector<TempoChange> tempos;
+        for (int track = 0; track < numTracks && !mError; track++) {
+            ReadTrack(messages, tempos);
+        }
+        if (mError) return mError;
+
+        std::stable_sort(tempos.begin(), tempos.end(), TempoLess);
+        for (size_t i = 0; i < messages.size(); i++) {
+            double time = TicksToSeconds(messages[i].tick, division, tempos);
+            events.push_back(MakeMIDIEvent(time, messages[i].status, messages[i].data1, messages[i].data2));
+        }
+        return NULL;
+    }
+
+private:
+    struct TimedMessage {
+        uint64_t tick;
+        uint8_t status, data1, data2;
+    };
+
+    struct TempoChange {
+        uint64_t tick;
+        uint32_t microsecondsPerQuarter;
+    };
+
+    static bool TempoLess(const TempoChange& a, const TempoChange& b) {
+        return a.tick < b.tick;
+    }
+
+    static double TicksToSeconds(uint64_t tick, int16_t division, const std::vector<TempoChange>& tempos) {
+        if (division < 0) {
+            // SMPTE: frames per second in the high byte, ticks per frame in the low byte
+            int framesPerSecond = -(division >> 8);
+            int ticksPerFrame = division & 0xFF;
+            return (double)tick / ((double)framesPerSecond * ticksPerFrame);
+        }
+
+        double seconds = 0.0;
+        uint64_t lastTick = 0;
+        double secondsPerTick = 0.5 / division;  // 120 BPM until the first tempo event
+        for (size_t i = 0; i < tempos.size() && tempos[i].tick < tick; i++) {
+            seconds += (tempos[i].tick - lastTick) * secondsPerTick;
+            lastTick = tempos[i].tick;
+            secondsPerTick = tempos[i].microsecondsPerQuarter * 1e-6 / division;
+        }
+        return seconds + (tick - lastTick) * secondsPerTick;
+    }
+
+    void ReadTrack(std::vector<TimedMessage>& messages, std::vector<TempoChange>& tempos) {
+        if (!Expect("MTrk")) return;
+        uint32_t length = Read32();
+        size_t end = mPos + length;
+        if (end > mData.size()) {
+            mError = "truncated track";
+            return;
+        }
+
+        uint64_t tick = 0;
+        uint8_t runningStatus = 0;
+        while (mPos < end && !mError) {
+            tick += ReadVariableLength();
+            uint8_t status = Peek();
+            if (status & 0x80) {
+                mPos++;
+            } else {
+                status = runningStatus;  // Running status: reuse the last channel status
+            }
+
+            if (status == 0xFF) {
+                uint8_t type = Read8();
+                uint32_t metaLength = ReadVariableLength();
+                if (type == 0x51 && metaLength == 3) {
+                    TempoChange tempo;
+                    tempo.tick = tick;
+                    tempo.microsecondsPerQuarter = (uint32_t)Read8() << 16;
+                    tempo.microsecondsPerQuarter |= (uint32_t)Read8() << 8;
+                    tempo.microsecondsPerQuarter |= Read8();
+                    tempos.push_back(tempo);
+                } else {
+                    mPos += metaLength;
+                }
+                if (type == 0x2F) break;  // End of track
+            } else if (status == 0xF0 || status == 0xF7) {
+                mPos += ReadVariableLength();  // SysEx
+            } else if (status & 0x80) {
+                runningStatus = status;
+                TimedMessage message;
+                message.tick = tick;
+                message.status = status;
+                message.data1 = Read8();
+                uint8_t type = status & 0xF0;
+                message.data2 = (type == 0xC0 || type == 0xD0) ? 0 : Read8();
+                if (type == 0x80 || type == 0x90 || type == 0xB0 || type == 0xD0) {
+                    messages.push_back(message);
+                }
+            } else {
+                mError = "data byte without a status";
+            }
+        }
+        mPos = end;
+    }
+
+    bool Expect(const char *tag) {
+        if (mPos + 4 > mData.size() || memcmp(&mData[mPos], tag, 4) != 0) {
+            mError = "missing chunk header";
+            return false;
+        }
+        mPos += 4;
+        return true;
+    }
+
+    uint8_t Peek() {
+        if (mPos >= mData.size()) {
+            mError = "unexpected end of file";
+            return 0;
+        }
+        return mData[mPos];
+    }
+
+    uint8_t Read8() {
+        uint8_t value = Peek();
+        mPos++;
+        return value;
+    }
+
+    uint16_t Read16() {
+        uint16_t high = Read8();
+        return (uint16_t)((high << 8) | Read8());
+    }
+
+    uint32_t Read32() {
+        uint32_t high = Read16();
+        return (high << 16) | Read16();
+    }
+
+    uint32_t ReadVariableLength() {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            uint8_t byte = Read8();
+            value = (value << 7) | (byte & 0x7F);
+            if (!(byte & 0x80)) break;
+        }
+        return value;
+    }
+
+    const std::vector<uint8_t>& mData;
+    size_t mPos;
+    const char *mError;
+};
+
+// ---------------------------------------------------------------------------------------
+// Note scripts and parameter files
+
+std::vector<std::string> SplitLines(const std::vector<uint8_t>& contents) {
+    std::vector<std::string> lines(1);
+    for (size_t i = 0; i < contents.size(); i++) {
+        char c = (char)contents[i];
+        if (c == '\n') {
+            lines.push_back(std::string());
+        } else if (c != '\r') {
+            lines.back() += c;
+        }
+    }
+    for (size_t i = 0; i < lines.size(); i++) {
+        size_t comment = lines[i].find('#');
+        if (comment != std::string::npos) lines[i].erase(comment);
+    }
+    return lines;
+}
+
+bool IsBlank(const std::string& line) {
+    return line.find_first_not_of(" \t") == std::string::npos;
+}
+
+// Returns false (after printing the offending line) on a syntax error
+bool ReadNoteScript(const char *path, const std::vector<uint8_t>& contents, std::vector<RenderEvent>& events) {
+    std::vector<std::string> lines = SplitLines(contents);
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (IsBlank(lines[i])) continue;
+
+        char keyword[32];
+        double time, a, b, c, d;
+        int fields = sscanf(lines[i].c_str(), "%31s %lf %lf %lf %lf %lf", keyword, &time, &a, &b, &c, &d);
+        bool ok = false;
+        if (strcmp(keyword, "note") == 0 && fields == 5) {
+            events.push_back(MakeMIDIEvent(time, 0x90, (uint8_t)a, (uint8_t)b));
+            events.push_back(MakeMIDIEvent(time + c, 0x80, (uint8_t)a, 0));
+            ok = true;
+        } else if (strcmp(keyword, "cc") == 0 && fields == 4) {
+            events.push_back(MakeMIDIEvent(time, 0xB0, (uint8_t)a, (uint8_t)b));
+            ok = true;
+        } else if (strcmp(keyword, "aftertouch") == 0 && fields == 3) {
+            events.push_back(MakeMIDIEvent(time, 0xD0, (uint8_t)a, 0));
+            ok = true;
+        } else if (strcmp(keyword, "param") == 0 && fields == 4) {
+            events.push_back(MakeParameterEvent(time, (uint32_t)a, (float)b));
+            ok = true;
+        } else if (strcmp(keyword, "ramp") == 0 && fields == 6 && d >= 0.0) {
+            RenderEvent event = MakeParameterEvent(time, (uint32_t)a, (float)c);
+            event.startValue = (float)b;
+            event.rampDuration = d;
+            events.push_back(event);
+            ok = true;
+        }
+        if (!ok || time < 0.0) {
+            fprintf(stderr, "%s:%d: can't parse \"%s\"\n", path, (int)i + 1, lines[i].c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParseParameterAssignment(const char *text, uint32_t *paramID, float *value) {
+    unsigned int id;
+    if (sscanf(text, " %u = %f", &id, value) == 2 || sscanf(text, " %u %f", &id, value) == 2) {
+        *paramID = id;
+        return true;
+    }
+    return false;
+}
+
+bool ReadParameterFile(const char *path, std::vector<RenderEvent>& events) {
+    std::vector<uint8_t> contents;
+    if (!ReadFile(path, contents)) {
+        fprintf(stderr, "Can't read %s\n", path);
+        return false;
+    }
+    std::vector<std::string> lines = SplitLines(contents);
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (IsBlank(lines[i])) continue;
+        uint32_t paramID;
+        float value;
+        if (!ParseParameterAssignment(lines[i].c_str(), &paramID, &value)) {
+            fprintf(stderr, "%s:%d: can't parse \"%s\"\n", path, (int)i + 1, lines[i].c_str());
+            return false;
+        }
+        events.push_back(MakeParameterEvent(0.0, paramID, value));
+    }
+    return true;
+}
+
+// Binary or text, by content
+bool ReadPresetFile(const char *path, std::vector<RenderEvent>& events) {
+    std::vector<uint8_t> contents;
+    if (!ReadFile(path, contents)) {
+        fprintf(stderr, "Can't read %s\n", path);
+        return false;
+    }
+    SynthPreset preset;
+    bool binary = (contents.size() >= 4 && memcmp(&contents[0], "CSyP", 4) == 0);
+    bool ok = contents.empty() ? true :
+              binary ? preset.ReadBinary(&contents[0], contents.size()) :
+                       preset.ReadText((const char *)&contents[0], contents.size());
+    if (!ok) {
+        fprintf(stderr, "%s: not a preset this version can read\n", path);
+        return false;
+    }
+    for (uint32_t paramID = 0; paramID < (uint32_t)kNumParameterIDs; paramID++) {
+        if (preset.present[paramID]) {
+            events.push_back(MakeParameterEvent(0.0, paramID, preset.values[paramID]));
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------
+// Output
+
+bool HasSuffix(const std::string& text, const char *suffix) {
+    size_t length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+// The engine's state after the parameters, as text for a .params or .txt path and
+// binary otherwise
+bool WritePresetFile(const char *path, const std::vector<RenderEvent>& parameters) {
+    SynthEngine *engine = new SynthEngine;
+    for (size_t i = 0; i < parameters.size(); i++) {
+        engine->SetParameter(parameters[i].paramID, parameters[i].value);
+    }
+    SynthPreset preset;
+    engine->GetPreset(&preset);
+    delete engine;
+
+    std::vector<uint8_t> contents;
+    if (HasSuffix(path, ".params") || HasSuffix(path, ".txt")) {
+        std::string text;
+        preset.WriteText(text);
+        contents.assign(text.begin(), text.end());
+    } else {
+        preset.WriteBinary(contents);
+    }
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    fwrite(&contents[0], 1, contents.size(), f);
+    bool ok = (ferror(f) == 0);
+    fclose(f);
+    return ok;
+}
+
+void Write16(FILE *f, uint16_t value) {
+    uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    fwrite(bytes, 1, 2, f);
+}
+
+void Write32(FILE *f, uint32_t value) {
+    uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    fwrite(bytes, 1, 4, f);
+}
+
+// Interleaved stereo, 32-bit float
+bool WriteWAV(const char *path, const std::vector<float>& samples, int sampleRate) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+
+    const int kChannels = 2;
+    uint32_t dataBytes = (uint32_t)(samples.size() * sizeof(float));
+    fwrite("RIFF", 1, 4, f);
+    Write32(f, 4 + (8 + 16) + (8 + 4) + (8 + dataBytes));
+    fwrite("WAVE", 1, 4, f);
+
+    fwrite("fmt ", 1, 4, f);
+    Write32(f, 16);
+    Write16(f, 3);  // WAVE_FORMAT_IEEE_FLOAT
+    Write16(f, kChannels);
+    Write32(f, (uint32_t)sampleRate);
+    Write32(f, (uint32_t)sampleRate * kChannels * sizeof(float));
+    Write16(f, kChannels * sizeof(float));
+    Write16(f, 32);
+
+    fwrite("fact", 1, 4, f);
+    Write32(f, 4);
+    Write32(f, (uint32_t)(samples.size() / kChannels));
+
+    fwrite("data", 1, 4, f);
+    Write32(f, dataBytes);
+    for (size_t i = 0; i < samples.size(); i++) {
+        uint32_t bits;
+        memcpy(&bits, &samples[i], sizeof(bits));
+        Write32(f, bits);
+    }
+
+    bool ok = (ferror(f) == 0);
+    fclose(f);
+    return ok;
+}
+
+struct RenderResult {
+    SynthEngine::StageTimings timings;
+    double renderSeconds;  // Wall time inside SynthEngine::Render
+    int peakVoices;
+    float peakLevel;
+    uint64_t buffers;
+    uint64_t silentBuffers;  // Buffers Render reported silent without rendering
+    int renderWorkers;       // Worker threads the engine started
+    double worstBufferSeconds;  // Longest single call to SynthEngine::Render
+};
+
+// Renders the events through a fresh engine, host style. With a tempo, the engine is told
+// the transport is playing at it from beat 0, as a host bouncing a song would. Returns the
+// interleaved output in samples when it isn't NULL. With liftWorkerThresholds, render
+// workers join in at any buffer size and for any number of voices above one per thread.
+RenderResult Render(const std::vector<RenderEvent>& events, const std::vector<RenderEvent>& parameters,
+                    int sampleRate, int bufferFrames, double tempo, uint64_t totalFrames,
+                    std::vector<float> *samples, bool liftWorkerThresholds = false) {
+    SynthEngine *engine = new SynthEngine;
+    engine->SetSampleRate(sampleRate);
+    engine->Initialize();
+    if (liftWorkerThresholds) {
+        engine->SetWorkerThresholds(0, 1);
+    }
+    for (size_t i = 0; i < parameters.size(); i++) {
+        engine->SetParameter(parameters[i].paramID, parameters[i].value);
+    }
+
+    RenderResult result;
+    memset(&result, 0, sizeof(result));
+    result.renderWorkers = engine->GetRenderWorkerCount();
+    engine->SetStageTimings(&result.timings);
+
+    std::vector<float> left(bufferFrames), right(bufferFrames);
+    if (samples) {
+        samples->clear();
+        samples->reserve(totalFrames * 2);
+    }
+
+    size_t nextEvent = 0;
+    for (uint64_t position = 0; position < totalFrames; position += bufferFrames) {
+        uint32_t frames = (uint32_t)std::min<uint64_t>(bufferFrames, totalFrames - position);
+
+        // MIDI events and parameter changes are queued at their frames
+        while (nextEvent < events.size()) {
+            const RenderEvent& event = events[nextEvent];
+            uint64_t frame = (uint64_t)(event.time * sampleRate + 0.5);
+            if (frame >= position + frames) break;
+            uint32_t offset = (frame > position) ? (uint32_t)(frame - position) : 0;
+            if (event.isParameter) {
+                uint32_t rampFrames = (uint32_t)(event.rampDuration * sampleRate + 0.5);
+                engine->QueueParameterRamp(event.paramID, event.startValue, event.value, offset, rampFrames);
+            } else {
+                engine->QueueMIDIEvent(event.status, event.data1, event.data2, offset);
+            }
+            nextEvent++;
+        }
+
+        if (tempo > 0.0) {
+            SynthEngine::Transport transport;
+            transport.tempo = tempo;
+            transport.beatPosition = (double)position * tempo / (60.0 * sampleRate);
+            transport.playing = true;
+            engine->SetTransport(transport);
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool silent = engine->Render(&left[0], &right[0], frames);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.renderSeconds += elapsed;
+        result.worstBufferSeconds = std::max(result.worstBufferSeconds, elapsed);
+
+        result.buffers++;
+        if (silent) result.silentBuffers++;
+        result.peakVoices = std::max(result.peakVoices, engine->GetActiveVoiceCount());
+        for (uint32_t i = 0; i < frames; i++) {
+            result.peakLevel = std::max(result.peakLevel, std::max(fabsf(left[i]), fabsf(right[i])));
+            if (samples) {
+                samples->push_back(left[i]);
+                samples->push_back(right[i]);
+            }
+        }
+    }
+
+    engine->SetStageTimings(NULL);
+    engine->Uninitialize();
+    delete engine;
+    return result;
+}
+
+// Render cost against voice count: for each count, that many notes held from the start
+// for seconds, best of repeat runs. Printed as a table or JSON.
+int RunScaling(const std::vector<RenderEvent>& parameters, int sampleRate, int bufferFrames,
+               double seconds, int repeat, bool json) {
+    static const int kCounts[] = { 1, 2, 4, 8, 16, 24, 32, 48, 64, 96, 128 };
+    const int numCounts = (int)(sizeof(kCounts) / sizeof(kCounts[0]));
+    uint64_t totalFrames = (uint64_t)(seconds * sampleRate);
+    if (totalFrames == 0) totalFrames = bufferFrames;
+    double audioSeconds = (double)totalFrames / sampleRate;
+
+    if (json) {
+        printf("{\n  \"sample_rate\": %d,\n  \"buffer_frames\": %d,\n  \"audio_seconds\": %.6f,\n",
+               sampleRate, bufferFrames, audioSeconds);
+        printf("  \"scaling\": [\n");
+    } else {
+        printf("Render cost by voice count, %.2f s held at %d Hz (%d-frame buffers)\n\n",
+               audioSeconds, sampleRate, bufferFrames);
+        printf("  %6s %10s %10s %14s %16s\n", "voices", "seconds", "real time", "ns/voice-frame", "voices per core");
+    }
+    for (int c = 0; c < numCounts; c++) {
+        int count = kCounts[c];
+        if (count > kMaxVoices) break;
+        // Notes spread over the keyboard (37 is coprime to 128, so all 128 are distinct)
+        std::vector<RenderEvent> events;
+        for (int i = 0; i < count; i++) {
+            events.push_back(MakeMIDIEvent(0.0, 0x90, (uint8_t)((24 + i * 37) % 128), 100));
+        }
+
+        RenderResult best = Render(events, parameters, sampleRate, bufferFrames, 0.0, totalFrames, NULL);
+        for (int r = 1; r < repeat; r++) {
+            RenderResult result = Render(events, parameters, sampleRate, bufferFrames, 0.0, totalFrames, NULL);
+            if (result.renderSeconds < best.renderSeconds) best = result;
+        }
+        double renderSeconds = std::max(best.renderSeconds, 1e-9);
+        double nsPerVoiceFrame = renderSeconds * 1e9 / ((double)count * totalFrames);
+        double voicesPerCore = count * audioSeconds / renderSeconds;
+        if (json) {
+            printf("    { \"voices\": %d, \"peak_voices\": %d, \"render_seconds\": %.6f, "
+                   "\"ns_per_voice_frame\": %.2f, \"voices_per_core\": %.1f }%s\n",
+                   count, best.peakVoices, best.renderSeconds, nsPerVoiceFrame, voicesPerCore,
+                   (c + 1 < numCounts && kCounts[c + 1] <= kMaxVoices) ? "," : "");
+        } else {
+            printf("  %6d %10.4f %9.1fx %14.2f %16.0f\n", count, best.renderSeconds,
+                   audioSeconds / renderSeconds, nsPerVoiceFrame, voicesPerCore);
+        }
+    }
+    if (json) {
+        printf("  ]\n}\n");
+    }
+    return 0;
+}
+
+// Oscillator pitch before and after cached phase increments. The pitch ratio of every
+// oscillator of kPitchVoices voices is timed per sample three ways: pow() for the octave
+// and detune (as voices did before the increments were cached), the cached ratio, and the
+// cached ratio scaled by FastExp2 as for modulated detune (which the engine only pays once
+// a control block). Then the engine renders kPitchVoices held notes on three oscillators
+// for seconds, with static detune and with LFO 1 on every oscillator's detune; voices per
+// core "with pow()" puts pow()'s extra cost per voice-frame back on. Best of repeat runs.
+const int kPitchVoices = 16;
+
+int RunPitchBenchmark(const std::vector<RenderEvent>& parameters, int sampleRate, int bufferFrames,
+                      double seconds, int repeat, bool json) {
+    const int kOscillators = kPitchVoices * 3;
+    uint64_t totalFrames = std::max<uint64_t>((uint64_t)(seconds * sampleRate), bufferFrames);
+    double audioSeconds = (double)totalFrames / sampleRate;
+
+    int octave[kOscillators];
+    float detune[kOscillators];
+    double cached[kOscillators];
+    for (int i = 0; i < kOscillators; i++) {
+        octave[i] = i % 3 - 1;
+        detune[i] = 0.37f * (float)(i % 11) - 2.0f;
+        cached[i] = pow(2.0, octave[i]) * pow(2.0, detune[i] / 1200.0);
+    }
+
+    // ns per voice-frame of each way of getting the ratio (3 oscillators a voice)
+    static const char *kMethodNames[] = { "pow()", "cached", "cached x FastExp2" };
+    double nsPerVoiceFrame[3];
+    int frames = (int)std::min<uint64_t>(totalFrames, 200000);
+    for (int method = 0; method < 3; method++) {
+        double bestSeconds = 1e30;
+        for (int r = 0; r < repeat; r++) {
+            volatile double sink = 0.0;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < frames; frame++) {
+                double sum = 0.0;
+                double detuneMod = 0.001 * (frame & 1023);
+                for (int i = 0; i < kOscillators; i++) {
+                    if (method == 0) {
+                        sum += pow(2.0, octave[i]) * pow(2.0, detune[i] / 1200.0);
+                    } else if (method == 1) {
+                        sum += cached[i];
+                    } else {
+                        sum += cached[i] * FastExp2(detuneMod / 1200.0);
+                    }
+                }
+                sink = sink + sum;
+            }
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            bestSeconds = std::min(bestSeconds, elapsed);
+        }
+        nsPerVoiceFrame[method] = bestSeconds * 1e9 / ((double)frames * kPitchVoices);
+    }
+
+    // The engine with three audible oscillators, then with their detune modulated
+    std::vector<RenderEvent> events;
+    for (int i = 0; i < kPitchVoices; i++) {
+        events.push_back(MakeMIDIEvent(0.0, 0x90, (uint8_t)(36 + 2 * i), 100));
+    }
+    std::vector<RenderEvent> engineParameters = parameters;
+    engineParameters.push_back(MakeParameterEvent(0.0, kParam_Osc2_Volume, 0.5f));
+    engineParameters.push_back(MakeParameterEvent(0.0, kParam_Osc3_Volume, 0.5f));
+    static const char *kCaseNames[] = { "static detune", "detune modulated" };
+    double voicesPerCore[2], withPow[2];
+    for (int modulated = 0; modulated < 2; modulated++) {
+        std::vector<RenderEvent> caseParameters = engineParameters;
+        if (modulated) {
+            static const int kDestinations[] = { kModDest_Osc1_Detune, kModDest_Osc2_Detune, kModDest_Osc3_Detune };
+            for (int slot = 0; slot < 3; slot++) {
+                caseParameters.push_back(MakeParameterEvent(0.0, ModSlotParameterID(slot, 0), kModSource_LFO1));
+                caseParameters.push_back(MakeParameterEvent(0.0, ModSlotParameterID(slot, 1), kDestinations[slot]));
+                caseParameters.push_back(MakeParameterEvent(0.0, ModSlotParameterID(slot, 2), 20.0f));
+            }
+        }
+        double bestSeconds = 1e30;
+        for (int r = 0; r < repeat; r++) {
+            RenderResult result = Render(events, caseParameters, sampleRate, bufferFrames, 0.0, totalFrames, NULL);
+            bestSeconds = std::min(bestSeconds, result.renderSeconds);
+        }
+        double engineNs = std::max(bestSeconds, 1e-9) * 1e9 / ((double)kPitchVoices * totalFrames);
+        double powNs = engineNs + nsPerVoiceFrame[0] - nsPerVoiceFrame[1];
+        voicesPerCore[modulated] = 1e9 / (engineNs * sampleRate);
+        withPow[modulated] = 1e9 / (powNs * sampleRate);
+    }
+
+    if (json) {
+        printf("{\n  \"sample_rate\": %d,\n  \"audio_seconds\": %.6f,\n  \"voices\": %d,\n",
+               sampleRate, audioSeconds, kPitchVoices);
+        printf("  \"pitch_ns_per_voice_frame\": { \"pow\": %.3f, \"cached\": %.3f, \"fast_exp2\": %.3f },\n",
+               nsPerVoiceFrame[0], nsPerVoiceFrame[1], nsPerVoiceFrame[2]);
+        printf("  \"voices_per_core\": { \"static\": %.1f, \"static_with_pow\": %.1f, "
+               "\"modulated\": %.1f, \"modulated_with_pow\": %.1f }\n}\n",
+               voicesPerCore[0], withPow[0], voicesPerCore[1], withPow[1]);
+    } else {
+        printf("Oscillator pitch, %d voices of 3 oscillators at %d Hz\n\n", kPitchVoices, sampleRate);
+        printf("  %-20s %16s\n", "pitch ratio", "ns/voice-frame");
+        for (int method = 0; method < 3; method++) {
+            printf("  %-20s %16.3f\n", kMethodNames[method], nsPerVoiceFrame[method]);
+        }
+        printf("\n  %-20s %16s %16s\n", "engine", "voices per core", "with pow()");
+        for (int modulated = 0; modulated < 2; modulated++) {
+            printf("  %-20s %16.0f %16.0f\n", kCaseNames[modulated], voicesPerCore[modulated], withPow[modulated]);
+        }
+    }
+    return 0;
+}
+
+// Where render workers start to pay off: for each host buffer size and voice count, the
+// cost with 0 up to kMaxWorkers worker threads, with the engine's thresholds lifted so
+// every combination really runs multi-threaded. "engine" is the worker count its
+// thresholds (VoiceRenderPool::kMinFramesForWorkers and kMinVoicesPerThread) would pick,
+// and "best" the fastest measured. Best of repeat runs of seconds each.
+int RunThreadSweep(const std::vector<RenderEvent>& parameters, int sampleRate, double seconds,
+                   int repeat, bool json) {
+    static const int kBufferSizes[] = { 32, 64, 128, 256, 512 };
+    static const int kCounts[] = { 4, 8, 16, 24, 32, 48, 64, 96, 128 };
+    const int numBufferSizes = (int)(sizeof(kBufferSizes) / sizeof(kBufferSizes[0]));
+    const int numCounts = (int)(sizeof(kCounts) / sizeof(kCounts[0]));
+    uint64_t totalFrames = std::max<uint64_t>((uint64_t)(seconds * sampleRate), 512);
+    double audioSeconds = (double)totalFrames / sampleRate;
+
+    // Worker threads this machine gets (one core stays with the host), started by asking
+    // for as many as there can be
+    std::vector<RenderEvent> none;
+    std::vector<RenderEvent> probeParameters = parameters;
+    const int maxWorkers = VoiceRenderPool::kMaxWorkers;
+    probeParameters.push_back(MakeParameterEvent(0.0, kParam_RenderThreads, (float)maxWorkers));
+    int available = Render(none, probeParameters, sampleRate, 512, 0.0, 512, NULL).renderWorkers;
+    int maxThreads = std::min(available, maxWorkers);
+
+    if (json) {
+        printf("{\n  \"sample_rate\": %d,\n  \"audio_seconds\": %.6f,\n  \"render_workers\": %d,\n"
+               "  \"thread_sweep\": [\n", sampleRate, audioSeconds, available);
+    } else {
+        printf("Render cost by worker threads, %.2f s held at %d Hz, ns/voice-frame\n", audioSeconds, sampleRate);
+        if (maxThreads == 0) {
+            printf("(no render workers on this machine: single-threaded only)\n");
+        }
+    }
+    bool first = true;
+    for (int b = 0; b < numBufferSizes; b++) {
+        int bufferFrames = kBufferSizes[b];
+        if (!json) {
+            printf("\n  %d-frame buffers\n  %6s", bufferFrames, "voices");
+            for (int t = 0; t <= maxThreads; t++) {
+                char label[32];
+                snprintf(label, sizeof(label), "%d worker%s", t, (t == 1) ? "" : "s");
+                printf(" %11s", label);
+            }
+            printf(" %7s %5s\n", "engine", "best");
+        }
+        for (int c = 0; c < numCounts; c++) {
+            int count = kCounts[c];
+            std::vector<RenderEvent> events;
+            for (int i = 0; i < count; i++) {
+                events.push_back(MakeMIDIEvent(0.0, 0x90, (uint8_t)((24 + i * 37) % 128), 100));
+            }
+
+            double ns[VoiceRenderPool::kMaxWorkers + 1];
+            int best = 0;
+            for (int t = 0; t <= maxThreads; t++) {
+                std::vector<RenderEvent> threadParameters = parameters;
+                threadParameters.push_back(MakeParameterEvent(0.0, kParam_RenderThreads, (float)t));
+                double bestSeconds = 1e30;
+                for (int r = 0; r < repeat; r++) {
+                    RenderResult result = Render(events, threadParameters, sampleRate, bufferFrames, 0.0,
+                                                 totalFrames, NULL, true);
+                    bestSeconds = std::min(bestSeconds, result.renderSeconds);
+                }
+                ns[t] = bestSeconds * 1e9 / ((double)count * totalFrames);
+                if (ns[t] < ns[best]) best = t;
+            }
+
+            // What VoiceRenderPool and SynthEngine would choose with their own thresholds
+            int engine = count / VoiceRenderPool::kMinVoicesPerThread - 1;
+            engine = std::max(0, std::min(engine, maxThreads));
+            if (bufferFrames < VoiceRenderPool::kMinFramesForWorkers) engine = 0;
+
+            if (json) {
+                printf("%s    { \"buffer_frames\": %d, \"voices\": %d, \"ns_per_voice_frame\": [",
+                       first ? "" : ",\n", bufferFrames, count);
+                for (int t = 0; t <= maxThreads; t++) {
+                    printf("%s%.2f", t ? ", " : "", ns[t]);
+                }
+                printf("], \"engine_workers\": %d, \"best_workers\": %d }", engine, best);
+                first = false;
+            } else {
+                printf("  %6d", count);
+                for (int t = 0; t <= maxThreads; t++) {
+                    printf(" %11.2f", ns[t]);
+                }
+                printf(" %7d %5d\n", engine, best);
+            }
+        }
+    }
+    if (json) {
+        printf("\n  ]\n}\n");
+    }
+    return 0;
+}
+
+// Voice allocation under a flood of short notes: kFloodNotesPerSecond note-ons for
+// seconds, each held 20 to 200 ms, so every buffer starts, steals and releases voices
+// dozens of times. Timed for each steal policy at the polyphony the parameters set,
+// best of repeat runs; the worst buffer is what a host would hear as a dropout.
+const int kFloodNotesPerSecond = 10000;
+
+int RunFlood(const std::vector<RenderEvent>& parameters, int sampleRate, int bufferFrames,
+             double seconds, int repeat, bool json) {
+    static const char *kPolicyNames[] = { "oldest", "quietest", "same note", "released first" };
+    uint64_t totalFrames = std::max<uint64_t>((uint64_t)(seconds * sampleRate), bufferFrames);
+    double audioSeconds = (double)totalFrames / sampleRate;
+    double bufferSeconds = (double)bufferFrames / sampleRate;
+
+    std::vector<RenderEvent> events;
+    uint32_t random = 1;
+    int numNotes = (int)(audioSeconds * kFloodNotesPerSecond);
+    for (int i = 0; i < numNotes; i++) {
+        double time = (double)i / kFloodNotesPerSecond;
+        random = random * 1664525u + 1013904223u;
+        uint8_t note = (uint8_t)(36 + (random >> 8) % 61);
+        uint8_t velocity = (uint8_t)(40 + (random >> 16) % 88);
+        double duration = 0.02 + 0.18 * (double)((random >> 4) & 0xFF) / 255.0;
+        events.push_back(MakeMIDIEvent(time, 0x90, note, velocity));
+        events.push_back(MakeMIDIEvent(time + duration, 0x80, note, 0));
+    }
+    std::stable_sort(events.begin(), events.end(), EventTimeLess);
+
+    if (json) {
+        printf("{\n  \"sample_rate\": %d,\n  \"buffer_frames\": %d,\n  \"audio_seconds\": %.6f,\n"
+               "  \"notes_per_second\": %d,\n  \"flood\": [\n", sampleRate, bufferFrames, audioSeconds,
+               kFloodNotesPerSecond);
+    } else {
+        printf("Render cost under %d notes/s, %.2f s at %d Hz (%d-frame buffers, %.2f ms)\n\n",
+               kFloodNotesPerSecond, audioSeconds, sampleRate, bufferFrames, bufferSeconds * 1000.0);
+        printf("  %14s %6s %10s %10s %16s\n", "steal policy", "voices", "seconds", "real time", "worst buffer ms");
+    }
+    for (int policy = 0; policy < kNumVoiceStealPolicies; policy++) {
+        std::vector<RenderEvent> policyParameters = parameters;
+        policyParameters.push_back(MakeParameterEvent(0.0, kParam_VoiceStealPolicy, (float)policy));
+        RenderResult best = Render(events, policyParameters, sampleRate, bufferFrames, 0.0, totalFrames, NULL);
+        for (int r = 1; r < repeat; r++) {
+            RenderResult result = Render(events, policyParameters, sampleRate, bufferFrames, 0.0, totalFrames, NULL);
+            if (result.renderSeconds < best.renderSeconds) best = result;
+        }
+        double renderSeconds = std::max(best.renderSeconds, 1e-9);
+        if (json) {
+            printf("    { \"steal_policy\": %d, \"peak_voices\": %d, \"render_seconds\": %.6f, "
+                   "\"real_time_factor\": %.2f, \"worst_buffer_seconds\": %.6f }%s\n",
+                   policy, best.peakVoices, best.renderSeconds, audioSeconds / renderSeconds,
+                   best.worstBufferSeconds, (policy + 1 < kNumVoiceStealPolicies) ? "," : "");
+        } else {
+            printf("  %14s %6d %10.4f %9.1fx %16.3f\n", kPolicyNames[policy], best.peakVoices,
+                   best.renderSeconds, audioSeconds / renderSeconds, best.worstBufferSeconds * 1000.0);
+        }
+    }
+    if (json) {
+        printf("  ]\n}\n");
+    }
+    return 0;
+}
+
+// Power of the frequency bin of samples (count long) with the given index (Goertzel)
+double BinPower(const float *samples, int count, int bin) {
+    double coefficient = 2.0 * cos(2.0 * M_PI * bin / count);
+    double s1 = 0.0, s2 = 0.0;
+    for (int i = 0; i < count; i++) {
+        double s0 = samples[i] + coefficient * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    double power = s1 * s1 + s2 * s2 - coefficient * s1 * s2;
+    return 2.0 * power / ((double)count * count);  // Mean square of that sinusoid
+}
+
+// How far below a sine at frequency the saturator's aliases are (dB), at full drive. The
+// sine falls exactly on a frequency bin, so everything in the output that isn't on its
+// harmonics' bins (below Nyquist) is aliasing.
+double MeasureAliasing(int oversampling, int sampleRate, double frequency) {
+    const int kLength = 8192;
+    int bin = (int)(frequency * kLength / sampleRate) | 1;  // Odd, so no alias lands on a harmonic
+    std::vector<float> signal(kLength * 2);
+    for (int i = 0; i < kLength * 2; i++) {
+        signal[i] = 0.8f * (float)sin(2.0 * M_PI * bin * (double)(i % kLength) / kLength);
+    }
+
+    Saturator saturator;
+    saturator.SetOversampling(oversampling);
+    saturator.Process(&signal[0], kLength * 2, 10.0f, 10.0f);
+    const float *output = &signal[kLength];  // A whole period after the filters settled
+
+    double total = 0.0;
+    for (int i = 0; i < kLength; i++) {
+        total += (double)output[i] * output[i];
+    }
+    total /= kLength;
+    double fundamental = BinPower(output, kLength, bin);
+    double harmonics = 0.0;
+    for (int h = 1; h * bin < kLength / 2; h++) {
+        harmonics += BinPower(output, kLength, h * bin);
+    }
+    double aliasing = std::max(total - harmonics, fundamental * 1e-15);
+    return 10.0 * log10(fundamental / aliasing);
+}
+
+// Aliasing rejection and cost of the saturation stage at each oversampling factor. Cost
+// is for seconds of one channel at a fixed drive, best of repeat runs; cycles are the
+// time stamp counter's where there is one.
+int RunSaturationBenchmark(int sampleRate, double seconds, int repeat, bool json) {
+    static const int kFactors[] = { 1, 2, 4 };
+    static const double kFrequencies[] = { 1000.0, 5000.0 };
+    const int maxFrames = Saturator::kMaxFrames;
+    int totalFrames = std::max((int)(seconds * sampleRate), maxFrames);
+    std::vector<float> input(totalFrames), buffer(totalFrames);
+    uint32_t noise = 1;
+    for (int i = 0; i < totalFrames; i++) {
+        noise = noise * 1664525u + 1013904223u;
+        input[i] = 0.5f * (float)sin(2.0 * M_PI * 220.0 * i / sampleRate) +
+                   0.25f * ((float)(noise >> 8) / 8388608.0f - 1.0f);
+    }
+
+    if (json) {
+        printf("{\n  \"sample_rate\": %d,\n  \"audio_seconds\": %.6f,\n  \"saturation\": [\n",
+               sampleRate, (double)totalFrames / sampleRate);
+    } else {
+        printf("Saturation stage by oversampling factor, %d Hz, full drive\n\n", sampleRate);
+        printf("  %6s %16s %16s %10s %14s\n", "factor", "aliasing 1 kHz", "aliasing 5 kHz",
+               "ns/sample", "cycles/sample");
+    }
+    for (int f = 0; f < 3; f++) {
+        int factor = kFactors[f];
+        double aliasing[2];
+        for (int i = 0; i < 2; i++) {
+            aliasing[i] = MeasureAliasing(factor, sampleRate, kFrequencies[i]);
+        }
+
+        double bestSeconds = 1e30, bestCycles = 1e30;
+        for (int r = 0; r < repeat; r++) {
+            Saturator saturator;
+            saturator.SetOversampling(factor);
+            memcpy(&buffer[0], &input[0], totalFrames * sizeof(float));
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#if defined(__x86_64__) || defined(__i386__)
+            uint64_t startCycles = __rdtsc();
+#endif
+            for (int offset = 0; offset < totalFrames; offset += maxFrames) {
+                int length = std::min(maxFrames, totalFrames - offset);
+                saturator.Process(&buffer[offset], length, 5.5f, 5.5f);
+            }
+#if defined(__x86_64__) || defined(__i386__)
+            bestCycles = std::min(bestCycles, (double)(__rdtsc() - startCycles));
+#endif
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            bestSeconds = std::min(bestSeconds, elapsed);
+        }
+        double nsPerSample = bestSeconds * 1e9 / totalFrames;
+        double cyclesPerSample = (bestCycles < 1e30) ? bestCycles / totalFrames : 0.0;
+
+        if (json) {
+            printf("    { \"oversampling\": %d, \"aliasing_db_1khz\": %.1f, \"aliasing_db_5khz\": %.1f, "
+                   "\"ns_per_sample\": %.3f, \"cycles_per_sample\": %.2f }%s\n",
+                   factor, aliasing[0], aliasing[1], nsPerSample, cyclesPerSample, (f < 2) ? "," : "");
+        } else if (cyclesPerSample > 0.0) {
+            printf("  %5dx %13.1f dB %13.1f dB %10.2f %14.1f\n", factor, aliasing[0], aliasing[1],
+                   nsPerSample, cyclesPerSample);
+        } else {
+            printf("  %5dx %13.1f dB %13.1f dB %10.2f %14s\n", factor, aliasing[0], aliasing[1],
+                   nsPerSample, "-");
+        }
+    }
+    if (json) {
+        printf("  ]\n}\n");
+    }
+    return 0;
+}
+
+// Cost of the voice filter per voice, for seconds of audio in 64-frame blocks, best of
+// repeat runs, with fixed coefficients and with every block ramping them. (Its frequency
+// response is checked by Tests/StateVariableFilterTest.cpp.)
+int RunFilterBenchmark(int sampleRate, double seconds, int repeat, bool json) {
+    const float kResonance = 4.0f;
+    const int kBlock = 64;
+    typedef VectorLanes::F F;
+    const int kWidth = VectorLanes::kWidth;
+
+    int totalFrames = std::max((int)(seconds * sampleRate), kBlock) / kBlock * kBlock;
+    // Input and working buffers of totalFrames lanes each, aligned for the vector type
+    const size_t kAlignment = 64;
+    std::vector<float> storage(2 * totalFrames * kWidth + kAlignment / sizeof(float));
+    float *input = (float *)(((uintptr_t)&storage[0] + kAlignment - 1) & ~(uintptr_t)(kAlignment - 1));
+    F *buffer = (F *)(input + totalFrames * kWidth);
+    uint32_t noise = 1;
+    for (int i = 0; i < totalFrames * kWidth; i++) {
+        noise = noise * 1664525u + 1013904223u;
+        input[i] = (float)(noise >> 8) / 8388608.0f - 1.0f;
+    }
+    double nsPerSample[2], cyclesPerSample[2];
+    for (int moving = 0; moving < 2; moving++) {
+        float g[kWidth], gStep[kWidth], k[kWidth], kStep[kWidth];
+        for (int lane = 0; lane < kWidth; lane++) {
+            SVFCoefficients from = ComputeSVFCoefficients(1000.0f + 100.0f * lane, kResonance, sampleRate);
+            SVFCoefficients to = ComputeSVFCoefficients(2000.0f + 100.0f * lane, kResonance, sampleRate);
+            g[lane] = from.g;
+            gStep[lane] = moving ? (to.g - from.g) / kBlock : 0.0f;
+            k[lane] = from.k;
+            kStep[lane] = 0.0f;
+        }
+        double bestSeconds = 1e30, bestCycles = 1e30;
+        for (int r = 0; r < repeat; r++) {
+            float zero[kWidth] = { 0.0f };
+            F ic1 = VectorLanes::Load(zero), ic2 = VectorLanes::Load(zero);
+            memcpy(buffer, input, totalFrames * sizeof(F));
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#if defined(__x86_64__) || defined(__i386__)
+            uint64_t startCycles = __rdtsc();
+#endif
+            for (int offset = 0; offset < totalFrames; offset += kBlock) {
+                SVFLanes<VectorLanes>::Process(kFilterMode_LowPass, buffer + offset, kBlock, ic1, ic2,
+                                               g, gStep, k, kStep, moving != 0);
+            }
+#if defined(__x86_64__) || defined(__i386__)
+            bestCycles = std::min(bestCycles, (double)(__rdtsc() - startCycles));
+#endif
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            bestSeconds = std::min(bestSeconds, elapsed);
+        }
+        double voiceSamples = (double)totalFrames * kWidth;
+        nsPerSample[moving] = bestSeconds * 1e9 / voiceSamples;
+        cyclesPerSample[moving] = (bestCycles < 1e30) ? bestCycles / voiceSamples : 0.0;
+    }
+
+    if (json) {
+        printf("{\n  \"sample_rate\": %d,\n  \"lanes\": %d,\n  \"audio_seconds\": %.6f,\n"
+               "  \"static_ns_per_voice_sample\": %.3f,\n  \"static_cycles_per_voice_sample\": %.2f,\n"
+               "  \"moving_ns_per_voice_sample\": %.3f,\n  \"moving_cycles_per_voice_sample\": %.2f\n}\n",
+               sampleRate, kWidth, (double)totalFrames / sampleRate, nsPerSample[0], cyclesPerSample[0],
+               nsPerSample[1], cyclesPerSample[1]);
+    } else {
+        printf("Voice filter cost per voice, %d Hz, %d lanes at a time\n\n", sampleRate, kWidth);
+        printf("  %14s %10s %14s\n", "coefficients", "ns/sample", "cycles/sample");
+        for (int moving = 0; moving < 2; moving++) {
+            if (cyclesPerSample[moving] > 0.0) {
+                printf("  %14s %10.2f %14.1f\n", moving ? "ramping" : "fixed", nsPerSample[moving],
+                       cyclesPerSample[moving]);
+            } else {
+                printf("  %14s %10.2f %14s\n", moving ? "ramping" : "fixed", nsPerSample[moving], "-");
+            }
+        }
+    }
+    return 0;
+}
+
+void PrintUsage() {
+    fprintf(stderr,
+            "Usage: claudesynth_render [options] <input.mid | notes.txt> [output.wav]\n"
+            "       claudesynth_render [options] --scaling\n"
+            "       claudesynth_render [options] --flood\n"
+            "       claudesynth_render [options] --pitch\n"
+            "       claudesynth_render [options] --saturation\n"
+            "       claudesynth_render [options] --filter\n"
+            "       claudesynth_render [options] --save-preset <file>\n"
+            "\n"
+            "Options:\n"
+            "  -p, --params <file>     Parameter set: \"<id> <value>\" per line\n"
+            "  -s, --set <id>=<value>  Set one parameter (repeatable)\n"
+            "      --preset <file>     Preset (binary or text) to start from\n"
+            "      --save-preset <file>\n"
+            "                          Save the parameters as a preset (text for .params or\n"
+            "                          .txt, binary otherwise); the input is then optional\n"
+            "  -r, --rate <hz>         Sample rate (default 44100)\n"
+            "  -b, --buffer <frames>   Host buffer size (default 512)\n"
+            "  -t, --threads <n>       Render worker threads (default 0)\n"
+            "      --tempo <bpm>       Play as a host at this tempo from beat 0, so the\n"
+            "                          arpeggiator and synced LFOs follow it (default: no\n"
+            "                          host transport, 120 BPM)\n"
+            "      --tail <seconds>    Render time after the last event (default 2)\n"
+            "      --repeat <n>        Render n times and report the fastest (default 1)\n"
+            "      --json              Print the report as JSON\n"
+            "      --scaling           Report render cost for 1 to 128 held voices (the\n"
+            "                          --tail time is how long each is held)\n"
+            "      --sweep-threads     With --scaling: also time 0 to 3 render workers at\n"
+            "                          32- to 512-frame buffers, ignoring the engine's\n"
+            "                          thresholds for using them, to find the crossover\n"
+            "      --flood             Report render cost for each steal policy under\n"
+            "                          10,000 short notes a second (for --tail seconds)\n"
+            "      --pitch             Report oscillator pitch cost with pow() per sample,\n"
+            "                          cached and FastExp2-modulated, and voices per core\n"
+            "                          with static and modulated detune (--tail seconds)\n"
+            "      --saturation        Report aliasing and cost of the saturation stage at\n"
+            "                          1x, 2x and 4x oversampling (timing --tail seconds)\n"
+            "      --filter            Report the voice filter's cost per voice, with fixed\n"
+            "                          and ramping coefficients (--tail seconds)\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    const char *inputPath = NULL;
+    const char *outputPath = NULL;
+    int sampleRate = 44100;
+    int bufferFrames = 512;
+    int threads = 0;
+    double tempo = 0.0;
+    double tailSeconds = 2.0;
+    int repeat = 1;
+    bool json = false;
+    bool scaling = false;
+    bool sweepThreads = false;
+    bool flood = false;
+    bool pitch = false;
+    bool saturation = false;
+    bool filter = false;
+    const char *savePresetPath = NULL;
+    std::vector<RenderEvent> parameters;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if ((arg == "-p" || arg == "--params") && hasValue) {
+            if (!ReadParameterFile(argv[++i], parameters)) return 1;
+        } else if (arg == "--preset" && hasValue) {
+            if (!ReadPresetFile(argv[++i], parameters)) return 1;
+        } else if (arg == "--save-preset" && hasValue) {
+            savePresetPath = argv[++i];
+        } else if ((arg == "-s" || arg == "--set") && hasValue) {
+            RenderEvent event = MakeParameterEvent(0.0, 0, 0.0f);
+            if (!ParseParameterAssignment(argv[++i], &event.paramID, &event.value)) {
+                fprintf(stderr, "Bad parameter assignment \"%s\"\n", argv[i]);
+                return 1;
+            }
+            parameters.push_back(event);
+        } else if ((arg == "-r" || arg == "--rate") && hasValue) {
+            sampleRate = atoi(argv[++i]);
+        } else if ((arg == "-b" || arg == "--buffer") && hasValue) {
+            bufferFrames = atoi(argv[++i]);
+        } else if ((arg == "-t" || arg == "--threads") && hasValue) {
+            threads = atoi(argv[++i]);
+        } else if (arg == "--tempo" && hasValue) {
+            tempo = atof(argv[++i]);
+        } else if (arg == "--tail" && hasValue) {
+            tailSeconds = atof(argv[++i]);
+        } else if (arg == "--repeat" && hasValue) {
+            repeat = atoi(argv[++i]);
+        } else if (arg == "--json") {
+            json = true;
+        } else if (arg == "--scaling") {
+            scaling = true;
+        } else if (arg == "--sweep-threads") {
+            sweepThreads = true;
+        } else if (arg == "--flood") {
+            flood = true;
+        } else if (arg == "--pitch") {
+            pitch = true;
+        } else if (arg == "--saturation") {
+            saturation = true;
+        } else if (arg == "--filter") {
+            filter = true;
+        } else if (arg == "-h" || arg == "--help") {
+            PrintUsage();
+            return 0;
+        } else if (arg[0] != '-' && !inputPath) {
+            inputPath = argv[i];
+        } else if (arg[0] != '-' && !outputPath) {
+            outputPath = argv[i];
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (saturation) {
+        return RunSaturationBenchmark(sampleRate, tailSeconds, repeat, json);
+    }
+    if (filter) {
+        return RunFilterBenchmark(sampleRate, tailSeconds, repeat, json);
+    }
+    if ((!inputPath && !scaling && !flood && !pitch && !savePresetPath) || sampleRate <= 0 || bufferFrames <= 0 || repeat <= 0 || tailSeconds < 0.0 || tempo < 0.0) {
+        PrintUsage();
+        return 1;
+    }
+
+    // Saved before the renderer's own settings are added
+    if (savePresetPath) {
+        if (!WritePresetFile(savePresetPath, parameters)) {
+            fprintf(stderr, "Can't write %s\n", savePresetPath);
+            return 1;
+        }
+        if (!inputPath && !scaling && !flood && !pitch) return 0;
+    }
+
+    // Applied first, so a --set of the same parameter still wins
+    RenderEvent threadsEvent = MakeParameterEvent(0.0, kParam_RenderThreads, (float)threads);
+    parameters.insert(parameters.begin(), threadsEvent);
+
+    if (scaling) {
+        // Every voice available, unless the parameters say otherwise
+        RenderEvent polyphonyEvent = MakeParameterEvent(0.0, kParam_Polyphony, (float)kMaxVoices);
+        parameters.insert(parameters.begin(), polyphonyEvent);
+        if (sweepThreads) {
+            return RunThreadSweep(parameters, sampleRate, tailSeconds, repeat, json);
+        }
+        return RunScaling(parameters, sampleRate, bufferFrames, tailSeconds, repeat, json);
+    }
+
+    if (flood) {
+        return RunFlood(parameters, sampleRate, bufferFrames, tailSeconds, repeat, json);
+    }
+
+    if (pitch) {
+        return RunPitchBenchmark(parameters, sampleRate, bufferFrames, tailSeconds, repeat, json);
+    }
+
+    std::vector<uint8_t> contents;
+    if (!ReadFile(inputPath, contents)) {
+        fprintf(stderr, "Can't read %s\n", inputPath);
+        return 1;
+    }
+    std::vector<RenderEvent> events;
+    if (contents.size() >= 4 && memcmp(&contents[0], "MThd", 4) == 0) {
+        const char *error = MIDIFileReader(contents).Read(events);
+        if (error) {
+            fprintf(stderr, "%s: %s\n", inputPath, error);
+            return 1;
+        }
+    } else if (!ReadNoteScript(inputPath, contents, events)) {
+        return 1;
+    }
+    std::stable_sort(events.begin(), events.end(), EventTimeLess);
+
+    double lastEvent = events.empty() ? 0.0 : events.back().time;
+    uint64_t totalFrames = (uint64_t)((lastEvent + tailSeconds) * sampleRate);
+    if (totalFrames == 0) totalFrames = bufferFrames;
+    double audioSeconds = (double)totalFrames / sampleRate;
+
+    // The first pass keeps the audio; any repeats only time the render
+    std::vector<float> samples;
+    RenderResult best = Render(events, parameters, sampleRate, bufferFrames, tempo, totalFrames,
+                               outputPath ? &samples : NULL);
+    for (int r = 1; r < repeat; r++) {
+        RenderResult result = Render(events, parameters, sampleRate, bufferFrames, tempo, totalFrames, NULL);
+        if (result.renderSeconds < best.renderSeconds) best = result;
+    }
+
+    if (outputPath && !WriteWAV(outputPath, samples, sampleRate)) {
+        fprintf(stderr, "Can't write %s\n", outputPath);
+        return 1;
+    }
+
+    const SynthEngine::StageTimings& t = best.timings;
+    double renderSeconds = std::max(best.renderSeconds, 1e-9);
+    double realTimeFactor = audioSeconds / renderSeconds;
+    double averageVoices = t.voiceFrames / std::max<double>((double)t.frames, 1.0);
+    // Voices one core could keep rendering in real time at this load (with worker
+    // threads this is per wall-clock second, not per core)
+    double voicesPerCore = (t.voiceFrames / sampleRate) / renderSeconds;
+    double subOscillatorsPerCore = (t.subOscillatorFrames / sampleRate) / renderSeconds;
+
+    if (json) {
+        printf("{\n");
+        printf("  \"input\": \"%s\",\n", inputPath);
+        printf("  \"sample_rate\": %d,\n  \"buffer_frames\": %d,\n  \"threads\": %d,\n",
+               sampleRate, bufferFrames, threads);
+        printf("  \"audio_seconds\": %.6f,\n  \"render_seconds\": %.6f,\n", audioSeconds, best.renderSeconds);
+        printf("  \"real_time_factor\": %.3f,\n", realTimeFactor);
+        printf("  \"stages\": { \"events\": %.6f, \"modulation\": %.6f, \"voices\": %.6f, \"effects\": %.6f },\n",
+               t.events, t.modulation, t.voices, t.effects);
+        printf("  \"average_voices\": %.3f,\n  \"peak_voices\": %d,\n  \"voices_per_core\": %.1f,\n",
+               averageVoices, best.peakVoices, voicesPerCore);
+        printf("  \"sub_oscillators_per_core\": %.1f,\n", subOscillatorsPerCore);
+        printf("  \"silent_buffers\": %llu,\n  \"buffers\": %llu,\n",
+               (unsigned long long)best.silentBuffers, (unsigned long long)best.buffers);
+        printf("  \"peak_level\": %.6f\n", best.peakLevel);
+        printf("}\n");
+    } else {
+        printf("Rendered %.2f s of audio at %d Hz (%d-frame buffers, %d worker thread%s)\n",
+               audioSeconds, sampleRate, bufferFrames, threads, threads == 1 ? "" : "s");
+        printf("Render time %.4f s: %.1fx real time%s\n", best.renderSeconds, realTimeFactor,
+               repeat > 1 ? " (fastest run)" : "");
+        printf("\n  %-12s %10s %8s\n", "stage", "seconds", "share");
+        const char *names[4] = { "events", "modulation", "voices", "effects" };
+        double seconds[4] = { t.events, t.modulation, t.voices, t.effects };
+        double stageTotal = std::max(t.events + t.modulation + t.voices + t.effects, 1e-9);
+        for (int i = 0; i < 4; i++) {
+            printf("  %-12s %10.4f %7.1f%%\n", names[i], seconds[i], 100.0 * seconds[i] / stageTotal);
+        }
+        printf("\nVoices: %.1f average, %d peak; %.0f voices per core\n", averageVoices, best.peakVoices, voicesPerCore);
+        printf("Sub-oscillators: %.0f per core\n", subOscillatorsPerCore);
+        printf("Silent buffers: %llu of %llu skipped\n",
+               (unsigned long long)best.silentBuffers, (unsigned long long)best.buffers);
+        printf("Peak level %.3f\n", best.peakLevel);
+        if (outputPath) printf("Wrote %s\n", outputPath);
+    }
+    return 0;
+}